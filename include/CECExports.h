@@ -55,10 +55,14 @@
 extern "C" {
 namespace CEC {
 #endif
-  #define CEC_MIN_VERSION      4
-  #define CEC_LIB_VERSION      4
+  #define CEC_MIN_VERSION      5
+  #define CEC_LIB_VERSION      5
   #define CEC_SETTLE_DOWN_TIME 1000
   #define CEC_BUTTON_TIMEOUT   500
+  #define CEC_PING_TIMEOUT     1000
+  #define CEC_MAX_FRAME_SIZE   16
+
+  #define CEC_FIRMWARE_VERSION_UNKNOWN 0xFFFF
 
   typedef std::vector<uint8_t> cec_frame;
 
@@ -234,6 +238,47 @@ namespace CEC {
     CEC_OPCODE_SET_AUDIO_RATE = 0x9A
   } cec_opcode;
 
+  typedef enum cec_abort_reason
+  {
+    CEC_ABORT_REASON_UNRECOGNIZED_OPCODE = 0,
+    CEC_ABORT_REASON_NOT_IN_CORRECT_MODE_TO_RESPOND = 1,
+    CEC_ABORT_REASON_CANNOT_PROVIDE_SOURCE = 2,
+    CEC_ABORT_REASON_INVALID_OPERAND = 3,
+    CEC_ABORT_REASON_REFUSED = 4
+  } cec_abort_reason;
+
+  typedef enum cec_version
+  {
+    CEC_VERSION_1_2 = 0x01,
+    CEC_VERSION_1_2A = 0x02,
+    CEC_VERSION_1_3 = 0x03,
+    CEC_VERSION_1_3A = 0x04
+  } cec_version;
+
+  typedef enum cec_device_type
+  {
+    CEC_DEVICE_TYPE_TV = 0,
+    CEC_DEVICE_TYPE_RECORDING_DEVICE = 1,
+    CEC_DEVICE_TYPE_RESERVED = 2,
+    CEC_DEVICE_TYPE_TUNER = 3,
+    CEC_DEVICE_TYPE_PLAYBACK_DEVICE = 4,
+    CEC_DEVICE_TYPE_AUDIO_SYSTEM = 5
+  } cec_device_type;
+
+  typedef enum cec_menu_state
+  {
+    CEC_MENU_STATE_ACTIVATED = 0,
+    CEC_MENU_STATE_DEACTIVATED = 1
+  } cec_menu_state;
+
+  typedef enum cec_power_status
+  {
+    CEC_POWER_STATUS_ON = 0x00,
+    CEC_POWER_STATUS_STANDBY = 0x01,
+    CEC_POWER_STATUS_IN_TRANSITION_STANDBY_TO_ON = 0x02,
+    CEC_POWER_STATUS_IN_TRANSITION_ON_TO_STANDBY = 0x03
+  } cec_power_status;
+
   typedef enum cec_log_level
   {
     CEC_LOG_DEBUG = 0,
@@ -246,12 +291,14 @@ namespace CEC {
   {
     std::string   message;
     cec_log_level level;
+    uint32_t      sequence; /*!< increases by one for every message that was offered to the queue. a gap means that messages were dropped */
   } cec_log_message;
 
   typedef struct cec_keypress
   {
     cec_user_control_code keycode;
     unsigned int          duration;
+    uint32_t              sequence; /*!< increases by one for every keypress that was offered to the queue. a gap means that keypresses were dropped */
   } cec_keypress;
 
   typedef struct cec_adapter
@@ -266,8 +313,168 @@ namespace CEC {
     cec_logical_address destination;
     cec_opcode          opcode;
     cec_frame           parameters;
+    uint32_t            sequence; /*!< increases by one for every command that was offered to the queue. a gap means that commands were dropped */
   } cec_command;
 
+  /*!
+   * @brief A frame that is transmitted without allocating memory. Build it with the cec_message_builder templates in CECMessages.h.
+   */
+  typedef struct cec_message
+  {
+    uint8_t data[CEC_MAX_FRAME_SIZE]; /*!< the header (initiator and destination), the opcode and the operands */
+    uint8_t size;                     /*!< the number of bytes in data that are used */
+  } cec_message;
+
+  /*!
+   * @brief Handles a received command on the thread that received it, without a round trip through the command queue.
+   *
+   * No other frames are processed until the handler returns, so it must not block. It may transmit a reply.
+   *
+   * @param param The param that was passed when registering the handler.
+   * @param command The received command. Its sequence number is not set.
+   * @return True when the command was handled, false to let libCEC handle it: opcodes that libCEC answers itself are answered, all others are queued for cec_get_next_command().
+   */
+  typedef bool (*cec_command_handler)(void *param, const cec_command *command);
+
+  typedef enum cec_adapter_event_type
+  {
+    CEC_ADAPTER_EVENT_DISCONNECTED = 0,
+    CEC_ADAPTER_EVENT_RECONNECTED,
+    CEC_ADAPTER_EVENT_ARRIVED,
+    CEC_ADAPTER_EVENT_REMOVED
+  } cec_adapter_event_type;
+
+  typedef struct cec_adapter_event
+  {
+    cec_adapter_event_type type;
+    cec_adapter            adapter;
+    uint32_t               sequence; /*!< increases by one for every event that was offered to the queue. a gap means that events were dropped */
+  } cec_adapter_event;
+
+  typedef struct cec_statistics
+  {
+    uint64_t pings_sent;
+    uint64_t pings_failed;
+    int64_t  ping_rtt_last; /*!< round trip time of the last ping in microseconds */
+    int64_t  ping_rtt_min;
+    int64_t  ping_rtt_max;
+    int64_t  ping_rtt_avg;
+    uint32_t reconnects;
+    cec_logical_address logical_address; /*!< the logical address of this device */
+    int64_t  allocation_time;            /*!< how long it took to allocate the logical address in microseconds. 0 when it wasn't allocated */
+    uint64_t frames_transmitted;         /*!< the number of CEC frames that were sent to the adapter */
+    uint64_t write_calls;                /*!< the number of system calls that were used to write to the adapter */
+    uint64_t bytes_written;              /*!< the number of bytes that were written to the adapter, including adapter commands */
+    uint64_t frames_received;            /*!< the number of CEC frames that were received from the adapter */
+    uint32_t input_buffer_size;          /*!< the number of bytes that are allocated for input from the adapter that wasn't parsed yet */
+    uint64_t bytes_discarded;            /*!< the number of bytes that were read from the adapter but weren't part of a message, or didn't fit in the input buffer */
+  } cec_statistics;
+
+  typedef enum cec_event_type
+  {
+    CEC_EVENT_KEYPRESS = 0,
+    CEC_EVENT_COMMAND,
+    CEC_EVENT_ADAPTER
+  } cec_event_type;
+
+  typedef struct cec_event
+  {
+    cec_event_type    type;
+    int               adapter_id;    /*!< the id of the adapter in the adapter manager that received this event */
+    cec_keypress      keypress;      /*!< only valid for CEC_EVENT_KEYPRESS */
+    cec_command       command;       /*!< only valid for CEC_EVENT_COMMAND */
+    cec_adapter_event adapter_event; /*!< only valid for CEC_EVENT_ADAPTER */
+    uint32_t          sequence;      /*!< increases by one for every event that was offered to the merged queue. a gap means that events were dropped */
+  } cec_event;
+
+  typedef enum cec_queue
+  {
+    CEC_QUEUE_LOG = 0,
+    CEC_QUEUE_KEYPRESS,
+    CEC_QUEUE_COMMAND,
+    CEC_QUEUE_ADAPTER_EVENT
+  } cec_queue;
+
+  typedef enum cec_queue_policy
+  {
+    CEC_QUEUE_POLICY_DROP_NEWEST = 0, /*!< don't add new entries while the queue is full */
+    CEC_QUEUE_POLICY_DROP_OLDEST,     /*!< remove the oldest entries to make room for new ones */
+    CEC_QUEUE_POLICY_BLOCK,           /*!< let the producer wait up to block_timeout_ms for room, then drop the new entry */
+    CEC_QUEUE_POLICY_COALESCE         /*!< don't add an entry that is equal to the last one that is still queued. drops new entries while the queue is full */
+  } cec_queue_policy;
+
+  /*!
+   * @brief Called from the thread that added an entry when the size of a queue reaches its high watermark.
+   * @param param The watermark_cb_param of the queue's configuration.
+   * @param size The size of the queue.
+   */
+  typedef void (*cec_queue_watermark_cb)(void *param, unsigned int size);
+
+  typedef struct cec_queue_config
+  {
+    cec_queue_policy       policy;
+    unsigned int           capacity;           /*!< the maximum number of entries. 0 to use the largest capacity that the queue supports */
+    unsigned int           block_timeout_ms;   /*!< only used by CEC_QUEUE_POLICY_BLOCK */
+    unsigned int           high_watermark;     /*!< call watermark_cb when the queue holds this many entries. 0 to disable */
+    cec_queue_watermark_cb watermark_cb;       /*!< called once every time the high watermark is reached, until the queue drops below it again */
+    void *                 watermark_cb_param;
+  } cec_queue_config;
+
+  #define CEC_QUEUE_LATENCY_BUCKETS 24
+
+  typedef struct cec_queue_statistics
+  {
+    unsigned int capacity;      /*!< the configured capacity */
+    unsigned int max_capacity;  /*!< the largest capacity that the queue supports */
+    unsigned int size;
+    unsigned int peak_size;
+    uint32_t     pushed;        /*!< the number of entries that were added */
+    uint32_t     popped;        /*!< the number of entries that were removed, including the ones dropped by CEC_QUEUE_POLICY_DROP_OLDEST */
+    uint32_t     dropped;       /*!< the number of entries that were dropped */
+    uint32_t     coalesced;     /*!< the number of entries that were merged with an equal entry */
+    uint32_t     last_sequence; /*!< the sequence number of the last entry that was offered to the queue */
+    uint32_t     latency_max;   /*!< the longest time that an entry spent in the queue, in microseconds. the latencies are 0 unless libCEC was built with --enable-queue-statistics */
+    uint32_t     latency_histogram[CEC_QUEUE_LATENCY_BUCKETS]; /*!< the time that entries spent in the queue before they were popped or dropped by CEC_QUEUE_POLICY_DROP_OLDEST. bucket n counts 2^n up to 2^(n+1) microseconds, bucket 0 the ones below 2 microseconds and the last bucket all longer ones */
+  } cec_queue_statistics;
+
+  typedef enum cec_thread
+  {
+    CEC_THREAD_READER = 0, /*!< reads data from the adapter. the shared I/O thread when the shared reactor is used */
+    CEC_THREAD_PROCESSOR,  /*!< parses frames and answers commands. the shared dispatcher thread when the shared reactor is used */
+    CEC_THREAD_MONITOR     /*!< reports adapters that are plugged in or removed */
+  } cec_thread;
+
+  typedef enum cec_thread_policy
+  {
+    CEC_THREAD_POLICY_DEFAULT = 0, /*!< the normal, time sharing scheduler */
+    CEC_THREAD_POLICY_FIFO,        /*!< real-time, first in first out (SCHED_FIFO) */
+    CEC_THREAD_POLICY_RR           /*!< real-time, round robin (SCHED_RR) */
+  } cec_thread_policy;
+
+  typedef struct cec_thread_config
+  {
+    cec_thread_policy policy;
+    int               priority;     /*!< the real-time priority. only used by CEC_THREAD_POLICY_FIFO and CEC_THREAD_POLICY_RR */
+    uint64_t          cpu_affinity; /*!< bit n allows the thread to run on CPU n. 0 to run on any CPU */
+    unsigned int      stack_size;   /*!< in bytes. 0 to use the default. only applied when the thread is started */
+    char              name[16];     /*!< the name of the thread. empty to use libCEC's name for it */
+  } cec_thread_config;
+
+  #define CEC_LOCK_HISTOGRAM_BUCKETS 24
+
+  typedef struct cec_lock_statistics
+  {
+    char     name[32];         /*!< all locks with the same name are counted together */
+    uint64_t acquisitions;
+    uint64_t contended;        /*!< the number of acquisitions that had to wait for another thread to release the lock */
+    uint64_t wait_time_total;  /*!< in microseconds */
+    uint64_t wait_time_max;    /*!< in microseconds */
+    uint64_t hold_time_total;  /*!< in microseconds */
+    uint64_t hold_time_max;    /*!< in microseconds */
+    uint32_t wait_histogram[CEC_LOCK_HISTOGRAM_BUCKETS]; /*!< contended waits. bucket n counts waits of 2^n up to 2^(n+1) microseconds, bucket 0 the ones below 2 microseconds and the last bucket all longer ones */
+    uint32_t hold_histogram[CEC_LOCK_HISTOGRAM_BUCKETS]; /*!< hold times, in the same buckets as wait_histogram */
+  } cec_lock_statistics;
+
   //default physical address 1.0.0.0
   #define CEC_DEFAULT_PHYSICAL_ADDRESS 0x1000
 
@@ -277,6 +484,8 @@ namespace CEC {
 #include "CECExportsCpp.h"
 #include "CECExportsC.h"
 };
+
+#include "CECMessages.h"
 #else
 #include "CECExportsC.h"
 #endif
@@ -38,6 +38,16 @@
 extern "C" {
 #endif
 
+/*!
+ * @brief A libcec instance, see libcec_create().
+ */
+typedef void *cec_handle_t;
+
+/*!
+ * @brief An adapter manager, see libcec_manager_create().
+ */
+typedef void *cec_manager_handle_t;
+
 /*!
  * @brief Load the CEC adapter library.
  * @param strDeviceName How to present this device to other devices.
@@ -82,8 +92,25 @@ extern DECLSPEC int cec_find_adapters(std::vector<cec_adapter> &deviceList, cons
 #endif
 
 /*!
- * @brief Ping the CEC adapter.
- * @return True when the ping was succesful, false otherwise.
+ * @brief Let this instance share its I/O and processing threads with all other instances that use the shared reactor,
+ * instead of starting two threads of its own. Must be called before the connection is opened. Not supported on Windows.
+ * @param bEnable True to use the shared reactor, false to use dedicated threads.
+ * @return True when the mode was changed, false otherwise.
+ */
+extern DECLSPEC bool cec_use_shared_reactor(bool bEnable = true);
+
+/*!
+ * @brief Start or stop listening for adapters that are plugged in or removed. Only implemented on Linux at the moment.
+ * While enabled, cec_find_adapters() returns the cached list of adapters instead of scanning all devices, and
+ * CEC_ADAPTER_EVENT_ARRIVED and CEC_ADAPTER_EVENT_REMOVED events are passed to cec_get_next_adapter_event().
+ * @param bEnable True to start listening, false to stop.
+ * @return True when the monitor was started or stopped, false otherwise.
+ */
+extern DECLSPEC bool cec_enable_adapter_monitor(bool bEnable = true);
+
+/*!
+ * @brief Ping the CEC adapter and wait for it to respond.
+ * @return True when the adapter responded, false otherwise.
  */
 extern DECLSPEC bool cec_ping_adapters(void);
 
@@ -93,6 +120,12 @@ extern DECLSPEC bool cec_ping_adapters(void);
  */
 extern DECLSPEC bool cec_start_bootloader(void);
 
+/*!
+ * @brief Get the firmware version of the CEC adapter. The version is requested once when the connection is opened.
+ * @return The firmware version, or CEC_FIRMWARE_VERSION_UNKNOWN when no connection has been opened.
+ */
+extern DECLSPEC uint16_t cec_get_firmware_version(void);
+
 /*!
  * @return Get the minimal version of libcec that this version of libcec can interface with.
  */
@@ -171,10 +204,161 @@ extern DECLSPEC bool cec_get_next_command(cec_command *command);
 #endif
 
 /*!
- * @brief Transmit a frame on the CEC line.
+ * @brief Get the next adapter event in the queue, if there is one. The adapter is pinged periodically, and the connection is reopened automatically when it stops responding.
+ * @param event The next event.
+ * @return True when an event was passed, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_get_next_adapter_event(CEC::cec_adapter_event *event);
+#else
+extern DECLSPEC bool cec_get_next_adapter_event(cec_adapter_event *event);
+#endif
+
+/*!
+ * @brief Get up to iMaxMessages log messages at once. Cheaper than calling cec_get_next_log_message() for every message.
+ * @param messages The array to copy the messages to.
+ * @param iMaxMessages The size of messages.
+ * @return The number of messages that were copied.
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int cec_get_next_log_messages(CEC::cec_log_message *messages, unsigned int iMaxMessages);
+#else
+extern DECLSPEC unsigned int cec_get_next_log_messages(cec_log_message *messages, unsigned int iMaxMessages);
+#endif
+
+/*!
+ * @brief Only log messages with at least this level. Messages below it are not formatted, which saves the work
+ * on busy busses when the application only shows warnings and errors. Defaults to CEC_LOG_DEBUG.
+ * @param level The lowest level that is logged.
+ */
+#ifdef __cplusplus
+extern DECLSPEC void cec_set_log_level(CEC::cec_log_level level);
+#else
+extern DECLSPEC void cec_set_log_level(cec_log_level level);
+#endif
+
+/*!
+ * @brief Get up to iMaxKeys keypresses at once.
+ * @param keys The array to copy the keypresses to.
+ * @param iMaxKeys The size of keys.
+ * @return The number of keypresses that were copied.
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int cec_get_next_keypresses(CEC::cec_keypress *keys, unsigned int iMaxKeys);
+#else
+extern DECLSPEC unsigned int cec_get_next_keypresses(cec_keypress *keys, unsigned int iMaxKeys);
+#endif
+
+/*!
+ * @brief Get up to iMaxCommands received commands at once.
+ * @param commands The array to copy the commands to.
+ * @param iMaxCommands The size of commands.
+ * @return The number of commands that were copied.
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int cec_get_next_commands(CEC::cec_command *commands, unsigned int iMaxCommands);
+#else
+extern DECLSPEC unsigned int cec_get_next_commands(cec_command *commands, unsigned int iMaxCommands);
+#endif
+
+/*!
+ * @brief Get the statistics of the connection to the CEC adapter.
+ * @param statistics The statistics.
+ * @return True when the statistics were copied, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_get_statistics(CEC::cec_statistics *statistics);
+#else
+extern DECLSPEC bool cec_get_statistics(cec_statistics *statistics);
+#endif
+
+/*!
+ * @brief Change what happens when one of the queues of received data is full, and how many entries it can hold.
+ * @param queue The queue to configure.
+ * @param config The new configuration.
+ * @return True when the queue was configured, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_set_queue_config(CEC::cec_queue queue, const CEC::cec_queue_config *config);
+#else
+extern DECLSPEC bool cec_set_queue_config(cec_queue queue, const cec_queue_config *config);
+#endif
+
+/*!
+ * @brief Get the size, drop counters and last sequence number of one of the queues of received data.
+ * @param queue The queue.
+ * @param statistics The statistics.
+ * @return True when the statistics were copied, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_get_queue_statistics(CEC::cec_queue queue, CEC::cec_queue_statistics *statistics);
+#else
+extern DECLSPEC bool cec_get_queue_statistics(cec_queue queue, cec_queue_statistics *statistics);
+#endif
+
+/*!
+ * @brief Change the scheduling policy, priority, CPU affinity, stack size and name of one of libCEC's threads.
+ * @param thread The thread to configure.
+ * @param config The new configuration. Applied right away when the thread is running, otherwise when it's started.
+ * @return True when the configuration was accepted and could be applied to a running thread, false otherwise. Real-time policies need the CAP_SYS_NICE capability or a suitable RLIMIT_RTPRIO.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_set_thread_config(CEC::cec_thread thread, const CEC::cec_thread_config *config);
+#else
+extern DECLSPEC bool cec_set_thread_config(cec_thread thread, const cec_thread_config *config);
+#endif
+
+/*!
+ * @brief Lock all current and future memory pages of the process into RAM, so libCEC's threads never wait for a page fault.
+ * @param bLock True to lock the memory, false to unlock it again.
+ * @return True when the memory was (un)locked, false otherwise.
+ */
+extern DECLSPEC bool cec_lock_memory(bool bLock);
+
+/*!
+ * @brief Get the number of acquisitions, contended acquisitions and the wait and hold times of libCEC's locks.
+ * @param statistics The array to copy the statistics to, one entry per lock name.
+ * @param iMaxLocks The size of statistics.
+ * @return The number of entries that were copied. Always 0 unless libCEC was built with --enable-lock-statistics.
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int cec_get_lock_statistics(CEC::cec_lock_statistics *statistics, unsigned int iMaxLocks);
+#else
+extern DECLSPEC unsigned int cec_get_lock_statistics(cec_lock_statistics *statistics, unsigned int iMaxLocks);
+#endif
+
+/*!
+ * @brief Start writing a Chrome trace_event timeline of every transmitted and received frame, for chrome://tracing or Perfetto.
+ * @param strFile The JSON file to write to. It's overwritten when it exists.
+ * @return True when tracing was started, false when the file couldn't be opened or a trace is already being written.
+ */
+extern DECLSPEC bool cec_start_trace(const char *strFile);
+
+/*!
+ * @brief Stop writing the trace that was started with cec_start_trace() and close the file.
+ * @return True when a trace was stopped, false when none was being written.
+ */
+extern DECLSPEC bool cec_stop_trace(void);
+
+/*!
+ * @brief Register a handler for an opcode. It is called inline, on the thread that receives the command, before the command is answered by libCEC or queued for cec_get_next_command().
+ * @param opcode The opcode to handle. A handler for an opcode that libCEC answers itself overrides libCEC's reply when it returns true.
+ * @param handler The handler, or NULL to remove the handler of this opcode.
+ * @param param Passed to the handler.
+ * @return True when the handler was registered, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_set_command_handler(CEC::cec_opcode opcode, CEC::cec_command_handler handler, void *param);
+#else
+extern DECLSPEC bool cec_set_command_handler(cec_opcode opcode, cec_command_handler handler, void *param);
+#endif
+
+/*!
+ * @brief Transmit a frame on the CEC line. Frames that are transmitted while the connection to the adapter is being restored are sent after reconnecting, unless that takes longer than 2 seconds.
+ * Frames with less operands than their opcode needs, or that are broadcast or directed while their opcode can't be, are not sent. Additional operands are sent.
  * @param data The frame to send.
  * @param bWaitForAck Wait for an ACK message for 1 second after this frame has been sent.
- * @return True when the data was sent and acked, false otherwise.
+ * @return True when the data was sent and acked, or when it was queued to be sent after reconnecting. False otherwise.
  */
 #ifdef __cplusplus
 extern DECLSPEC bool cec_transmit(const CEC::cec_frame &data, bool bWaitForAck = true);
@@ -182,9 +366,21 @@ extern DECLSPEC bool cec_transmit(const CEC::cec_frame &data, bool bWaitForAck =
 extern DECLSPEC bool cec_transmit(const cec_frame &data, bool bWaitForAck = true);
 #endif
 
+/*!
+ * @brief Transmit a frame that was built with a cec_message_builder. Unlike cec_transmit(), nothing is allocated on the way to the adapter.
+ * @param message The frame to send.
+ * @param bWaitForAck Wait for an ACK message for 1 second after this frame has been sent.
+ * @return True when the data was sent and acked, or when it was queued to be sent after reconnecting. False otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_transmit_message(const CEC::cec_message *message, bool bWaitForAck = true);
+#else
+extern DECLSPEC bool cec_transmit_message(const cec_message *message, bool bWaitForAck = true);
+#endif
+
 /*!
  * @brief Set the logical address of the CEC adapter.
- * @param iLogicalAddress The cec adapter's logical address.
+ * @param iLogicalAddress The cec adapter's logical address. Can't be the address of a device that was added with cec_add_logical_device().
  * @return True when the logical address was set succesfully, false otherwise.
  */
 #ifdef __cplusplus
@@ -193,6 +389,494 @@ extern DECLSPEC bool cec_set_logical_address(CEC::cec_logical_address iLogicalAd
 extern DECLSPEC bool cec_set_logical_address(cec_logical_address myAddress, cec_logical_address targetAddress);
 #endif
 
+/*!
+ * @brief Let libCEC allocate the logical address of this device when the connection is opened, instead of using the logical address
+ * that was passed to cec_init(). The free logical addresses for the device type are found by polling them in one burst, and the first
+ * one that isn't acked is used. The address and the time the allocation took are reported by cec_get_statistics().
+ * @param type The device type of this device.
+ * @return True when the logical address will be allocated, false when the connection is already open.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_set_device_type(CEC::cec_device_type type);
+#else
+extern DECLSPEC bool cec_set_device_type(cec_device_type type);
+#endif
+
+/*!
+ * @brief Present another logical device on the CEC line with the same adapter. The adapter acks frames for it, and libCEC answers
+ * requests for its OSD name, physical address, power status, menu state and CEC version on its behalf. Commands for it are handled
+ * and queued like commands for the logical address that was set with cec_set_logical_address(), with their destination set to it.
+ * Adding a logical device that was already added replaces its name and type.
+ * @param iLogicalAddress The logical address of the device.
+ * @param strDeviceName How to present this device to other devices. Names of more than 14 characters are truncated.
+ * @param type The device type that is reported with its physical address.
+ * @return True when the device was added and the adapter acks its frames, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_add_logical_device(CEC::cec_logical_address iLogicalAddress, const char *strDeviceName, CEC::cec_device_type type);
+#else
+extern DECLSPEC bool cec_add_logical_device(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type);
+#endif
+
+/*!
+ * @brief Stop presenting a logical device that was added with cec_add_logical_device().
+ * @param iLogicalAddress The logical address of the device. The logical address that was set with cec_set_logical_address() can't be removed.
+ * @return True when the device was removed, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool cec_remove_logical_device(CEC::cec_logical_address iLogicalAddress);
+#else
+extern DECLSPEC bool cec_remove_logical_device(cec_logical_address iLogicalAddress);
+#endif
+
+/*!
+ * @name Handle-based interface
+ * Every function takes the instance that it controls, so several adapters can be used at the same time,
+ * from different threads. The functions above control the instance that was created by cec_init().
+ */
+//@{
+
+/*!
+ * @brief Create a new libcec instance.
+ * @see cec_init
+ * @return The new instance, or NULL when it could not be created.
+ */
+#ifdef __cplusplus
+extern DECLSPEC cec_handle_t libcec_create(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+#else
+extern DECLSPEC cec_handle_t libcec_create(const char *strDeviceName, cec_logical_address iLogicalAddress = CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+#endif
+
+/*!
+ * @brief Close the connection of an instance and destroy it.
+ * @param handle The instance, created by libcec_create().
+ */
+extern DECLSPEC void libcec_destroy(cec_handle_t handle);
+
+/*!
+ * @see cec_open
+ */
+extern DECLSPEC bool libcec_open(cec_handle_t handle, const char *strPort, uint64_t iTimeout);
+
+/*!
+ * @see cec_close
+ */
+extern DECLSPEC void libcec_close(cec_handle_t handle);
+
+/*!
+ * @see cec_find_adapters
+ */
+#ifdef __cplusplus
+extern DECLSPEC int libcec_find_adapters(cec_handle_t handle, std::vector<CEC::cec_adapter> &deviceList, const char *strDevicePath = NULL);
+#else
+extern DECLSPEC int libcec_find_adapters(cec_handle_t handle, std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL);
+#endif
+
+/*!
+ * @see cec_use_shared_reactor
+ */
+extern DECLSPEC bool libcec_use_shared_reactor(cec_handle_t handle, bool bEnable = true);
+
+/*!
+ * @see cec_enable_adapter_monitor
+ */
+extern DECLSPEC bool libcec_enable_adapter_monitor(cec_handle_t handle, bool bEnable = true);
+
+/*!
+ * @see cec_ping_adapters
+ */
+extern DECLSPEC bool libcec_ping_adapters(cec_handle_t handle);
+
+/*!
+ * @see cec_start_bootloader
+ */
+extern DECLSPEC bool libcec_start_bootloader(cec_handle_t handle);
+
+/*!
+ * @see cec_get_firmware_version
+ */
+extern DECLSPEC uint16_t libcec_get_firmware_version(cec_handle_t handle);
+
+/*!
+ * @see cec_get_min_version
+ */
+extern DECLSPEC int libcec_get_min_version(cec_handle_t handle);
+
+/*!
+ * @see cec_get_lib_version
+ */
+extern DECLSPEC int libcec_get_lib_version(cec_handle_t handle);
+
+/*!
+ * @see cec_power_on_devices
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_power_on_devices(cec_handle_t handle, CEC::cec_logical_address address = CEC::CECDEVICE_TV);
+#else
+extern DECLSPEC bool libcec_power_on_devices(cec_handle_t handle, cec_logical_address address = CECDEVICE_TV);
+#endif
+
+/*!
+ * @see cec_standby_devices
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_standby_devices(cec_handle_t handle, CEC::cec_logical_address address = CEC::CECDEVICE_BROADCAST);
+#else
+extern DECLSPEC bool libcec_standby_devices(cec_handle_t handle, cec_logical_address address = CECDEVICE_BROADCAST);
+#endif
+
+/*!
+ * @see cec_set_active_view
+ */
+extern DECLSPEC bool libcec_set_active_view(cec_handle_t handle);
+
+/*!
+ * @see cec_set_inactive_view
+ */
+extern DECLSPEC bool libcec_set_inactive_view(cec_handle_t handle);
+
+/*!
+ * @see cec_get_next_log_message
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_next_log_message(cec_handle_t handle, CEC::cec_log_message *message);
+#else
+extern DECLSPEC bool libcec_get_next_log_message(cec_handle_t handle, cec_log_message *message);
+#endif
+
+/*!
+ * @see cec_get_next_keypress
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_next_keypress(cec_handle_t handle, CEC::cec_keypress *key);
+#else
+extern DECLSPEC bool libcec_get_next_keypress(cec_handle_t handle, cec_keypress *key);
+#endif
+
+/*!
+ * @see cec_get_next_command
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_next_command(cec_handle_t handle, CEC::cec_command *command);
+#else
+extern DECLSPEC bool libcec_get_next_command(cec_handle_t handle, cec_command *command);
+#endif
+
+/*!
+ * @see cec_get_next_adapter_event
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_next_adapter_event(cec_handle_t handle, CEC::cec_adapter_event *event);
+#else
+extern DECLSPEC bool libcec_get_next_adapter_event(cec_handle_t handle, cec_adapter_event *event);
+#endif
+
+/*!
+ * @see cec_get_next_log_messages
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int libcec_get_next_log_messages(cec_handle_t handle, CEC::cec_log_message *messages, unsigned int iMaxMessages);
+#else
+extern DECLSPEC unsigned int libcec_get_next_log_messages(cec_handle_t handle, cec_log_message *messages, unsigned int iMaxMessages);
+#endif
+
+/*!
+ * @see cec_set_log_level
+ */
+#ifdef __cplusplus
+extern DECLSPEC void libcec_set_log_level(cec_handle_t handle, CEC::cec_log_level level);
+#else
+extern DECLSPEC void libcec_set_log_level(cec_handle_t handle, cec_log_level level);
+#endif
+
+/*!
+ * @see cec_get_next_keypresses
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int libcec_get_next_keypresses(cec_handle_t handle, CEC::cec_keypress *keys, unsigned int iMaxKeys);
+#else
+extern DECLSPEC unsigned int libcec_get_next_keypresses(cec_handle_t handle, cec_keypress *keys, unsigned int iMaxKeys);
+#endif
+
+/*!
+ * @see cec_get_next_commands
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int libcec_get_next_commands(cec_handle_t handle, CEC::cec_command *commands, unsigned int iMaxCommands);
+#else
+extern DECLSPEC unsigned int libcec_get_next_commands(cec_handle_t handle, cec_command *commands, unsigned int iMaxCommands);
+#endif
+
+/*!
+ * @see cec_get_statistics
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_statistics(cec_handle_t handle, CEC::cec_statistics *statistics);
+#else
+extern DECLSPEC bool libcec_get_statistics(cec_handle_t handle, cec_statistics *statistics);
+#endif
+
+/*!
+ * @see cec_set_queue_config
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_set_queue_config(cec_handle_t handle, CEC::cec_queue queue, const CEC::cec_queue_config *config);
+#else
+extern DECLSPEC bool libcec_set_queue_config(cec_handle_t handle, cec_queue queue, const cec_queue_config *config);
+#endif
+
+/*!
+ * @see cec_get_queue_statistics
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_get_queue_statistics(cec_handle_t handle, CEC::cec_queue queue, CEC::cec_queue_statistics *statistics);
+#else
+extern DECLSPEC bool libcec_get_queue_statistics(cec_handle_t handle, cec_queue queue, cec_queue_statistics *statistics);
+#endif
+
+/*!
+ * @see cec_set_thread_config
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_set_thread_config(cec_handle_t handle, CEC::cec_thread thread, const CEC::cec_thread_config *config);
+#else
+extern DECLSPEC bool libcec_set_thread_config(cec_handle_t handle, cec_thread thread, const cec_thread_config *config);
+#endif
+
+/*!
+ * @see cec_lock_memory
+ */
+extern DECLSPEC bool libcec_lock_memory(cec_handle_t handle, bool bLock);
+
+/*!
+ * @see cec_get_lock_statistics
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int libcec_get_lock_statistics(cec_handle_t handle, CEC::cec_lock_statistics *statistics, unsigned int iMaxLocks);
+#else
+extern DECLSPEC unsigned int libcec_get_lock_statistics(cec_handle_t handle, cec_lock_statistics *statistics, unsigned int iMaxLocks);
+#endif
+
+/*!
+ * @see cec_start_trace
+ */
+extern DECLSPEC bool libcec_start_trace(cec_handle_t handle, const char *strFile);
+
+/*!
+ * @see cec_stop_trace
+ */
+extern DECLSPEC bool libcec_stop_trace(cec_handle_t handle);
+
+/*!
+ * @see cec_set_command_handler
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_set_command_handler(cec_handle_t handle, CEC::cec_opcode opcode, CEC::cec_command_handler handler, void *param);
+#else
+extern DECLSPEC bool libcec_set_command_handler(cec_handle_t handle, cec_opcode opcode, cec_command_handler handler, void *param);
+#endif
+
+/*!
+ * @see cec_transmit
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_transmit(cec_handle_t handle, const CEC::cec_frame &data, bool bWaitForAck = true);
+#else
+extern DECLSPEC bool libcec_transmit(cec_handle_t handle, const cec_frame &data, bool bWaitForAck = true);
+#endif
+
+/*!
+ * @see cec_transmit_message
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_transmit_message(cec_handle_t handle, const CEC::cec_message *message, bool bWaitForAck = true);
+#else
+extern DECLSPEC bool libcec_transmit_message(cec_handle_t handle, const cec_message *message, bool bWaitForAck = true);
+#endif
+
+/*!
+ * @see cec_set_logical_address
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_set_logical_address(cec_handle_t handle, CEC::cec_logical_address iLogicalAddress);
+#else
+extern DECLSPEC bool libcec_set_logical_address(cec_handle_t handle, cec_logical_address iLogicalAddress);
+#endif
+
+/*!
+ * @see cec_set_device_type
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_set_device_type(cec_handle_t handle, CEC::cec_device_type type);
+#else
+extern DECLSPEC bool libcec_set_device_type(cec_handle_t handle, cec_device_type type);
+#endif
+
+/*!
+ * @see cec_add_logical_device
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_add_logical_device(cec_handle_t handle, CEC::cec_logical_address iLogicalAddress, const char *strDeviceName, CEC::cec_device_type type);
+#else
+extern DECLSPEC bool libcec_add_logical_device(cec_handle_t handle, cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type);
+#endif
+
+/*!
+ * @see cec_remove_logical_device
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_remove_logical_device(cec_handle_t handle, CEC::cec_logical_address iLogicalAddress);
+#else
+extern DECLSPEC bool libcec_remove_logical_device(cec_handle_t handle, cec_logical_address iLogicalAddress);
+#endif
+
+/*!
+ * @brief Create a manager for several adapters.
+ * @see CEC::ICECAdapterManager
+ * @return The new manager, or NULL when it could not be created.
+ */
+#ifdef __cplusplus
+extern DECLSPEC cec_manager_handle_t libcec_manager_create(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+#else
+extern DECLSPEC cec_manager_handle_t libcec_manager_create(const char *strDeviceName, cec_logical_address iLogicalAddress = CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+#endif
+
+/*!
+ * @brief Close all connections of a manager and destroy it.
+ * @param manager The manager, created by libcec_manager_create().
+ */
+extern DECLSPEC void libcec_manager_destroy(cec_manager_handle_t manager);
+
+/*!
+ * @brief Open connections to all given adapters at the same time.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param ports The COM ports of the adapters. The adapter id of each adapter is its index in this list.
+ * @param iTimeout Connection timeout in ms for each adapter.
+ * @return The number of adapters that were opened.
+ */
+extern DECLSPEC int libcec_manager_open(cec_manager_handle_t manager, const std::vector<std::string> &ports, uint64_t iTimeout);
+
+/*!
+ * @brief Close the connections to all adapters of a manager.
+ * @param manager The manager, created by libcec_manager_create().
+ */
+extern DECLSPEC void libcec_manager_close(cec_manager_handle_t manager);
+
+/*!
+ * @brief Use the shared reactor for all adapters that are opened after this call.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param bEnable True to use the shared reactor, false to use dedicated threads.
+ * @return True when the mode was changed, false otherwise.
+ */
+extern DECLSPEC bool libcec_manager_use_shared_reactor(cec_manager_handle_t manager, bool bEnable = true);
+
+/*!
+ * @param manager The manager, created by libcec_manager_create().
+ * @return The number of adapters that were passed to libcec_manager_open().
+ */
+extern DECLSPEC int libcec_manager_get_adapter_count(cec_manager_handle_t manager);
+
+/*!
+ * @brief Get the instance that controls a single adapter of a manager. It can be used with all other libcec_ functions, but not with libcec_destroy().
+ * @param manager The manager, created by libcec_manager_create().
+ * @param iAdapterId The id of the adapter.
+ * @return The instance, or NULL when the id is invalid.
+ */
+extern DECLSPEC cec_handle_t libcec_manager_get_adapter(cec_manager_handle_t manager, int iAdapterId);
+
+/*!
+ * @brief Get the next keypress, command or adapter event of any of the adapters of a manager.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param event The next event.
+ * @return True when an event was passed, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_manager_get_next_event(cec_manager_handle_t manager, CEC::cec_event *event);
+#else
+extern DECLSPEC bool libcec_manager_get_next_event(cec_manager_handle_t manager, cec_event *event);
+#endif
+
+/*!
+ * @brief Get up to iMaxEvents events of a manager at once.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param events The array to copy the events to.
+ * @param iMaxEvents The size of events.
+ * @return The number of events that were copied.
+ */
+#ifdef __cplusplus
+extern DECLSPEC unsigned int libcec_manager_get_next_events(cec_manager_handle_t manager, CEC::cec_event *events, unsigned int iMaxEvents);
+#else
+extern DECLSPEC unsigned int libcec_manager_get_next_events(cec_manager_handle_t manager, cec_event *events, unsigned int iMaxEvents);
+#endif
+
+/*!
+ * @brief Change the overflow policy, capacity and high watermark of the merged event queue of a manager.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param config The new configuration.
+ * @return True when the queue was configured, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_manager_set_queue_config(cec_manager_handle_t manager, const CEC::cec_queue_config *config);
+#else
+extern DECLSPEC bool libcec_manager_set_queue_config(cec_manager_handle_t manager, const cec_queue_config *config);
+#endif
+
+/*!
+ * @brief Get the statistics of the merged event queue of a manager.
+ * @param manager The manager, created by libcec_manager_create().
+ * @param statistics The statistics.
+ * @return True when the statistics were copied, false otherwise.
+ */
+#ifdef __cplusplus
+extern DECLSPEC bool libcec_manager_get_queue_statistics(cec_manager_handle_t manager, CEC::cec_queue_statistics *statistics);
+#else
+extern DECLSPEC bool libcec_manager_get_queue_statistics(cec_manager_handle_t manager, cec_queue_statistics *statistics);
+#endif
+
+/*!
+ * @brief Transmit a frame on all adapters of a manager in parallel.
+ * @see cec_transmit
+ * @return The number of adapters that transmitted the frame.
+ */
+#ifdef __cplusplus
+extern DECLSPEC int libcec_manager_transmit(cec_manager_handle_t manager, const CEC::cec_frame &data, bool bWaitForAck = true);
+#else
+extern DECLSPEC int libcec_manager_transmit(cec_manager_handle_t manager, const cec_frame &data, bool bWaitForAck = true);
+#endif
+
+/*!
+ * @see cec_power_on_devices
+ * @return The number of adapters that transmitted the command.
+ */
+#ifdef __cplusplus
+extern DECLSPEC int libcec_manager_power_on_devices(cec_manager_handle_t manager, CEC::cec_logical_address address = CEC::CECDEVICE_TV);
+#else
+extern DECLSPEC int libcec_manager_power_on_devices(cec_manager_handle_t manager, cec_logical_address address = CECDEVICE_TV);
+#endif
+
+/*!
+ * @see cec_standby_devices
+ * @return The number of adapters that transmitted the command.
+ */
+#ifdef __cplusplus
+extern DECLSPEC int libcec_manager_standby_devices(cec_manager_handle_t manager, CEC::cec_logical_address address = CEC::CECDEVICE_BROADCAST);
+#else
+extern DECLSPEC int libcec_manager_standby_devices(cec_manager_handle_t manager, cec_logical_address address = CECDEVICE_BROADCAST);
+#endif
+
+/*!
+ * @see cec_set_active_view
+ * @return The number of adapters that transmitted the command.
+ */
+extern DECLSPEC int libcec_manager_set_active_view(cec_manager_handle_t manager);
+
+/*!
+ * @see cec_set_inactive_view
+ * @return The number of adapters that transmitted the command.
+ */
+extern DECLSPEC int libcec_manager_set_inactive_view(cec_manager_handle_t manager);
+//@}
+
 #ifdef __cplusplus
 };
 #endif
@@ -53,6 +53,16 @@ namespace CEC
      */
     virtual int FindAdapters(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL) = 0;
 
+    /*!
+     * @see cec_use_shared_reactor
+     */
+    virtual bool UseSharedReactor(bool bEnable = true) = 0;
+
+    /*!
+     * @see cec_enable_adapter_monitor
+     */
+    virtual bool EnableAdapterMonitor(bool bEnable = true) = 0;
+
     /*!
      * @see cec_ping_adapters
      */
@@ -62,6 +72,11 @@ namespace CEC
      * @see cec_start_bootloader
      */
     virtual bool StartBootloader(void) = 0;
+
+    /*!
+     * @see cec_get_firmware_version
+     */
+    virtual uint16_t GetFirmwareVersion(void) = 0;
     //@}
 
     /*!
@@ -89,16 +104,106 @@ namespace CEC
      */
     virtual bool GetNextCommand(cec_command *command) = 0;
 
+    /*!
+     * @see cec_get_next_adapter_event
+     */
+    virtual bool GetNextAdapterEvent(cec_adapter_event *event) = 0;
+
+    /*!
+     * @see cec_get_next_log_messages
+     */
+    virtual unsigned int GetNextLogMessages(cec_log_message *messages, unsigned int iMaxMessages) = 0;
+
+    /*!
+     * @see cec_set_log_level
+     */
+    virtual void SetLogLevel(cec_log_level level) = 0;
+
+    /*!
+     * @see cec_get_next_keypresses
+     */
+    virtual unsigned int GetNextKeypresses(cec_keypress *keys, unsigned int iMaxKeys) = 0;
+
+    /*!
+     * @see cec_get_next_commands
+     */
+    virtual unsigned int GetNextCommands(cec_command *commands, unsigned int iMaxCommands) = 0;
+
+    /*!
+     * @see cec_get_statistics
+     */
+    virtual bool GetStatistics(cec_statistics *statistics) = 0;
+
+    /*!
+     * @see cec_set_queue_config
+     */
+    virtual bool SetQueueConfig(cec_queue queue, const cec_queue_config &config) = 0;
+
+    /*!
+     * @see cec_get_queue_statistics
+     */
+    virtual bool GetQueueStatistics(cec_queue queue, cec_queue_statistics *statistics) = 0;
+
+    /*!
+     * @see cec_set_thread_config
+     */
+    virtual bool SetThreadConfig(cec_thread thread, const cec_thread_config &config) = 0;
+
+    /*!
+     * @see cec_lock_memory
+     */
+    virtual bool LockMemory(bool bLock = true) = 0;
+
+    /*!
+     * @see cec_get_lock_statistics
+     */
+    virtual unsigned int GetLockStatistics(cec_lock_statistics *statistics, unsigned int iMaxLocks) = 0;
+
+    /*!
+     * @see cec_start_trace
+     */
+    virtual bool StartTrace(const char *strFile) = 0;
+
+    /*!
+     * @see cec_stop_trace
+     */
+    virtual bool StopTrace(void) = 0;
+
+    /*!
+     * @see cec_set_command_handler
+     */
+    virtual bool SetCommandHandler(cec_opcode opcode, cec_command_handler handler, void *param = NULL) = 0;
+
     /*!
      * @see cec_transmit
      */
     virtual bool Transmit(const cec_frame &data, bool bWaitForAck = true) = 0;
 
+    /*!
+     * @see cec_transmit_message
+     */
+    virtual bool Transmit(const cec_message &message, bool bWaitForAck = true) = 0;
+
     /*!
      * @see cec_set_logical_address
      */
     virtual bool SetLogicalAddress(cec_logical_address iLogicalAddress) = 0;
 
+    /*!
+     * @see cec_set_device_type
+     */
+    virtual bool SetDeviceType(cec_device_type type) = 0;
+
+    /*!
+     * @see cec_add_logical_device
+     */
+    virtual bool AddLogicalDevice(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type) = 0;
+
+    /*!
+     * @see cec_remove_logical_device
+     */
+    virtual bool RemoveLogicalDevice(cec_logical_address iLogicalAddress) = 0;
+
     /*!
      * @see cec_power_on_devices
      */
@@ -120,9 +225,111 @@ namespace CEC
     virtual bool SetInactiveView(void) = 0;
 
   };
+
+  /*!
+   * Controls several adapters, e.g. one per HDMI bus, as a group. Keypresses, commands and adapter events
+   * of all adapters are merged into one event stream, in the order in which they were received. Commands
+   * are sent to all adapters in parallel, so they only cost the bus time of a single adapter.
+   */
+  class ICECAdapterManager
+  {
+  public:
+    virtual ~ICECAdapterManager(void) {}
+
+    /*!
+     * @brief Open connections to all given adapters at the same time.
+     * @param ports The COM ports of the adapters. The adapter id of each adapter is its index in this list.
+     * @param iTimeoutMs Connection timeout in ms for each adapter.
+     * @return The number of adapters that were opened.
+     */
+    virtual int Open(const std::vector<std::string> &ports, uint64_t iTimeoutMs = 10000) = 0;
+
+    /*!
+     * @brief Close the connections to all adapters.
+     */
+    virtual void Close(void) = 0;
+
+    /*!
+     * @brief Use the shared reactor for all adapters that are opened after this call.
+     * @see cec_use_shared_reactor
+     */
+    virtual bool UseSharedReactor(bool bEnable = true) = 0;
+
+    /*!
+     * @return The number of adapters that were passed to Open().
+     */
+    virtual int GetAdapterCount(void) = 0;
+
+    /*!
+     * @brief Get the instance that controls a single adapter, e.g. to read its log messages.
+     * Keypresses, commands and adapter events of this instance are only passed to GetNextEvent().
+     * @param iAdapterId The id of the adapter.
+     * @return The instance, or NULL when the id is invalid. Owned by the manager.
+     */
+    virtual ICECAdapter *GetAdapter(int iAdapterId) = 0;
+
+    /*!
+     * @brief Get the next keypress, command or adapter event of any of the adapters.
+     * @param event The next event.
+     * @return True when an event was passed, false otherwise.
+     */
+    virtual bool GetNextEvent(cec_event *event) = 0;
+
+    /*!
+     * @brief Get up to iMaxEvents events at once.
+     * @param events The array to copy the events to.
+     * @param iMaxEvents The size of events.
+     * @return The number of events that were copied.
+     */
+    virtual unsigned int GetNextEvents(cec_event *events, unsigned int iMaxEvents) = 0;
+
+    /*!
+     * @brief Change the overflow policy, capacity and high watermark of the merged event queue.
+     * @see cec_set_queue_config
+     */
+    virtual void SetEventQueueConfig(const cec_queue_config &config) = 0;
+
+    /*!
+     * @brief Get the statistics of the merged event queue.
+     * @see cec_get_queue_statistics
+     */
+    virtual void GetEventQueueStatistics(cec_queue_statistics *statistics) = 0;
+
+    /*!
+     * @brief Transmit a frame on all adapters in parallel.
+     * @see cec_transmit
+     * @return The number of adapters that transmitted the frame.
+     */
+    virtual int Transmit(const cec_frame &data, bool bWaitForAck = true) = 0;
+
+    /*!
+     * @see cec_power_on_devices
+     * @return The number of adapters that transmitted the command.
+     */
+    virtual int PowerOnDevices(cec_logical_address address = CECDEVICE_TV) = 0;
+
+    /*!
+     * @see cec_standby_devices
+     * @return The number of adapters that transmitted the command.
+     */
+    virtual int StandbyDevices(cec_logical_address address = CECDEVICE_BROADCAST) = 0;
+
+    /*!
+     * @see cec_set_active_view
+     * @return The number of adapters that transmitted the command.
+     */
+    virtual int SetActiveView(void) = 0;
+
+    /*!
+     * @see cec_set_inactive_view
+     * @return The number of adapters that transmitted the command.
+     */
+    virtual int SetInactiveView(void) = 0;
+  };
 };
 
 extern DECLSPEC void * CECCreate(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+extern DECLSPEC void * CECCreateManager(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
 
 #if !defined(DLL_EXPORT)
 #if defined(_WIN32) || defined(_WIN64)
@@ -167,6 +374,41 @@ inline void UnloadLibCec(CEC::ICECAdapter *device)
   }
 };
 
+/*!
+ * @brief Create a manager for several adapters. Every adapter uses the given device name and addresses.
+ */
+inline CEC::ICECAdapterManager *LoadLibCecManager(const char *strName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS)
+{
+  typedef void* (__cdecl*_CreateLibCecManager)(const char *, uint8_t, uint16_t);
+  _CreateLibCecManager CreateLibCecManager;
+
+  if (!g_libCEC)
+    g_libCEC = LoadLibrary("libcec.dll");
+  if (!g_libCEC)
+    return NULL;
+
+  ++g_iLibCECInstanceCount;
+  CreateLibCecManager = (_CreateLibCecManager) (GetProcAddress(g_libCEC, "CECCreateManager"));
+  if (!CreateLibCecManager)
+    return NULL;
+  return static_cast< CEC::ICECAdapterManager* > (CreateLibCecManager(strName, (uint8_t) iLogicalAddress, iPhysicalAddress));
+}
+
+/*!
+ * @brief Unload the given adapter manager.
+ * @param manager The manager to unload.
+ */
+inline void UnloadLibCecManager(CEC::ICECAdapterManager *manager)
+{
+  delete manager;
+
+  if (--g_iLibCECInstanceCount == 0)
+  {
+    FreeLibrary(g_libCEC);
+    g_libCEC = NULL;
+  }
+};
+
 #else
 
 /*!
@@ -186,6 +428,24 @@ inline void UnloadLibCec(CEC::ICECAdapter *device)
   device->Close();
   delete device;
 };
+
+/*!
+ * @brief Create a manager for several adapters. Every adapter uses the given device name and addresses.
+ */
+inline CEC::ICECAdapterManager *LoadLibCecManager(const char *strName, CEC::cec_logical_address iLogicalAddress = CEC::CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS)
+{
+  return (CEC::ICECAdapterManager*) CECCreateManager(strName, iLogicalAddress, iPhysicalAddress);
+};
+
+/*!
+ * @brief Unload the given adapter manager.
+ * @param manager The manager to unload.
+ */
+inline void UnloadLibCecManager(CEC::ICECAdapterManager *manager)
+{
+  manager->Close();
+  delete manager;
+};
 #endif
 
 #endif
@@ -0,0 +1,255 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "CECExports.h"
+
+namespace CEC
+{
+  /*!
+   * @brief Builds a cec_message for an opcode: cec_message_builder<CEC_OPCODE_STANDBY>::Build(CECDEVICE_PLAYBACKDEVICE1, CECDEVICE_TV).
+   *
+   * Only opcodes that have a specialisation below can be built. Each one takes its operands as typed arguments and sets the
+   * destination itself when the opcode can only be broadcast, so a frame with missing or mistyped operands doesn't compile.
+   * The frame is built on the stack and nothing is allocated.
+   */
+  template <cec_opcode _Opcode> struct cec_message_builder;
+
+  inline void cec_message_init(cec_message &message, cec_logical_address initiator, cec_logical_address destination, cec_opcode opcode)
+  {
+    message.data[0] = (uint8_t)(((uint8_t)initiator << 4) | ((uint8_t)destination & 0xF));
+    message.data[1] = (uint8_t)opcode;
+    message.size    = 2;
+  }
+
+  inline void cec_message_push(cec_message &message, uint8_t iData)
+  {
+    if (message.size < CEC_MAX_FRAME_SIZE)
+      message.data[message.size++] = iData;
+  }
+
+  inline void cec_message_push_address(cec_message &message, uint16_t iPhysicalAddress)
+  {
+    cec_message_push(message, (uint8_t)(iPhysicalAddress >> 8));
+    cec_message_push(message, (uint8_t)iPhysicalAddress);
+  }
+
+  /*!
+   * @brief Directed messages without operands, like the requests for a status.
+   */
+  template <cec_opcode _Opcode>
+  struct cec_directed_message_builder
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, _Opcode);
+      return message;
+    }
+  };
+
+  template <> struct cec_message_builder<CEC_OPCODE_IMAGE_VIEW_ON>            : cec_directed_message_builder<CEC_OPCODE_IMAGE_VIEW_ON> {};
+  template <> struct cec_message_builder<CEC_OPCODE_TEXT_VIEW_ON>             : cec_directed_message_builder<CEC_OPCODE_TEXT_VIEW_ON> {};
+  template <> struct cec_message_builder<CEC_OPCODE_STANDBY>                  : cec_directed_message_builder<CEC_OPCODE_STANDBY> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GIVE_PHYSICAL_ADDRESS>    : cec_directed_message_builder<CEC_OPCODE_GIVE_PHYSICAL_ADDRESS> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GIVE_OSD_NAME>            : cec_directed_message_builder<CEC_OPCODE_GIVE_OSD_NAME> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GIVE_DEVICE_VENDOR_ID>    : cec_directed_message_builder<CEC_OPCODE_GIVE_DEVICE_VENDOR_ID> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GIVE_DEVICE_POWER_STATUS> : cec_directed_message_builder<CEC_OPCODE_GIVE_DEVICE_POWER_STATUS> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GET_CEC_VERSION>          : cec_directed_message_builder<CEC_OPCODE_GET_CEC_VERSION> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GET_MENU_LANGUAGE>        : cec_directed_message_builder<CEC_OPCODE_GET_MENU_LANGUAGE> {};
+  template <> struct cec_message_builder<CEC_OPCODE_GIVE_AUDIO_STATUS>        : cec_directed_message_builder<CEC_OPCODE_GIVE_AUDIO_STATUS> {};
+  template <> struct cec_message_builder<CEC_OPCODE_USER_CONTROL_RELEASE>     : cec_directed_message_builder<CEC_OPCODE_USER_CONTROL_RELEASE> {};
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_REQUEST_ACTIVE_SOURCE>
+  {
+    static cec_message Build(cec_logical_address initiator)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_REQUEST_ACTIVE_SOURCE);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_ACTIVE_SOURCE>
+  {
+    static cec_message Build(cec_logical_address initiator, uint16_t iPhysicalAddress)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_ACTIVE_SOURCE);
+      cec_message_push_address(message, iPhysicalAddress);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_INACTIVE_SOURCE>
+  {
+    static cec_message Build(cec_logical_address initiator, uint16_t iPhysicalAddress)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_TV, CEC_OPCODE_INACTIVE_SOURCE);
+      cec_message_push_address(message, iPhysicalAddress);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_SET_STREAM_PATH>
+  {
+    static cec_message Build(cec_logical_address initiator, uint16_t iPhysicalAddress)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_SET_STREAM_PATH);
+      cec_message_push_address(message, iPhysicalAddress);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_ROUTING_CHANGE>
+  {
+    static cec_message Build(cec_logical_address initiator, uint16_t iOriginalAddress, uint16_t iNewAddress)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_ROUTING_CHANGE);
+      cec_message_push_address(message, iOriginalAddress);
+      cec_message_push_address(message, iNewAddress);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_REPORT_PHYSICAL_ADDRESS>
+  {
+    static cec_message Build(cec_logical_address initiator, uint16_t iPhysicalAddress, cec_device_type type)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_REPORT_PHYSICAL_ADDRESS);
+      cec_message_push_address(message, iPhysicalAddress);
+      cec_message_push(message, (uint8_t)type);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_DEVICE_VENDOR_ID>
+  {
+    static cec_message Build(cec_logical_address initiator, uint32_t iVendorId)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, CECDEVICE_BROADCAST, CEC_OPCODE_DEVICE_VENDOR_ID);
+      cec_message_push(message, (uint8_t)(iVendorId >> 16));
+      cec_message_push(message, (uint8_t)(iVendorId >> 8));
+      cec_message_push(message, (uint8_t)iVendorId);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_FEATURE_ABORT>
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, cec_opcode opcode, cec_abort_reason reason)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_FEATURE_ABORT);
+      cec_message_push(message, (uint8_t)opcode);
+      cec_message_push(message, (uint8_t)reason);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_CEC_VERSION>
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, cec_version version)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_CEC_VERSION);
+      cec_message_push(message, (uint8_t)version);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_REPORT_POWER_STATUS>
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, cec_power_status status)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_REPORT_POWER_STATUS);
+      cec_message_push(message, (uint8_t)status);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_MENU_STATUS>
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, cec_menu_state state)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_MENU_STATUS);
+      cec_message_push(message, (uint8_t)state);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_USER_CONTROL_PRESSED>
+  {
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, cec_user_control_code key)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_USER_CONTROL_PRESSED);
+      cec_message_push(message, (uint8_t)key);
+      return message;
+    }
+  };
+
+  template <>
+  struct cec_message_builder<CEC_OPCODE_SET_OSD_NAME>
+  {
+    /*!
+     * @brief Names that are longer than the 14 characters that fit in a frame are truncated.
+     */
+    static cec_message Build(cec_logical_address initiator, cec_logical_address destination, const char *strName)
+    {
+      cec_message message;
+      cec_message_init(message, initiator, destination, CEC_OPCODE_SET_OSD_NAME);
+      for (const char *strPtr = strName; strPtr && *strPtr; strPtr++)
+        cec_message_push(message, (uint8_t)*strPtr);
+      return message;
+    }
+  };
+};
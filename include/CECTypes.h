@@ -31,15 +31,6 @@
  *     http://www.pulse-eight.net/
  */
 
-typedef enum
-{
-  CEC_ABORT_REASON_UNRECOGNIZED_OPCODE = 0,
-  CEC_ABORT_REASON_NOT_IN_CORRECT_MODE_TO_RESPOND = 1,
-  CEC_ABORT_REASON_CANNOT_PROVIDE_SOURCE = 2,
-  CEC_ABORT_REASON_INVALID_OPERAND = 3,
-  CEC_ABORT_REASON_REFUSED = 4
-} ECecAbortReason;
-
 typedef enum
 {
   CEC_ANALOGUE_BROADCAST_TYPE_CABLE = 0x00,
@@ -73,14 +64,6 @@ typedef enum
   CEC_TRUE = 1
 } ECecBoolean;
 
-typedef enum
-{
-  CEC_VERSION_1_2 = 0x01,
-  CEC_VERSION_1_2A = 0x02,
-  CEC_VERSION_1_3 = 0x03,
-  CEC_VERSION_1_3A = 0x04
-} ECecVersion;
-
 typedef enum
 {
   CEC_CHANNEL_NUMBER_FORMAT_MASK = 0xFC000000,
@@ -117,16 +100,6 @@ typedef enum
   CEC_DECK_INFO_OTHER_STATUS = 0x1F
 } ECecDeckInfo;
 
-typedef enum
-{
-  CEC_DEVICE_TYPE_TV = 0,
-  CEC_DEVICE_TYPE_RECORDING_DEVICE = 1,
-  CEC_DEVICE_TYPE_RESERVED = 2,
-  CEC_DEVICE_TYPE_TUNER = 3,
-  CEC_DEVICE_TYPE_PLAYBACK_DEVICE = 4,
-  CEC_DEVICE_TYPE_AUDIO_SYSTEM = 5
-} ECecDeviceType;
-
 typedef enum
 {
   CEC_DISPLAY_CONTROL_DISPLAY_FOR_DEFAULT_TIME = 0x00,
@@ -148,12 +121,6 @@ typedef enum
   CEC_MENU_REQUEST_TYPE_QUERY = 2
 } ECecMenuRequestType;
 
-typedef enum
-{
-  CEC_MENU_STATE_ACTIVATED = 0,
-  CEC_MENU_STATE_DEACTIVATED = 1
-} ECecMenuState;
-
 typedef enum
 {
   CEC_PLAY_MODE_PLAY_FORWARD = 0x24,
@@ -173,14 +140,6 @@ typedef enum
   CEC_PLAY_MODE_SLOW_REVERSE_MAX_SPEED = 0x1B
 } ECecPlayMode;
 
-typedef enum
-{
-  CEC_POWER_STATUS_ON = 0x00,
-  CEC_POWER_STATUS_STANDBY = 0x01,
-  CEC_POWER_STATUS_IN_TRANSITION_STANDBY_TO_ON = 0x02,
-  CEC_POWER_STATUS_IN_TRANSITION_ON_TO_STANDBY = 0x03
-} ECecPowerStatus;
-
 typedef enum
 {
   CEC_RECORD_SOURCE_TYPE_OWN_SOURCE = 1,
@@ -359,3 +318,155 @@ typedef enum
 #define MSGEND                       0xFE
 #define MSGESC                       0xFD
 #define ESCOFFSET                    3
+
+typedef enum
+{
+  CEC_OPCODE_FLAG_DIRECTED  = 0x01,
+  CEC_OPCODE_FLAG_BROADCAST = 0x02,
+  CEC_OPCODE_FLAG_REPLY     = 0x04
+} ECecOpcodeFlag;
+
+/*!
+ * @brief Describes how a message with an opcode has to look. Opcodes that aren't defined by the CEC specification have no flags set and aren't validated.
+ */
+typedef struct
+{
+  uint8_t iMinParameters; /*!< the minimum number of operands. frames with less operands are invalid */
+  uint8_t iMaxParameters; /*!< the maximum number of operands. additional operands are ignored by the receiver */
+  uint8_t iFlags;         /*!< ECecOpcodeFlag. directed, broadcast or both, and whether the receiver is expected to reply */
+} CecOpcodeDescriptor;
+
+#define CEC_OPCODE_UNUSED { 0, 0, 0 }
+
+/*!
+ * @brief Descriptors for every opcode, indexed by the opcode.
+ */
+static const CecOpcodeDescriptor CecOpcodeDescriptors[] =
+{
+  /* 0x00 FEATURE_ABORT                 */ {  2,  2, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x01 - 0x03                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x04 IMAGE_VIEW_ON                 */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x05 TUNER_STEP_INCREMENT          */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x06 TUNER_STEP_DECREMENT          */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x07 TUNER_DEVICE_STATUS           */ {  5,  8, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x08 GIVE_TUNER_DEVICE_STATUS      */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x09 RECORD_ON                     */ {  1,  8, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x0A RECORD_STATUS                 */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x0B RECORD_OFF                    */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x0C                               */ CEC_OPCODE_UNUSED,
+  /* 0x0D TEXT_VIEW_ON                  */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x0E                               */ CEC_OPCODE_UNUSED,
+  /* 0x0F RECORD_TV_SCREEN              */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x10 - 0x13                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x14 - 0x17                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x18 - 0x19                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x1A GIVE_DECK_STATUS              */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x1B DECK_STATUS                   */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x1C - 0x1F                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x20 - 0x23                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x24 - 0x27                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x28 - 0x2B                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x2C - 0x2F                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x30 - 0x31                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x32 SET_MENU_LANGUAGE             */ {  3,  3, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x33 CLEAR_ANALOGUE_TIMER          */ { 11, 11, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x34 SET_ANALOGUE_TIMER            */ { 11, 11, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x35 TIMER_STATUS                  */ {  1,  3, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x36 STANDBY                       */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x37 - 0x3A                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x3B - 0x3E                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x3F - 0x40                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x41 PLAY                          */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x42 DECK_CONTROL                  */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x43 TIMER_CLEARED_STATUS          */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x44 USER_CONTROL_PRESSED          */ {  1,  5, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x45 USER_CONTROL_RELEASE          */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x46 GIVE_OSD_NAME                 */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x47 SET_OSD_NAME                  */ {  1, 14, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x48 - 0x4B                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x4C - 0x4F                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x50 - 0x53                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x54 - 0x57                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x58 - 0x5B                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x5C - 0x5F                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x60 - 0x63                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x64 SET_OSD_STRING                */ {  2, 14, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x65 - 0x66                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x67 SET_TIMER_PROGRAM_TITLE       */ {  1, 14, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x68 - 0x6B                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x6C - 0x6F                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x70 SYSTEM_AUDIO_MODE_REQUEST     */ {  0,  2, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x71 GIVE_AUDIO_STATUS             */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x72 SET_SYSTEM_AUDIO_MODE         */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x73 - 0x76                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x77 - 0x79                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x7A REPORT_AUDIO_STATUS           */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x7B - 0x7C                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x7D GIVE_SYSTEM_AUDIO_MODE_STATUS */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x7E SYSTEM_AUDIO_MODE_STATUS      */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x7F                               */ CEC_OPCODE_UNUSED,
+  /* 0x80 ROUTING_CHANGE                */ {  4,  4, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x81 ROUTING_INFORMATION           */ {  2,  2, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x82 ACTIVE_SOURCE                 */ {  2,  2, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x83 GIVE_PHYSICAL_ADDRESS         */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x84 REPORT_PHYSICAL_ADDRESS       */ {  3,  3, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x85 REQUEST_ACTIVE_SOURCE         */ {  0,  0, CEC_OPCODE_FLAG_BROADCAST | CEC_OPCODE_FLAG_REPLY },
+  /* 0x86 SET_STREAM_PATH               */ {  2,  2, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x87 DEVICE_VENDOR_ID              */ {  3,  3, CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x88                               */ CEC_OPCODE_UNUSED,
+  /* 0x89 VENDOR_COMMAND                */ {  1, 14, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x8A VENDOR_REMOTE_BUTTON_DOWN     */ {  1, 14, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x8B VENDOR_REMOTE_BUTTON_UP       */ {  0, 14, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_BROADCAST },
+  /* 0x8C GIVE_DEVICE_VENDOR_ID         */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x8D MENU_REQUEST                  */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x8E MENU_STATUS                   */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x8F GIVE_DEVICE_POWER_STATUS      */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x90 REPORT_POWER_STATUS           */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x91 GET_MENU_LANGUAGE             */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x92 SELECT_ANALOGUE_SERVICE       */ {  4,  4, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x93 SELECT_DIGITAL_SERVICE        */ {  7,  7, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x94 - 0x96                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x97 SET_DIGITAL_TIMER             */ { 14, 14, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x98                               */ CEC_OPCODE_UNUSED,
+  /* 0x99 CLEAR_DIGITAL_TIMER           */ { 14, 14, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0x9A SET_AUDIO_RATE                */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x9B - 0x9C                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0x9D INACTIVE_SOURCE               */ {  2,  2, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x9E CEC_VERSION                   */ {  1,  1, CEC_OPCODE_FLAG_DIRECTED },
+  /* 0x9F GET_CEC_VERSION               */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0xA0 VENDOR_COMMAND_WITH_ID        */ {  3, 14, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_BROADCAST },
+  /* 0xA1 CLEAR_EXTERNAL_TIMER          */ {  9, 10, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0xA2 SET_EXTERNAL_TIMER            */ {  9, 10, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY },
+  /* 0xA3 - 0xA6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xA7 - 0xAA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xAB - 0xAE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xAF - 0xB2                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xB3 - 0xB6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xB7 - 0xBA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xBB - 0xBE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xBF - 0xC2                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xC3 - 0xC6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xC7 - 0xCA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xCB - 0xCE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xCF - 0xD2                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xD3 - 0xD6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xD7 - 0xDA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xDB - 0xDE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xDF - 0xE2                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xE3 - 0xE6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xE7 - 0xEA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xEB - 0xEE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xEF - 0xF2                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xF3 - 0xF6                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xF7 - 0xFA                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xFB - 0xFE                        */ CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED, CEC_OPCODE_UNUSED,
+  /* 0xFF ABORT                         */ {  0,  0, CEC_OPCODE_FLAG_DIRECTED | CEC_OPCODE_FLAG_REPLY }
+};
+
+/* fails to compile when an opcode is missing from the table */
+typedef char CecOpcodeDescriptorsComplete[(sizeof(CecOpcodeDescriptors) / sizeof(CecOpcodeDescriptors[0]) == 256) ? 1 : -1];
+
+inline const CecOpcodeDescriptor &GetOpcodeDescriptor(uint8_t iOpcode)
+{
+  return CecOpcodeDescriptors[iOpcode];
+}
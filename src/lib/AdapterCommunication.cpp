@@ -32,21 +32,49 @@
 
 #include "AdapterCommunication.h"
 
+#include "AdapterDetection.h"
+#include "AdapterReactor.h"
 #include "LibCEC.h"
+#include "TraceWriter.h"
+#include "platform/probes.h"
 #include "platform/serialport.h"
 #include "util/StdString.h"
+#include "platform/timeutils.h"
+
+#define CEC_DRAIN_TIMEOUT       5
+#define CEC_PING_RETRY_INTERVAL 50
+#define CEC_FW_VERSION_TIMEOUT  50
+#define CEC_MIN_INBUF_SIZE      256
+#define CEC_MAX_INBUF_SIZE      (16 * 1024)
 
 using namespace std;
 using namespace CEC;
 
 CAdapterCommunication::CAdapterCommunication(CLibCEC *controller) :
+    CThread("cec-reader"),
     m_port(NULL),
+    m_iBaudRate(38400),
     m_controller(controller),
     m_inbuf(NULL),
     m_iInbufSize(0),
     m_iInbufUsed(0),
+    m_iBytesDiscarded(0),
+    m_iUnansweredCommands(0),
+    m_iPingReply(0),
+    m_iPingResult(0),
+    m_iPingSentTime(0),
+    m_iPongTime(0),
     m_bStarted(false),
-    m_bStop(false)
+    m_iFirmwareVersion(CEC_FIRMWARE_VERSION_UNKNOWN),
+    m_iCapabilities(CEC_ADAPTER_CAPABILITY_NONE),
+    m_iLineTimeout(-1),
+    m_iAckPolarity(-1),
+    m_iPendingCommandsSize(0),
+    m_iPendingCommands(0),
+    m_bUseReactor(false),
+    m_reactor(NULL),
+    m_commMutex("comm"),
+    m_bufferMutex("comm-buffer")
 {
   m_port = new CSerialPort;
 }
@@ -60,6 +88,9 @@ CAdapterCommunication::~CAdapterCommunication(void)
     delete m_port;
     m_port = NULL;
   }
+
+  free(m_inbuf);
+  m_inbuf = NULL;
 }
 
 bool CAdapterCommunication::Open(const char *strPort, uint16_t iBaudRate /* = 38400 */, uint64_t iTimeoutMs /* = 10000 */)
@@ -68,6 +99,12 @@ bool CAdapterCommunication::Open(const char *strPort, uint16_t iBaudRate /* = 38
   if (m_bStarted || !m_port)
     return false;
 
+  int64_t iStartTime = GetTimeUs();
+  int64_t iTargetTime = iStartTime + (int64_t) iTimeoutMs * (int64_t) 1000;
+
+  m_strPort   = strPort;
+  m_iBaudRate = iBaudRate;
+
   if (!m_port->Open(strPort, iBaudRate))
   {
     CStdString strError;
@@ -80,13 +117,61 @@ bool CAdapterCommunication::Open(const char *strPort, uint16_t iBaudRate /* = 38
 
   //clear any input bytes
   uint8_t buff[1024];
-  m_port->Read(buff, sizeof(buff), 50);
+  while (GetTimeUs() < iTargetTime && m_port->Read(buff, sizeof(buff), CEC_DRAIN_TIMEOUT) > 0) {}
+  {
+    CLockObject bufferLock(&m_bufferMutex);
+    m_iInbufUsed          = 0;
+    m_iUnansweredCommands = 0;
+    m_iPingReply          = 0;
+  }
+
+  if (!WaitForAdapter(iTargetTime))
+  {
+    CStdString strError;
+    strError.Format("the adapter did not respond within %d ms", (int) iTimeoutMs);
+    m_controller->AddLog(CEC_LOG_ERROR, strError);
+    m_port->Close();
+    return false;
+  }
+
+  CStdString strLog;
+  strLog.Format("adapter responded after %d ms", (int) ((GetTimeUs() - iStartTime) / (int64_t)1000));
+  m_controller->AddLog(CEC_LOG_DEBUG, strLog);
+
+  QueryFirmwareVersion(iTargetTime);
 
-  Sleep(CEC_SETTLE_DOWN_TIME);
+  if (m_bUseReactor)
+  {
+    m_bStop    = false;
+    m_bStarted = true;
+    if ((m_reactor = CAdapterReactor::Acquire()) != NULL && m_reactor->Register(this))
+    {
+      m_controller->AddLog(CEC_LOG_DEBUG, "using the shared reactor");
+      if (HasThreadConfig() && !m_reactor->SetThreadConfig(GetThreadConfig()))
+        m_controller->AddLog(CEC_LOG_WARNING, "could not apply the configuration of the reader thread to the shared reactor");
+      return true;
+    }
+
+    m_controller->AddLog(CEC_LOG_ERROR, "could not register with the shared reactor");
+    if (m_reactor)
+    {
+      CAdapterReactor::Release();
+      m_reactor = NULL;
+    }
+    m_bStarted = false;
+    m_port->Close();
+    return false;
+  }
 
   if (CreateThread())
   {
     m_controller->AddLog(CEC_LOG_DEBUG, "reader thread created");
+    if (GetThreadConfigError() != 0)
+    {
+      CStdString strError;
+      strError.Format("could not apply the configuration of the reader thread: %s", strerror(GetThreadConfigError()));
+      m_controller->AddLog(CEC_LOG_WARNING, strError);
+    }
     m_bStarted = true;
     return true;
   }
@@ -98,13 +183,138 @@ bool CAdapterCommunication::Open(const char *strPort, uint16_t iBaudRate /* = 38
   return false;
 }
 
+bool CAdapterCommunication::Reopen(uint64_t iTimeoutMs)
+{
+  string strPort(m_strPort);
+  if (strPort.empty())
+    return false;
+
+  Close();
+  if (Open(strPort.c_str(), m_iBaudRate, iTimeoutMs))
+    return true;
+
+  //the adapter may have been assigned another port after a USB reset
+  vector<cec_adapter> adapters;
+  if (CAdapterDetection::FindAdapters(adapters) == 1 && adapters[0].comm != strPort)
+  {
+    CStdString strLog;
+    strLog.Format("trying to reconnect to '%s' on '%s'", strPort.c_str(), adapters[0].comm.c_str());
+    m_controller->AddLog(CEC_LOG_NOTICE, strLog);
+    return Open(adapters[0].comm.c_str(), m_iBaudRate, iTimeoutMs);
+  }
+
+  return false;
+}
+
+bool CAdapterCommunication::WaitForAdapter(int64_t iTargetTime)
+{
+  cec_frame output;
+  output.push_back(MSGSTART);
+  PushEscaped(output, MSGCODE_PING);
+  output.push_back(MSGEND);
+
+  int64_t iNow = GetTimeUs();
+  while (iNow < iTargetTime)
+  {
+    if (!WriteToDevice(output, 1))
+      return false;
+
+    //wait for the adapter to accept the ping, and send another one if it doesn't respond in time
+    int64_t iRetryTime = iNow + (int64_t) CEC_PING_RETRY_INTERVAL * (int64_t) 1000;
+    if (iRetryTime > iTargetTime)
+      iRetryTime = iTargetTime;
+
+    cec_frame response;
+    if (ReadResponse(MSGCODE_COMMAND_ACCEPTED, response, iRetryTime))
+      return true;
+
+    iNow = GetTimeUs();
+  }
+
+  return false;
+}
+
+void CAdapterCommunication::QueryFirmwareVersion(int64_t iTargetTime)
+{
+  m_iFirmwareVersion = CEC_FIRMWARE_VERSION_UNKNOWN;
+  m_iCapabilities    = CEC_ADAPTER_CAPABILITY_NONE;
+  m_iLineTimeout     = -1;
+  m_iAckPolarity     = -1;
+  m_iPendingCommandsSize = 0;
+  m_iPendingCommands     = 0;
+
+  cec_frame output;
+  output.push_back(MSGSTART);
+  PushEscaped(output, MSGCODE_FIRMWARE_VERSION);
+  output.push_back(MSGEND);
+
+  int64_t iResponseTime = GetTimeUs() + (int64_t) CEC_FW_VERSION_TIMEOUT * (int64_t) 1000;
+  if (iResponseTime > iTargetTime)
+    iResponseTime = iTargetTime;
+
+  //the adapter replies with its version instead of accepting the command, so it's not counted as a command
+  cec_frame response;
+  if (WriteToDevice(output, 0) && ReadResponse(MSGCODE_FIRMWARE_VERSION, response, iResponseTime) && response.size() >= 3)
+    m_iFirmwareVersion = (response[1] << 8) | response[2];
+  else
+    m_iFirmwareVersion = 1; //the first firmware version doesn't support this command
+
+  //firmware v2 and up report the result of every transmission, and support setting the line timeout
+  if (m_iFirmwareVersion >= 2)
+    m_iCapabilities |= CEC_ADAPTER_CAPABILITY_PIPELINED_TRANSMIT | CEC_ADAPTER_CAPABILITY_LINE_TIMEOUT;
+
+  CStdString strLog;
+  strLog.Format("firmware version %d, capabilities %02x", m_iFirmwareVersion, m_iCapabilities);
+  m_controller->AddLog(CEC_LOG_NOTICE, strLog);
+}
+
+bool CAdapterCommunication::ReadResponse(uint8_t iCode, cec_frame &response, int64_t iTargetTime)
+{
+  int64_t iNow = GetTimeUs();
+  while (iNow < iTargetTime)
+  {
+    if (!ReadFromDevice((uint64_t) ((iTargetTime - iNow + 999) / 1000)))
+      return false;
+
+    cec_frame msg;
+    while (Read(msg, 0))
+    {
+      if (msg.empty())
+        continue;
+
+      uint8_t iMsgCode = msg[0] & ~(MSGCODE_FRAME_EOM | MSGCODE_FRAME_ACK);
+      if (iMsgCode == iCode)
+      {
+        response = msg;
+        return true;
+      }
+      else if (iMsgCode == MSGCODE_COMMAND_REJECTED)
+      {
+        return false;
+      }
+    }
+
+    iNow = GetTimeUs();
+  }
+
+  return false;
+}
+
 void CAdapterCommunication::Close(void)
 {
   CLockObject lock(&m_commMutex);
-  if (m_port)
-    m_port->Close();
 
+  //stop the reader thread before closing the port it's reading from
+  if (m_reactor)
+  {
+    m_reactor->Unregister(this);
+    CAdapterReactor::Release();
+    m_reactor  = NULL;
+    m_bStarted = false;
+  }
   StopThread();
+  if (m_port)
+    m_port->Close();
 }
 
 void *CAdapterCommunication::Process(void)
@@ -113,24 +323,62 @@ void *CAdapterCommunication::Process(void)
 
   while (!m_bStop)
   {
-    CLockObject lock(&m_commMutex);
     if (!ReadFromDevice(250))
     {
       m_bStarted = false;
       break;
     }
-
-    if (!m_bStop)
-    {
-      lock.Leave();
-      Sleep(50);
-    }
   }
 
   m_bStarted = false;
   return NULL;
 }
 
+bool CAdapterCommunication::SetThreadConfig(const cec_thread_config &config)
+{
+  if (!CThread::SetThreadConfig(config))
+    return false;
+
+  //the shared reactor's I/O thread reads the data of this adapter
+  CLockObject lock(&m_commMutex);
+  return m_reactor ? m_reactor->SetThreadConfig(config) : true;
+}
+
+bool CAdapterCommunication::SetUseReactor(bool bEnable)
+{
+#if !defined(__WINDOWS__)
+  CLockObject lock(&m_commMutex);
+  if (m_bStarted)
+    return false;
+
+  m_bUseReactor = bEnable;
+  return true;
+#else
+  return !bEnable;
+#endif
+}
+
+int CAdapterCommunication::GetFileDescriptor(void)
+{
+#if !defined(__WINDOWS__)
+  return m_port ? m_port->GetFd() : -1;
+#else
+  return -1;
+#endif
+}
+
+bool CAdapterCommunication::ProcessInput(void)
+{
+  //called by the reactor when the port is readable, so this won't wait
+  if (!ReadFromDevice(1))
+  {
+    m_bStarted = false;
+    return false;
+  }
+
+  return true;
+}
+
 bool CAdapterCommunication::ReadFromDevice(uint64_t iTimeout)
 {
   uint8_t buff[1024];
@@ -138,7 +386,7 @@ bool CAdapterCommunication::ReadFromDevice(uint64_t iTimeout)
     return false;
 
   int32_t iBytesRead = m_port->Read(buff, sizeof(buff), iTimeout);
-  if (iBytesRead < 0 || iBytesRead > 256)
+  if (iBytesRead < 0)
   {
     CStdString strError;
     strError.Format("error reading from serial port: %s", m_port->GetError().c_str());
@@ -146,45 +394,155 @@ bool CAdapterCommunication::ReadFromDevice(uint64_t iTimeout)
     return false;
   }
   else if (iBytesRead > 0)
-    AddData(buff, (uint8_t) iBytesRead);
+  {
+    CEC_PROBE3(serial_read, buff, iBytesRead, GetTimeUs());
+    if (CTraceWriter::IsEnabled())
+      CTraceWriter::AddInstant("read", GetTimeUs(), "bytes", iBytesRead);
+    AddData(buff, (uint32_t) iBytesRead);
+  }
 
   return true;
 }
 
-void CAdapterCommunication::AddData(uint8_t *data, uint8_t iLen)
+void CAdapterCommunication::AddData(uint8_t *data, uint32_t iLen)
 {
   CLockObject lock(&m_bufferMutex);
-  if (iLen + m_iInbufUsed > m_iInbufSize)
+  if ((int) iLen + m_iInbufUsed > m_iInbufSize)
   {
-    m_iInbufSize = iLen + m_iInbufUsed;
-    m_inbuf = (uint8_t*)realloc(m_inbuf, m_iInbufSize);
+    //grow in steps, so a backlog doesn't reallocate on every read, but never keep more than a few seconds of input
+    int iSize = m_iInbufSize > 0 ? m_iInbufSize : CEC_MIN_INBUF_SIZE;
+    while (iSize < (int) iLen + m_iInbufUsed && iSize < CEC_MAX_INBUF_SIZE)
+      iSize *= 2;
+    if (iSize > CEC_MAX_INBUF_SIZE)
+      iSize = CEC_MAX_INBUF_SIZE;
+
+    if (iSize > m_iInbufSize)
+    {
+      uint8_t *inbuf = (uint8_t*)realloc(m_inbuf, iSize);
+      if (inbuf)
+      {
+        m_inbuf      = inbuf;
+        m_iInbufSize = iSize;
+      }
+    }
+
+    if ((int) iLen + m_iInbufUsed > m_iInbufSize)
+    {
+      m_iBytesDiscarded += iLen;
+      lock.Leave();
+
+      CStdString strError;
+      strError.Format("input buffer is full, dropping %u bytes", iLen);
+      m_controller->AddLog(CEC_LOG_ERROR, strError);
+      return;
+    }
   }
 
   memcpy(m_inbuf + m_iInbufUsed, data, iLen);
   m_iInbufUsed += iLen;
   lock.Leave();
-  m_condition.Signal();
+  m_condition.Broadcast();
+}
+
+bool CAdapterCommunication::Write(const cec_frame &data, unsigned int iCommands)
+{
+  return Write(&data[0], (unsigned int) data.size(), iCommands);
 }
 
-bool CAdapterCommunication::Write(const cec_frame &data)
+bool CAdapterCommunication::Write(const uint8_t *data, unsigned int iSize, unsigned int iCommands)
 {
   CLockObject lock(&m_commMutex);
 
-  if (m_port->Write(data) != (int) data.size())
+  if (!WriteToDevice(data, iSize, iCommands))
+    return false;
+
+  m_controller->AddLog(CEC_LOG_DEBUG, "command sent");
+
+  //wait for the data to be sent, unless the firmware reports the result of the transmission itself
+  if (!HasCapability(CEC_ADAPTER_CAPABILITY_PIPELINED_TRANSMIT))
+    Sleep((int) iSize * 24 /*data*/ + 5 /*start bit (4.5 ms)*/ + 50 /* to be on the safe side */);
+
+  return true;
+}
+
+bool CAdapterCommunication::WriteToDevice(const cec_frame &data, unsigned int iCommands)
+{
+  return WriteToDevice(&data[0], (unsigned int) data.size(), iCommands);
+}
+
+bool CAdapterCommunication::WriteToDevice(const uint8_t *data, unsigned int iSize, unsigned int iCommands)
+{
+  //commands that were queued are sent in the same write
+  serial_buffer buffers[2] = { { m_pendingCommands, m_iPendingCommandsSize }, { data, iSize } };
+  unsigned int iTotalSize = m_iPendingCommandsSize + iSize;
+  unsigned int iTotalCommands = m_iPendingCommands + iCommands;
+
+  if (m_port->Write(buffers, 2) != (int) iTotalSize)
   {
     CStdString strError;
     strError.Format("error writing to serial port: %s", m_port->GetError().c_str());
     m_controller->AddLog(CEC_LOG_ERROR, strError);
+
+    //we don't know which of the queued commands made it to the adapter, so they stay queued and are sent again
+    //with the next write. the line timeout and ack polarity that were cached for them stay valid. the queue is
+    //emptied when the connection is opened again
     return false;
   }
 
-  m_controller->AddLog(CEC_LOG_DEBUG, "command sent");
+  m_iPendingCommandsSize = 0;
+  m_iPendingCommands     = 0;
+
+  //every command that was written is accepted or rejected by the adapter, in the order it was written
+  {
+    CLockObject lock(&m_bufferMutex);
+    m_iUnansweredCommands += iTotalCommands;
+  }
+
+  CEC_PROBE4(serial_write, data, iSize, iTotalSize, GetTimeUs());
+  return true;
+}
+
+void CAdapterCommunication::AddReply(bool bAccepted)
+{
+  //called with m_bufferMutex held
+  if (m_iUnansweredCommands > 0)
+    m_iUnansweredCommands--;
+
+  if (m_iPingReply > 0 && --m_iPingReply == 0)
+  {
+    m_iPingResult = bAccepted ? 1 : -1;
+    m_iPongTime   = GetTimeUs();
+  }
+}
 
-  Sleep((int) data.size() * 24 /*data*/ + 5 /*start bit (4.5 ms)*/ + 50 /* to be on the safe side */);
+bool CAdapterCommunication::QueueCommand(uint8_t iCode, const uint8_t *params, unsigned int iParams)
+{
+  uint8_t command[CEC_MAX_PENDING_COMMANDS_SIZE];
+  unsigned int iSize = 0;
+  command[iSize++] = MSGSTART;
+  PushEscaped(command, iSize, iCode);
+  for (unsigned int iPtr = 0; iPtr < iParams; iPtr++)
+    PushEscaped(command, iSize, params[iPtr]);
+  command[iSize++] = MSGEND;
+
+  if (m_iPendingCommandsSize + iSize > CEC_MAX_PENDING_COMMANDS_SIZE && !WriteToDevice(NULL, 0, 0))
+    return false;
 
+  memcpy(m_pendingCommands + m_iPendingCommandsSize, command, iSize);
+  m_iPendingCommandsSize += iSize;
+  m_iPendingCommands++;
   return true;
 }
 
+bool CAdapterCommunication::WaitForData(uint64_t iTimeout)
+{
+  CLockObject lock(&m_bufferMutex);
+  if (m_iInbufUsed < 1)
+    m_condition.Wait(&m_bufferMutex, iTimeout);
+
+  return m_iInbufUsed > 0;
+}
+
 bool CAdapterCommunication::Read(cec_frame &msg, uint64_t iTimeout)
 {
   CLockObject lock(&m_bufferMutex);
@@ -206,14 +564,15 @@ bool CAdapterCommunication::Read(cec_frame &msg, uint64_t iTimeout)
     }
   }
 
+  //drop anything before the first start of message. without one, none of the data can be parsed
   if (startpos == -1)
+  {
+    DiscardData(m_iInbufUsed);
     return false;
-
-  //move anything from the first start of message to the beginning of the buffer
-  if (startpos > 0)
+  }
+  else if (startpos > 0)
   {
-    memmove(m_inbuf, m_inbuf + startpos, m_iInbufUsed - startpos);
-    m_iInbufUsed -= startpos;
+    DiscardData(startpos);
   }
 
   if (m_iInbufUsed < 2)
@@ -239,8 +598,7 @@ bool CAdapterCommunication::Read(cec_frame &msg, uint64_t iTimeout)
   if (startpos > 0) //we found a msgstart before msgend, this is not right, remove
   {
     m_controller->AddLog(CEC_LOG_ERROR, "received MSGSTART before MSGEND");
-    memmove(m_inbuf, m_inbuf + startpos, m_iInbufUsed - startpos);
-    m_iInbufUsed -= startpos;
+    DiscardData(startpos);
     return false;
   }
 
@@ -270,12 +628,26 @@ bool CAdapterCommunication::Read(cec_frame &msg, uint64_t iTimeout)
 
     m_iInbufUsed -= endpos + 1;
 
+    uint8_t iCode = msg.empty() ? (uint8_t) MSGCODE_NOTHING : (uint8_t) (msg[0] & ~(MSGCODE_FRAME_EOM | MSGCODE_FRAME_ACK));
+    if (iCode == MSGCODE_COMMAND_ACCEPTED || iCode == MSGCODE_COMMAND_REJECTED)
+      AddReply(iCode == MSGCODE_COMMAND_ACCEPTED);
+
+    CEC_PROBE4(adapter_message, msg.empty() ? 0 : msg[0], msg.empty() ? NULL : &msg[0], msg.size(), GetTimeUs());
     return true;
   }
 
   return false;
 }
 
+void CAdapterCommunication::DiscardData(int iLen)
+{
+  //called with m_bufferMutex held
+  if (iLen < m_iInbufUsed)
+    memmove(m_inbuf, m_inbuf + iLen, m_iInbufUsed - iLen);
+  m_iInbufUsed      -= iLen;
+  m_iBytesDiscarded += (uint64_t) iLen;
+}
+
 std::string CAdapterCommunication::GetError(void) const
 {
   return m_port->GetError();
@@ -287,12 +659,8 @@ bool CAdapterCommunication::StartBootloader(void)
     return false;
 
   m_controller->AddLog(CEC_LOG_DEBUG, "starting the bootloader");
-  cec_frame output;
-  output.push_back(MSGSTART);
-  PushEscaped(output, MSGCODE_START_BOOTLOADER);
-  output.push_back(MSGEND);
-
-  if (!Write(output))
+  CLockObject lock(&m_commMutex);
+  if (!QueueCommand(MSGCODE_START_BOOTLOADER, NULL, 0) || !WriteToDevice(NULL, 0, 0))
   {
     m_controller->AddLog(CEC_LOG_ERROR, "could not start the bootloader");
     return false;
@@ -314,6 +682,19 @@ void CAdapterCommunication::PushEscaped(cec_frame &vec, uint8_t byte)
   }
 }
 
+void CAdapterCommunication::PushEscaped(uint8_t *buffer, unsigned int &iPos, uint8_t byte)
+{
+  if (byte >= MSGESC && byte != MSGSTART)
+  {
+    buffer[iPos++] = MSGESC;
+    buffer[iPos++] = byte - ESCOFFSET;
+  }
+  else
+  {
+    buffer[iPos++] = byte;
+  }
+}
+
 bool CAdapterCommunication::SetAckMask(uint16_t iMask)
 {
   if (!IsRunning())
@@ -323,15 +704,10 @@ bool CAdapterCommunication::SetAckMask(uint16_t iMask)
   strLog.Format("setting ackmask to %2x", iMask);
   m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
 
-  cec_frame output;
-
-  output.push_back(MSGSTART);
-  PushEscaped(output, MSGCODE_SET_ACK_MASK);
-  PushEscaped(output, iMask >> 8);
-  PushEscaped(output, (uint8_t)iMask);
-  output.push_back(MSGEND);
-
-  if (!Write(output))
+  //the mask has to be active right away, so it's not left in the queue
+  uint8_t params[2] = { (uint8_t) (iMask >> 8), (uint8_t) iMask };
+  CLockObject lock(&m_commMutex);
+  if (!QueueCommand(MSGCODE_SET_ACK_MASK, params, 2) || !WriteToDevice(NULL, 0, 0))
   {
     m_controller->AddLog(CEC_LOG_ERROR, "could not set the ackmask");
     return false;
@@ -346,19 +722,106 @@ bool CAdapterCommunication::PingAdapter(void)
     return false;
 
   m_controller->AddLog(CEC_LOG_DEBUG, "sending ping");
-  cec_frame output;
-  output.push_back(MSGSTART);
-  PushEscaped(output, MSGCODE_PING);
-  output.push_back(MSGEND);
+  CLockObject lock(&m_commMutex);
+  if (!QueueCommand(MSGCODE_PING, NULL, 0))
+  {
+    m_controller->AddLog(CEC_LOG_ERROR, "could not send ping command");
+    return false;
+  }
+
+  //the ping is the last of the queued commands, so its reply is the one after those of every command before it
+  {
+    CLockObject bufferLock(&m_bufferMutex);
+    m_iPingReply  = m_iUnansweredCommands + m_iPendingCommands;
+    m_iPingResult = 0;
+  }
 
-  if (!Write(output))
+  if (!WriteToDevice(NULL, 0, 0))
   {
+    CancelPing();
     m_controller->AddLog(CEC_LOG_ERROR, "could not send ping command");
     return false;
   }
 
+  {
+    CLockObject bufferLock(&m_bufferMutex);
+    m_iPingSentTime = GetTimeUs();
+  }
+
   m_controller->AddLog(CEC_LOG_DEBUG, "ping tranmitted");
+  return true;
+}
+
+int CAdapterCommunication::GetPingResult(int64_t &iRtt)
+{
+  CLockObject lock(&m_bufferMutex);
+  if (m_iPingResult != 0)
+    iRtt = m_iPongTime > m_iPingSentTime ? m_iPongTime - m_iPingSentTime : 0;
+  return m_iPingResult;
+}
+
+void CAdapterCommunication::CancelPing(void)
+{
+  //the replies are out of step with the commands when the adapter didn't reply in time, so start counting again
+  CLockObject lock(&m_bufferMutex);
+  m_iPingReply          = 0;
+  m_iPingResult         = 0;
+  m_iUnansweredCommands = 0;
+}
+
+bool CAdapterCommunication::SetLineTimeout(uint8_t iTimeout)
+{
+  if (!IsRunning() || !HasCapability(CEC_ADAPTER_CAPABILITY_LINE_TIMEOUT))
+    return false;
 
-  // TODO check for pong
+  CLockObject lock(&m_commMutex);
+  if (m_iLineTimeout == (int) iTimeout)
+    return true;
+
+  CStdString strLog;
+  strLog.Format("setting the line timeout to %d", iTimeout);
+  m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
+
+  //sent together with the next write
+  if (!QueueCommand(MSGCODE_TRANSMIT_IDLETIME, &iTimeout, 1))
+  {
+    m_controller->AddLog(CEC_LOG_ERROR, "could not set the line timeout");
+    return false;
+  }
+
+  m_iLineTimeout = iTimeout;
   return true;
 }
+
+bool CAdapterCommunication::SetAckPolarity(bool bHigh)
+{
+  if (!IsRunning())
+    return false;
+
+  CLockObject lock(&m_commMutex);
+  if (m_iAckPolarity == (bHigh ? 1 : 0))
+    return true;
+
+  //sent together with the next write
+  uint8_t iPolarity = bHigh ? CEC_TRUE : CEC_FALSE;
+  if (!QueueCommand(MSGCODE_TRANSMIT_ACK_POLARITY, &iPolarity, 1))
+  {
+    m_controller->AddLog(CEC_LOG_ERROR, "could not set the ack polarity");
+    return false;
+  }
+
+  m_iAckPolarity = bHigh ? 1 : 0;
+  return true;
+}
+
+void CAdapterCommunication::GetWriteStatistics(uint64_t &iWriteCalls, uint64_t &iBytesWritten)
+{
+  m_port->GetWriteStatistics(iWriteCalls, iBytesWritten);
+}
+
+void CAdapterCommunication::GetReadStatistics(uint32_t &iInputBufferSize, uint64_t &iBytesDiscarded)
+{
+  CLockObject lock(&m_bufferMutex);
+  iInputBufferSize = (uint32_t) m_iInbufSize;
+  iBytesDiscarded  = m_iBytesDiscarded;
+}
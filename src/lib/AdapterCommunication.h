@@ -38,6 +38,16 @@ namespace CEC
 {
   class CSerialPort;
   class CLibCEC;
+  class CAdapterReactor;
+
+  typedef enum cec_adapter_capability
+  {
+    CEC_ADAPTER_CAPABILITY_NONE               = 0x00,
+    CEC_ADAPTER_CAPABILITY_PIPELINED_TRANSMIT = 0x01,
+    CEC_ADAPTER_CAPABILITY_LINE_TIMEOUT       = 0x02
+  } cec_adapter_capability;
+
+  #define CEC_MAX_PENDING_COMMANDS_SIZE 32
 
   class CAdapterCommunication : CThread
   {
@@ -46,29 +56,81 @@ namespace CEC
     virtual ~CAdapterCommunication();
 
     bool Open(const char *strPort, uint16_t iBaudRate = 38400, uint64_t iTimeoutMs = 10000);
+    bool Reopen(uint64_t iTimeoutMs);
     bool Read(cec_frame &msg, uint64_t iTimeout = 1000);
-    bool Write(const cec_frame &frame);
+    bool WaitForData(uint64_t iTimeout);
+    /*!
+     * @brief Write formatted commands to the adapter, after the commands that were queued.
+     * @param iCommands The number of commands in data, that the adapter accepts or rejects.
+     */
+    bool Write(const cec_frame &frame, unsigned int iCommands);
+    bool Write(const uint8_t *data, unsigned int iSize, unsigned int iCommands);
     bool PingAdapter(void);
+    /*!
+     * @brief Check whether the adapter replied to the last ping. Replies are matched while messages are read with Read().
+     * @param iRtt Set to the time between writing the ping and reading the reply, in microseconds.
+     * @return 1 when the ping was accepted, -1 when it was rejected, 0 when the reply hasn't been read yet.
+     */
+    int GetPingResult(int64_t &iRtt);
+    void CancelPing(void);
     void Close(void);
     bool IsOpen(void) const { return !m_bStop && m_bStarted; }
     std::string GetError(void) const;
+    std::string GetPortName(void) const { return m_strPort; }
 
     void *Process(void);
+    virtual bool IsRunning(void) const { return m_reactor ? m_bStarted : CThread::IsRunning(); }
+
+    bool SetUseReactor(bool bEnable);
+    bool SetThreadConfig(const cec_thread_config &config);
+    int GetFileDescriptor(void);
+    bool ProcessInput(void);
 
     bool StartBootloader(void);
     bool SetAckMask(uint16_t iMask);
+    bool SetLineTimeout(uint8_t iTimeout);
+    bool SetAckPolarity(bool bHigh);
+    void GetWriteStatistics(uint64_t &iWriteCalls, uint64_t &iBytesWritten);
+    void GetReadStatistics(uint32_t &iInputBufferSize, uint64_t &iBytesDiscarded);
+    uint16_t GetFirmwareVersion(void) const { return m_iFirmwareVersion; }
+    bool HasCapability(cec_adapter_capability capability) const { return (m_iCapabilities & capability) != 0; }
     static void PushEscaped(cec_frame &vec, uint8_t byte);
+    static void PushEscaped(uint8_t *buffer, unsigned int &iPos, uint8_t byte);
   private:
-    void AddData(uint8_t *data, uint8_t iLen);
+    void AddData(uint8_t *data, uint32_t iLen);
+    void DiscardData(int iLen);
     bool ReadFromDevice(uint64_t iTimeout);
+    bool WriteToDevice(const cec_frame &data, unsigned int iCommands);
+    bool WriteToDevice(const uint8_t *data, unsigned int iSize, unsigned int iCommands);
+    bool WaitForAdapter(int64_t iTargetTime);
+    void QueryFirmwareVersion(int64_t iTargetTime);
+    bool ReadResponse(uint8_t iCode, cec_frame &response, int64_t iTargetTime);
+    bool QueueCommand(uint8_t iCode, const uint8_t *params, unsigned int iParams);
+    void AddReply(bool bAccepted);
 
     CSerialPort *        m_port;
+    std::string          m_strPort;
+    uint16_t             m_iBaudRate;
     CLibCEC *            m_controller;
     uint8_t*             m_inbuf;
     int                  m_iInbufSize;
     int                  m_iInbufUsed;
+    uint64_t             m_iBytesDiscarded;
+    uint32_t             m_iUnansweredCommands; /*!< commands that were written but that the adapter didn't accept or reject yet */
+    uint32_t             m_iPingReply;          /*!< the number of replies to read before the reply to the ping, 0 when no ping is pending */
+    int                  m_iPingResult;
+    int64_t              m_iPingSentTime;
+    int64_t              m_iPongTime;
     bool                 m_bStarted;
-    bool                 m_bStop;
+    uint16_t             m_iFirmwareVersion;
+    uint8_t              m_iCapabilities;
+    int                  m_iLineTimeout;        /*!< the line timeout that was sent to the adapter, -1 when unknown */
+    int                  m_iAckPolarity;        /*!< the ack polarity that was sent to the adapter, -1 when unknown */
+    uint8_t              m_pendingCommands[CEC_MAX_PENDING_COMMANDS_SIZE];
+    unsigned int         m_iPendingCommandsSize;
+    unsigned int         m_iPendingCommands;    /*!< the number of commands in m_pendingCommands */
+    bool                 m_bUseReactor;
+    CAdapterReactor *    m_reactor;
     CMutex               m_commMutex;
     CMutex               m_bufferMutex;
     CCondition           m_condition;
@@ -31,13 +31,17 @@
  */
 
 #include "AdapterDetection.h"
+#include "LibCEC.h"
 #include "platform/os-dependent.h"
 #include "util/StdString.h"
 
 #if !defined(__WINDOWS__)
 #include <dirent.h>
 #include <libudev.h>
+#include <limits.h>
 #include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
 #else
 #include <setupapi.h>
 
@@ -52,111 +56,123 @@ using namespace CEC;
 using namespace std;
 
 #if !defined(__WINDOWS__)
-bool TranslateComPort(CStdString &strString)
+bool ReadHexAttribute(const CStdString &strPath, int &iValue)
 {
-  CStdString strTmp(strString);
-  strTmp.MakeReverse();
-  int iSlash = strTmp.Find('/');
-  if (iSlash >= 0)
-  {
-    strTmp = strTmp.Left(iSlash);
-    strTmp.MakeReverse();
-    strString.Format("%s/%s:1.0/tty", strString.c_str(), strTmp.c_str());
-    return true;
-  }
+  FILE *fp = fopen(strPath.c_str(), "r");
+  if (!fp)
+    return false;
 
-  return false;
+  bool bReturn = fscanf(fp, "%x", &iValue) == 1;
+  fclose(fp);
+  return bReturn;
 }
 
-bool FindComPort(CStdString &strLocation)
+int CAdapterDetection::FindAdaptersSysfs(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */, const char *strSysfsRoot /* = "/sys" */)
 {
-  CStdString strPort = strLocation;
-  bool bReturn(!strPort.IsEmpty());
-  CStdString strConfigLocation(strLocation);
-  if (TranslateComPort(strConfigLocation))
+  int iFound(0);
+  CStdString strTtyPath;
+  strTtyPath.Format("%s/class/tty", strSysfsRoot);
+
+  DIR *dir;
+  struct dirent *dirent;
+  if ((dir = opendir(strTtyPath.c_str())) == NULL)
+    return -1;
+
+  while ((dirent = readdir(dir)) != NULL)
   {
-    DIR *dir;
-    struct dirent *dirent;
-    if((dir = opendir(strConfigLocation.c_str())) == NULL)
-      return bReturn;
+    if (dirent->d_name[0] == '.')
+      continue;
 
-    while ((dirent = readdir(dir)) != NULL)
-    {
-      if(strcmp((char*)dirent->d_name, "." ) != 0 && strcmp((char*)dirent->d_name, ".." ) != 0)
-      {
-        strPort.Format("/dev/%s", dirent->d_name);
-        if (!strPort.IsEmpty())
-        {
-          strLocation = strPort;
-          bReturn = true;
-          break;
-        }
-      }
-    }
-    closedir(dir);
+    // virtual terminals don't have a device link. for usb serial ports it points to the usb interface
+    CStdString strDeviceLink;
+    strDeviceLink.Format("%s/%s/device", strTtyPath.c_str(), dirent->d_name);
+    char strInterface[PATH_MAX];
+    if (readlink(strDeviceLink.c_str(), strInterface, sizeof(strInterface)) <= 0 ||
+        !realpath(strDeviceLink.c_str(), strInterface))
+      continue;
+
+    // and the parent of the interface is the usb device
+    char *strSlash = strrchr(strInterface, '/');
+    if (!strSlash || strSlash == strInterface)
+      continue;
+    *strSlash = 0;
+
+    CStdString strPath(strInterface);
+    int iVendor, iProduct;
+    if (!ReadHexAttribute(strPath + "/idVendor", iVendor) || iVendor != CEC_VID ||
+        !ReadHexAttribute(strPath + "/idProduct", iProduct) || iProduct != CEC_PID)
+      continue;
+
+    if (strDevicePath && strcmp(strPath.c_str(), strDevicePath))
+      continue;
+
+    cec_adapter foundDev;
+    foundDev.path = strPath;
+    foundDev.comm = string("/dev/") + dirent->d_name;
+    deviceList.push_back(foundDev);
+    ++iFound;
   }
 
-  return bReturn;
+  closedir(dir);
+  return iFound;
 }
-#endif
 
-int CAdapterDetection::FindAdapters(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
+int CAdapterDetection::FindAdaptersUdev(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
 {
   int iFound(0);
-
-#if !defined(__WINDOWS__)
   struct udev *udev;
   if (!(udev = udev_new()))
     return -1;
 
+  // only enumerate serial ports, instead of every device on the system
   struct udev_enumerate *enumerate;
   struct udev_list_entry *devices, *dev_list_entry;
-  struct udev_device *dev;
   enumerate = udev_enumerate_new(udev);
+  udev_enumerate_add_match_subsystem(enumerate, "tty");
   udev_enumerate_scan_devices(enumerate);
   devices = udev_enumerate_get_list_entry(enumerate);
   udev_list_entry_foreach(dev_list_entry, devices)
   {
-    const char *strPath;
-    strPath = udev_list_entry_get_name(dev_list_entry);
-
-    dev = udev_device_new_from_syspath(udev, strPath);
+    struct udev_device *dev = udev_device_new_from_syspath(udev, udev_list_entry_get_name(dev_list_entry));
     if (!dev)
       continue;
 
-    dev = udev_device_get_parent(udev_device_get_parent(dev));
-    if (!dev)
-      continue;
-    if (!udev_device_get_sysattr_value(dev,"idVendor") || !udev_device_get_sysattr_value(dev, "idProduct"))
+    // the parent is owned by dev, and released together with it
+    struct udev_device *usbdev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+    const char *strVendor  = usbdev ? udev_device_get_sysattr_value(usbdev, "idVendor") : NULL;
+    const char *strProduct = usbdev ? udev_device_get_sysattr_value(usbdev, "idProduct") : NULL;
+    const char *strComm    = udev_device_get_devnode(dev);
+
+    int iVendor(0), iProduct(0);
+    if (strVendor && strProduct && strComm &&
+        sscanf(strVendor, "%x", &iVendor) == 1 && sscanf(strProduct, "%x", &iProduct) == 1 &&
+        iVendor == CEC_VID && iProduct == CEC_PID &&
+        (!strDevicePath || !strcmp(udev_device_get_syspath(usbdev), strDevicePath)))
     {
-      udev_device_unref(dev);
-      continue;
-    }
-
-    int iVendor, iProduct;
-    sscanf(udev_device_get_sysattr_value(dev, "idVendor"), "%x", &iVendor);
-    sscanf(udev_device_get_sysattr_value(dev, "idProduct"), "%x", &iProduct);
-    if (iVendor == CEC_VID && iProduct == CEC_PID)
-    {
-      CStdString strPath(udev_device_get_syspath(dev));
-      if (strDevicePath && strcmp(strPath.c_str(), strDevicePath))
-        continue;
-
-      CStdString strComm(strPath);
-      if (FindComPort(strComm))
-      {
-        cec_adapter foundDev;
-        foundDev.path = strPath;
-        foundDev.comm = strComm;
-        deviceList.push_back(foundDev);
-        ++iFound;
-      }
+      cec_adapter foundDev;
+      foundDev.path = udev_device_get_syspath(usbdev);
+      foundDev.comm = strComm;
+      deviceList.push_back(foundDev);
+      ++iFound;
     }
     udev_device_unref(dev);
   }
 
   udev_enumerate_unref(enumerate);
   udev_unref(udev);
+  return iFound;
+}
+#endif
+
+int CAdapterDetection::FindAdapters(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
+{
+  int iFound(0);
+
+#if !defined(__WINDOWS__)
+  // reading sysfs directly is a lot faster than letting udev create a device for every entry
+  iFound = FindAdaptersSysfs(deviceList, strDevicePath);
+  if (iFound < 0)
+    iFound = FindAdaptersUdev(deviceList, strDevicePath);
 #else
   HDEVINFO hDevHandle;
   DWORD    required = 0, iMemberIndex = 0;
@@ -257,3 +273,183 @@ int CAdapterDetection::FindAdapters(vector<cec_adapter> &deviceList, const char
 
   return iFound;
 }
+
+CAdapterMonitor::CAdapterMonitor(CLibCEC *controller) :
+    CThread("cec-monitor"),
+    m_controller(controller),
+    m_mutex("monitor")
+#if !defined(__WINDOWS__)
+    ,m_udev(NULL),
+    m_monitor(NULL)
+#endif
+{
+}
+
+CAdapterMonitor::~CAdapterMonitor(void)
+{
+  StopThread();
+
+#if !defined(__WINDOWS__)
+  if (m_monitor)
+    udev_monitor_unref(m_monitor);
+  if (m_udev)
+    udev_unref(m_udev);
+#endif
+}
+
+bool CAdapterMonitor::Start(void)
+{
+#if !defined(__WINDOWS__)
+  if (IsRunning())
+    return true;
+
+  if (!m_udev && !(m_udev = udev_new()))
+    return false;
+
+  //start listening before scanning, so we don't miss adapters that are plugged in while scanning
+  if (!m_monitor)
+  {
+    if (!(m_monitor = udev_monitor_new_from_netlink(m_udev, "udev")))
+      return false;
+
+    if (udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "tty", NULL) < 0 ||
+        udev_monitor_enable_receiving(m_monitor) < 0)
+    {
+      udev_monitor_unref(m_monitor);
+      m_monitor = NULL;
+      return false;
+    }
+  }
+
+  vector<cec_adapter> adapters;
+  CAdapterDetection::FindAdapters(adapters);
+  {
+    CLockObject lock(&m_mutex);
+    m_adapters = adapters;
+  }
+
+  if (!CreateThread())
+  {
+    m_controller->AddLog(CEC_LOG_ERROR, "could not create an adapter monitor thread");
+    return false;
+  }
+
+  CStdString strLog;
+  if (GetThreadConfigError() != 0)
+  {
+    strLog.Format("could not apply the configuration of the adapter monitor thread: %s", strerror(GetThreadConfigError()));
+    m_controller->AddLog(CEC_LOG_WARNING, strLog);
+  }
+
+  strLog.Format("adapter monitor started, %d adapter(s) found", (int) adapters.size());
+  m_controller->AddLog(CEC_LOG_DEBUG, strLog);
+  return true;
+#else
+  m_controller->AddLog(CEC_LOG_WARNING, "the adapter monitor is not supported on this platform");
+  return false;
+#endif
+}
+
+int CAdapterMonitor::GetAdapters(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
+{
+  int iFound(0);
+  CLockObject lock(&m_mutex);
+  for (unsigned int iPtr = 0; iPtr < m_adapters.size(); iPtr++)
+  {
+    if (strDevicePath && strcmp(m_adapters[iPtr].path.c_str(), strDevicePath))
+      continue;
+
+    deviceList.push_back(m_adapters[iPtr]);
+    ++iFound;
+  }
+
+  return iFound;
+}
+
+void *CAdapterMonitor::Process(void)
+{
+#if !defined(__WINDOWS__)
+  struct pollfd pfd;
+  pfd.fd     = udev_monitor_get_fd(m_monitor);
+  pfd.events = POLLIN;
+
+  while (!m_bStop)
+  {
+    //wake up periodically to check whether we need to stop
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 500) <= 0 || !(pfd.revents & POLLIN))
+      continue;
+
+    struct udev_device *dev = udev_monitor_receive_device(m_monitor);
+    if (!dev)
+      continue;
+
+    const char *strAction  = udev_device_get_action(dev);
+    const char *strDevNode = udev_device_get_devnode(dev);
+    if (strAction && strDevNode)
+    {
+      if (!strcmp(strAction, "remove"))
+      {
+        RemoveAdapter(strDevNode);
+      }
+      else if (!strcmp(strAction, "add"))
+      {
+        struct udev_device *usbdev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+        const char *strVendor  = usbdev ? udev_device_get_sysattr_value(usbdev, "idVendor") : NULL;
+        const char *strProduct = usbdev ? udev_device_get_sysattr_value(usbdev, "idProduct") : NULL;
+
+        int iVendor(0), iProduct(0);
+        if (strVendor && strProduct &&
+            sscanf(strVendor, "%x", &iVendor) == 1 && sscanf(strProduct, "%x", &iProduct) == 1 &&
+            iVendor == CEC_VID && iProduct == CEC_PID)
+        {
+          cec_adapter adapter;
+          adapter.path = udev_device_get_syspath(usbdev);
+          adapter.comm = strDevNode;
+          AddAdapter(adapter);
+        }
+      }
+    }
+
+    udev_device_unref(dev);
+  }
+#endif
+
+  return NULL;
+}
+
+void CAdapterMonitor::AddAdapter(const cec_adapter &adapter)
+{
+  CLockObject lock(&m_mutex);
+  for (unsigned int iPtr = 0; iPtr < m_adapters.size(); iPtr++)
+    if (m_adapters[iPtr].comm == adapter.comm)
+      return;
+
+  m_adapters.push_back(adapter);
+  lock.Leave();
+
+  CStdString strLog;
+  strLog.Format("adapter connected to '%s'", adapter.comm.c_str());
+  m_controller->AddLog(CEC_LOG_NOTICE, strLog);
+  m_controller->AddAdapterEvent(CEC_ADAPTER_EVENT_ARRIVED, adapter);
+}
+
+void CAdapterMonitor::RemoveAdapter(const string &strComm)
+{
+  CLockObject lock(&m_mutex);
+  for (vector<cec_adapter>::iterator it = m_adapters.begin(); it != m_adapters.end(); it++)
+  {
+    if (it->comm == strComm)
+    {
+      cec_adapter adapter = *it;
+      m_adapters.erase(it);
+      lock.Leave();
+
+      CStdString strLog;
+      strLog.Format("adapter removed from '%s'", adapter.comm.c_str());
+      m_controller->AddLog(CEC_LOG_NOTICE, strLog);
+      m_controller->AddAdapterEvent(CEC_ADAPTER_EVENT_REMOVED, adapter);
+      return;
+    }
+  }
+}
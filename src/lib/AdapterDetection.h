@@ -32,12 +32,49 @@
  */
 
 #include "../../include/CECExports.h"
+#include "platform/threads.h"
+
+#if !defined(__WINDOWS__)
+struct udev;
+struct udev_monitor;
+#endif
 
 namespace CEC
 {
+  class CLibCEC;
+
   class CAdapterDetection
   {
   public:
     static int FindAdapters(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL);
+
+#if !defined(__WINDOWS__)
+    static int FindAdaptersSysfs(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL, const char *strSysfsRoot = "/sys");
+    static int FindAdaptersUdev(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL);
+#endif
+  };
+
+  class CAdapterMonitor : public CThread
+  {
+  public:
+    CAdapterMonitor(CLibCEC *controller);
+    virtual ~CAdapterMonitor(void);
+
+    bool Start(void);
+    int GetAdapters(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL);
+
+    void *Process(void);
+
+  private:
+    void AddAdapter(const cec_adapter &adapter);
+    void RemoveAdapter(const std::string &strComm);
+
+    CLibCEC                 *m_controller;
+    std::vector<cec_adapter> m_adapters;
+    CMutex                   m_mutex;
+#if !defined(__WINDOWS__)
+    struct udev             *m_udev;
+    struct udev_monitor     *m_monitor;
+#endif
   };
 };
@@ -0,0 +1,410 @@
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "AdapterManager.h"
+
+#include "LibCEC.h"
+#include "platform/probes.h"
+#include "util/StdString.h"
+#include "platform/timeutils.h"
+
+using namespace std;
+using namespace CEC;
+
+#define CEC_MANAGER_JOB_WAIT 1000
+
+CAdapterManagerJob::CAdapterManagerJob(cec_manager_job_type type) :
+    m_type(type),
+    m_iTimeoutMs(0),
+    m_bWaitForAck(true),
+    m_address(CECDEVICE_BROADCAST),
+    m_bResult(false),
+    m_bDone(false)
+{
+}
+
+void CAdapterManagerJob::Run(CLibCEC *adapter)
+{
+  switch (m_type)
+  {
+  case CEC_MANAGER_JOB_OPEN:
+    m_bResult = adapter->Open(m_strPort.c_str(), m_iTimeoutMs);
+    break;
+  case CEC_MANAGER_JOB_TRANSMIT:
+    m_bResult = adapter->Transmit(m_frame, m_bWaitForAck);
+    break;
+  case CEC_MANAGER_JOB_POWER_ON:
+    m_bResult = adapter->PowerOnDevices(m_address);
+    break;
+  case CEC_MANAGER_JOB_STANDBY:
+    m_bResult = adapter->StandbyDevices(m_address);
+    break;
+  case CEC_MANAGER_JOB_ACTIVE_VIEW:
+    m_bResult = adapter->SetActiveView();
+    break;
+  case CEC_MANAGER_JOB_INACTIVE_VIEW:
+    m_bResult = adapter->SetInactiveView();
+    break;
+  }
+}
+
+CAdapterManagerWorker::CAdapterManagerWorker(CAdapterManager *manager, CLibCEC *adapter) :
+    CThread("cec-manager"),
+    m_manager(manager),
+    m_adapter(adapter),
+    m_mutex("manager-worker")
+{
+}
+
+bool CAdapterManagerWorker::Queue(CAdapterManagerJob *job)
+{
+  CLockObject lock(&m_mutex);
+  if (m_bStop || !IsRunning())
+    return false;
+
+  m_jobs.push_back(job);
+  m_condition.Signal();
+  return true;
+}
+
+void CAdapterManagerWorker::Stop(void)
+{
+  //the jobs that were queued before are run first, so nobody waits for a job that's never done
+  {
+    CLockObject lock(&m_mutex);
+    m_bStop = true;
+    m_condition.Signal();
+  }
+  StopThread();
+}
+
+void *CAdapterManagerWorker::Process(void)
+{
+  CLockObject lock(&m_mutex);
+  while (!m_bStop || !m_jobs.empty())
+  {
+    if (m_jobs.empty())
+    {
+      m_condition.Wait(&m_mutex, CEC_MANAGER_JOB_WAIT);
+      continue;
+    }
+
+    CAdapterManagerJob *job = m_jobs.front();
+    m_jobs.pop_front();
+    lock.Leave();
+
+    job->Run(m_adapter);
+    m_manager->JobDone(job);
+
+    lock.Lock();
+  }
+
+  return NULL;
+}
+
+CAdapterManager::CAdapterManager(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */) :
+    m_strDeviceName(strDeviceName),
+    m_iLogicalAddress(iLogicalAddress),
+    m_iPhysicalAddress(iPhysicalAddress),
+    m_bUseSharedReactor(false),
+    m_eventBuffer("manager-event-queue"),
+    m_mutex("manager"),
+    m_jobMutex("manager-jobs"),
+    m_iRunningCalls(0)
+{
+}
+
+CAdapterManager::~CAdapterManager(void)
+{
+  Close();
+}
+
+int CAdapterManager::Open(const vector<string> &ports, uint64_t iTimeoutMs /* = 10000 */)
+{
+  CLockObject lock(&m_mutex);
+  if (!m_adapters.empty())
+    return 0;
+
+  vector<CAdapterManagerJob *> jobs;
+  for (unsigned int iPtr = 0; iPtr < ports.size(); iPtr++)
+  {
+    CLibCEC *adapter = new CLibCEC(m_strDeviceName.c_str(), m_iLogicalAddress, m_iPhysicalAddress);
+    adapter->SetManager(this, (int) iPtr);
+    if (m_bUseSharedReactor)
+      adapter->UseSharedReactor(true);
+    m_adapters.push_back(adapter);
+
+    //a single adapter is handled by the thread that calls the manager, without a worker
+    CAdapterManagerWorker *worker = NULL;
+    if (ports.size() > 1)
+    {
+      worker = new CAdapterManagerWorker(this, adapter);
+      if (!worker->CreateThread())
+      {
+        delete worker;
+        worker = NULL;
+      }
+    }
+    m_workers.push_back(worker);
+
+    CAdapterManagerJob *job = new CAdapterManagerJob(CEC_MANAGER_JOB_OPEN);
+    job->m_strPort    = ports[iPtr];
+    job->m_iTimeoutMs = iTimeoutMs;
+    jobs.push_back(job);
+  }
+
+  vector<CLibCEC *> adapters(m_adapters);
+  vector<CAdapterManagerWorker *> workers(m_workers);
+  StartCall();
+  lock.Leave();
+
+  int iReturn = RunJobs(jobs, adapters, workers);
+  EndCall();
+  return iReturn;
+}
+
+void CAdapterManager::Close(void)
+{
+  CLockObject lock(&m_mutex);
+  vector<CLibCEC *> adapters;
+  vector<CAdapterManagerWorker *> workers;
+  adapters.swap(m_adapters);
+  workers.swap(m_workers);
+  lock.Leave();
+
+  //the adapters are deleted after the calls that are still using them returned
+  {
+    CLockObject jobLock(&m_jobMutex);
+    while (m_iRunningCalls > 0)
+      m_jobCondition.Wait(&m_jobMutex, CEC_MANAGER_JOB_WAIT);
+  }
+
+  for (unsigned int iPtr = 0; iPtr < workers.size(); iPtr++)
+  {
+    if (workers[iPtr])
+    {
+      workers[iPtr]->Stop();
+      delete workers[iPtr];
+    }
+  }
+
+  for (unsigned int iPtr = 0; iPtr < adapters.size(); iPtr++)
+    adapters[iPtr]->Close();
+
+  for (unsigned int iPtr = 0; iPtr < adapters.size(); iPtr++)
+    delete adapters[iPtr];
+}
+
+bool CAdapterManager::UseSharedReactor(bool bEnable /* = true */)
+{
+  CLockObject lock(&m_mutex);
+  m_bUseSharedReactor = bEnable;
+  return true;
+}
+
+int CAdapterManager::GetAdapterCount(void)
+{
+  CLockObject lock(&m_mutex);
+  return (int) m_adapters.size();
+}
+
+ICECAdapter *CAdapterManager::GetAdapter(int iAdapterId)
+{
+  CLockObject lock(&m_mutex);
+  if (iAdapterId < 0 || iAdapterId >= (int) m_adapters.size())
+    return NULL;
+  return m_adapters[iAdapterId];
+}
+
+bool CAdapterManager::GetNextEvent(cec_event *event)
+{
+  if (!m_eventBuffer.Pop(*event))
+    return false;
+
+  if (event->type == CEC_EVENT_COMMAND)
+    CEC_PROBE5(command_dequeued, event->command.source, event->command.destination, event->command.opcode, event->adapter_id, GetTimeUs());
+  return true;
+}
+
+unsigned int CAdapterManager::GetNextEvents(cec_event *events, unsigned int iMaxEvents)
+{
+  unsigned int iEvents = events ? m_eventBuffer.Pop(events, iMaxEvents) : 0;
+  if (CEC_PROBE_ENABLED(command_dequeued))
+  {
+    for (unsigned int iPtr = 0; iPtr < iEvents; iPtr++)
+    {
+      if (events[iPtr].type == CEC_EVENT_COMMAND)
+        CEC_PROBE5(command_dequeued, events[iPtr].command.source, events[iPtr].command.destination, events[iPtr].command.opcode, events[iPtr].adapter_id, GetTimeUs());
+    }
+  }
+  return iEvents;
+}
+
+void CAdapterManager::SetEventQueueConfig(const cec_queue_config &config)
+{
+  m_eventBuffer.SetConfig(config);
+}
+
+void CAdapterManager::GetEventQueueStatistics(cec_queue_statistics *statistics)
+{
+  if (statistics)
+    m_eventBuffer.GetStatistics(*statistics);
+}
+
+int CAdapterManager::Transmit(const cec_frame &data, bool bWaitForAck /* = true */)
+{
+  return RunJobs(CEC_MANAGER_JOB_TRANSMIT, &data, bWaitForAck);
+}
+
+int CAdapterManager::PowerOnDevices(cec_logical_address address /* = CECDEVICE_TV */)
+{
+  return RunJobs(CEC_MANAGER_JOB_POWER_ON, NULL, true, address);
+}
+
+int CAdapterManager::StandbyDevices(cec_logical_address address /* = CECDEVICE_BROADCAST */)
+{
+  return RunJobs(CEC_MANAGER_JOB_STANDBY, NULL, true, address);
+}
+
+int CAdapterManager::SetActiveView(void)
+{
+  return RunJobs(CEC_MANAGER_JOB_ACTIVE_VIEW);
+}
+
+int CAdapterManager::SetInactiveView(void)
+{
+  return RunJobs(CEC_MANAGER_JOB_INACTIVE_VIEW);
+}
+
+bool CAdapterManager::AddKey(int iAdapterId, const cec_keypress &key)
+{
+  cec_event event = cec_event();
+  event.type       = CEC_EVENT_KEYPRESS;
+  event.adapter_id = iAdapterId;
+  event.keypress   = key;
+  return m_eventBuffer.PushMove(event);
+}
+
+bool CAdapterManager::AddCommand(int iAdapterId, cec_command &command)
+{
+  cec_event event = cec_event();
+  event.type       = CEC_EVENT_COMMAND;
+  event.adapter_id = iAdapterId;
+  CecBufferMove(event.command, command);
+  return m_eventBuffer.PushMove(event);
+}
+
+bool CAdapterManager::AddAdapterEvent(int iAdapterId, cec_adapter_event &adapterEvent)
+{
+  cec_event event = cec_event();
+  event.type       = CEC_EVENT_ADAPTER;
+  event.adapter_id = iAdapterId;
+  CecBufferMove(event.adapter_event, adapterEvent);
+  return m_eventBuffer.PushMove(event);
+}
+
+void CAdapterManager::StartCall(void)
+{
+  //called with m_mutex held, so Close() sees the call when it takes the adapters
+  CLockObject lock(&m_jobMutex);
+  ++m_iRunningCalls;
+}
+
+void CAdapterManager::EndCall(void)
+{
+  CLockObject lock(&m_jobMutex);
+  --m_iRunningCalls;
+  m_jobCondition.Broadcast();
+}
+
+void CAdapterManager::JobDone(CAdapterManagerJob *job)
+{
+  CLockObject lock(&m_jobMutex);
+  job->m_bDone = true;
+  m_jobCondition.Broadcast();
+}
+
+int CAdapterManager::RunJobs(cec_manager_job_type type, const cec_frame *frame /* = NULL */, bool bWaitForAck /* = true */, cec_logical_address address /* = CECDEVICE_BROADCAST */)
+{
+  //m_mutex isn't held while the jobs run, so other calls to the manager don't wait for a slow bus
+  CLockObject lock(&m_mutex);
+  vector<CLibCEC *> adapters(m_adapters);
+  vector<CAdapterManagerWorker *> workers(m_workers);
+  StartCall();
+  lock.Leave();
+
+  vector<CAdapterManagerJob *> jobs;
+  for (unsigned int iPtr = 0; iPtr < adapters.size(); iPtr++)
+  {
+    CAdapterManagerJob *job = new CAdapterManagerJob(type);
+    if (frame)
+      job->m_frame = *frame;
+    job->m_bWaitForAck = bWaitForAck;
+    job->m_address     = address;
+    jobs.push_back(job);
+  }
+
+  int iReturn = RunJobs(jobs, adapters, workers);
+  EndCall();
+  return iReturn;
+}
+
+int CAdapterManager::RunJobs(vector<CAdapterManagerJob *> &jobs, vector<CLibCEC *> &adapters, vector<CAdapterManagerWorker *> &workers)
+{
+  //queue all jobs first, so every adapter only has to wait for its own bus
+  vector<bool> queued;
+  for (unsigned int iPtr = 0; iPtr < jobs.size(); iPtr++)
+    queued.push_back(workers[iPtr] && workers[iPtr]->Queue(jobs[iPtr]));
+
+  for (unsigned int iPtr = 0; iPtr < jobs.size(); iPtr++)
+    if (!queued[iPtr])
+      jobs[iPtr]->Run(adapters[iPtr]);
+
+  int iSucceeded(0);
+  CLockObject lock(&m_jobMutex);
+  for (unsigned int iPtr = 0; iPtr < jobs.size(); iPtr++)
+  {
+    while (queued[iPtr] && !jobs[iPtr]->m_bDone)
+      m_jobCondition.Wait(&m_jobMutex, CEC_MANAGER_JOB_WAIT);
+
+    if (jobs[iPtr]->m_bResult)
+      ++iSucceeded;
+    delete jobs[iPtr];
+  }
+
+  return iSucceeded;
+}
+
+DECLSPEC void * CECCreateManager(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress /*= CEC::CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
+{
+  return static_cast< void* > (new CAdapterManager(strDeviceName, iLogicalAddress, iPhysicalAddress));
+}
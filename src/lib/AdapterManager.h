@@ -0,0 +1,145 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "../../include/CECExports.h"
+#include "platform/threads.h"
+#include "util/buffer.h"
+#include <deque>
+
+namespace CEC
+{
+  class CLibCEC;
+
+  typedef enum cec_manager_job_type
+  {
+    CEC_MANAGER_JOB_OPEN = 0,
+    CEC_MANAGER_JOB_TRANSMIT,
+    CEC_MANAGER_JOB_POWER_ON,
+    CEC_MANAGER_JOB_STANDBY,
+    CEC_MANAGER_JOB_ACTIVE_VIEW,
+    CEC_MANAGER_JOB_INACTIVE_VIEW
+  } cec_manager_job_type;
+
+  class CAdapterManagerJob
+  {
+  public:
+    CAdapterManagerJob(cec_manager_job_type type);
+    virtual ~CAdapterManagerJob(void) {}
+
+    void Run(CLibCEC *adapter);
+
+    cec_manager_job_type m_type;
+    std::string          m_strPort;
+    uint64_t             m_iTimeoutMs;
+    cec_frame            m_frame;
+    bool                 m_bWaitForAck;
+    cec_logical_address  m_address;
+    bool                 m_bResult;
+    bool                 m_bDone;     /*!< set by the worker under the manager's m_jobMutex */
+  };
+
+  class CAdapterManager;
+
+  /*!
+   * Runs the jobs of a single adapter, in the order they were queued, for as long as the adapter is open.
+   */
+  class CAdapterManagerWorker : public CThread
+  {
+  public:
+    CAdapterManagerWorker(CAdapterManager *manager, CLibCEC *adapter);
+    virtual ~CAdapterManagerWorker(void) {}
+
+    bool Queue(CAdapterManagerJob *job);
+    void Stop(void);
+    void *Process(void);
+
+  private:
+    CAdapterManager *                m_manager;
+    CLibCEC *                        m_adapter;
+    std::deque<CAdapterManagerJob *> m_jobs;
+    CMutex                           m_mutex;
+    CCondition                       m_condition;
+  };
+
+  class CAdapterManager : public ICECAdapterManager
+  {
+  public:
+    CAdapterManager(const char *strDeviceName, cec_logical_address iLogicalAddress = CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
+    virtual ~CAdapterManager(void);
+
+    /*!
+     * ICECAdapterManager implementation
+     */
+    //@{
+    virtual int Open(const std::vector<std::string> &ports, uint64_t iTimeoutMs = 10000);
+    virtual void Close(void);
+    virtual bool UseSharedReactor(bool bEnable = true);
+    virtual int GetAdapterCount(void);
+    virtual ICECAdapter *GetAdapter(int iAdapterId);
+    virtual bool GetNextEvent(cec_event *event);
+    virtual unsigned int GetNextEvents(cec_event *events, unsigned int iMaxEvents);
+    virtual void SetEventQueueConfig(const cec_queue_config &config);
+    virtual void GetEventQueueStatistics(cec_queue_statistics *statistics);
+
+    virtual int Transmit(const cec_frame &data, bool bWaitForAck = true);
+    virtual int PowerOnDevices(cec_logical_address address = CECDEVICE_TV);
+    virtual int StandbyDevices(cec_logical_address address = CECDEVICE_BROADCAST);
+    virtual int SetActiveView(void);
+    virtual int SetInactiveView(void);
+    //@}
+
+    bool AddKey(int iAdapterId, const cec_keypress &key);
+    bool AddCommand(int iAdapterId, cec_command &command); /*!< moves the command into the event queue */
+    bool AddAdapterEvent(int iAdapterId, cec_adapter_event &event); /*!< moves the event into the event queue */
+
+    void JobDone(CAdapterManagerJob *job);
+
+  private:
+    int RunJobs(cec_manager_job_type type, const cec_frame *frame = NULL, bool bWaitForAck = true, cec_logical_address address = CECDEVICE_BROADCAST);
+    int RunJobs(std::vector<CAdapterManagerJob *> &jobs, std::vector<CLibCEC *> &adapters, std::vector<CAdapterManagerWorker *> &workers);
+    void StartCall(void);
+    void EndCall(void);
+
+    std::string           m_strDeviceName;
+    cec_logical_address   m_iLogicalAddress;
+    uint16_t              m_iPhysicalAddress;
+    bool                  m_bUseSharedReactor;
+    std::vector<CLibCEC *> m_adapters;
+    std::vector<CAdapterManagerWorker *> m_workers; /*!< one for every adapter, by adapter id */
+    CecBuffer<cec_event, 1024> m_eventBuffer;
+    CMutex                m_mutex;
+    CMutex                m_jobMutex;
+    CCondition            m_jobCondition;
+    unsigned int          m_iRunningCalls; /*!< calls that run jobs on the adapters without holding m_mutex. guarded by m_jobMutex */
+  };
+};
@@ -0,0 +1,293 @@
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "AdapterReactor.h"
+
+#include "AdapterCommunication.h"
+#include "CECProcessor.h"
+
+#include <algorithm>
+
+#if !defined(__WINDOWS__)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#define CEC_REACTOR_TICK          50
+#define CEC_REACTOR_POLL_TIMEOUT  1000
+
+using namespace std;
+using namespace CEC;
+
+CAdapterReactor *CAdapterReactor::m_instance(NULL);
+unsigned int     CAdapterReactor::m_iReferences(0);
+CMutex           CAdapterReactor::m_instanceMutex("reactor-instance");
+
+void *CReactorDispatcher::Process(void)
+{
+  while (!m_bStop)
+    m_reactor->Dispatch();
+
+  return NULL;
+}
+
+CAdapterReactor *CAdapterReactor::Acquire(void)
+{
+#if !defined(__WINDOWS__)
+  CLockObject lock(&m_instanceMutex);
+  if (!m_instance)
+  {
+    m_instance = new CAdapterReactor;
+    if (!m_instance->Start())
+    {
+      delete m_instance;
+      m_instance = NULL;
+      return NULL;
+    }
+  }
+
+  ++m_iReferences;
+  return m_instance;
+#else
+  return NULL;
+#endif
+}
+
+void CAdapterReactor::Release(void)
+{
+  CLockObject lock(&m_instanceMutex);
+  if (m_iReferences > 0 && --m_iReferences == 0)
+  {
+    delete m_instance;
+    m_instance = NULL;
+  }
+}
+
+CAdapterReactor::CAdapterReactor(void) :
+    CThread("cec-reactor"),
+    m_mutex("reactor"),
+    m_dispatchMutex("reactor-dispatch"),
+    m_signalMutex("reactor-signal"),
+    m_bSignalled(false),
+    m_dispatcher(this)
+{
+  m_wakeupPipe[0] = -1;
+  m_wakeupPipe[1] = -1;
+}
+
+CAdapterReactor::~CAdapterReactor(void)
+{
+  StopThread(false);
+  Wakeup();
+  StopThread();
+  m_dispatcher.StopThread();
+
+#if !defined(__WINDOWS__)
+  if (m_wakeupPipe[0] != -1)
+    close(m_wakeupPipe[0]);
+  if (m_wakeupPipe[1] != -1)
+    close(m_wakeupPipe[1]);
+#endif
+}
+
+bool CAdapterReactor::Start(void)
+{
+#if !defined(__WINDOWS__)
+  if (pipe(m_wakeupPipe) != 0)
+    return false;
+
+  fcntl(m_wakeupPipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(m_wakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+  return CreateThread() && m_dispatcher.CreateThread();
+#else
+  return false;
+#endif
+}
+
+bool CAdapterReactor::Register(CAdapterCommunication *communication)
+{
+  CLockObject lock(&m_mutex);
+  for (unsigned int iPtr = 0; iPtr < m_communications.size(); iPtr++)
+    if (m_communications[iPtr] == communication)
+      return true;
+
+  m_communications.push_back(communication);
+  lock.Leave();
+
+  Wakeup();
+  return true;
+}
+
+void CAdapterReactor::Unregister(CAdapterCommunication *communication)
+{
+  //the i/o thread holds m_mutex while reading, so the adapter won't be used anymore when this returns
+  CLockObject lock(&m_mutex);
+  for (vector<CAdapterCommunication *>::iterator it = m_communications.begin(); it != m_communications.end(); it++)
+  {
+    if (*it == communication)
+    {
+      m_communications.erase(it);
+      break;
+    }
+  }
+  lock.Leave();
+
+  Wakeup();
+}
+
+bool CAdapterReactor::Register(CCECProcessor *processor)
+{
+  CLockObject lock(&m_dispatchMutex);
+  for (unsigned int iPtr = 0; iPtr < m_processors.size(); iPtr++)
+    if (m_processors[iPtr] == processor)
+      return true;
+
+  m_processors.push_back(processor);
+  return true;
+}
+
+void CAdapterReactor::Unregister(CCECProcessor *processor)
+{
+  //waits for the dispatcher to finish the processor that's being handled
+  CLockObject lock(&m_dispatchMutex);
+  for (vector<CCECProcessor *>::iterator it = m_processors.begin(); it != m_processors.end(); it++)
+  {
+    if (*it == processor)
+    {
+      m_processors.erase(it);
+      break;
+    }
+  }
+}
+
+void *CAdapterReactor::Process(void)
+{
+#if !defined(__WINDOWS__)
+  vector<struct pollfd>           fds;
+  vector<CAdapterCommunication *> communications;
+
+  while (!m_bStop)
+  {
+    fds.clear();
+    communications.clear();
+
+    struct pollfd pfd;
+    pfd.fd      = m_wakeupPipe[0];
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    fds.push_back(pfd);
+    communications.push_back(NULL);
+
+    {
+      CLockObject lock(&m_mutex);
+      for (unsigned int iPtr = 0; iPtr < m_communications.size(); iPtr++)
+      {
+        pfd.fd = m_communications[iPtr]->GetFileDescriptor();
+        if (pfd.fd == -1)
+          continue;
+        fds.push_back(pfd);
+        communications.push_back(m_communications[iPtr]);
+      }
+    }
+
+    if (poll(&fds[0], fds.size(), CEC_REACTOR_POLL_TIMEOUT) <= 0)
+      continue;
+
+    if (fds[0].revents)
+    {
+      uint8_t buff[32];
+      while (read(m_wakeupPipe[0], buff, sizeof(buff)) > 0) {}
+    }
+
+    bool bSignal(false);
+    CLockObject lock(&m_mutex);
+    for (unsigned int iPtr = 1; iPtr < fds.size(); iPtr++)
+    {
+      if (!fds[iPtr].revents)
+        continue;
+
+      //the adapter may have been unregistered while polling
+      vector<CAdapterCommunication *>::iterator it = find(m_communications.begin(), m_communications.end(), communications[iPtr]);
+      if (it == m_communications.end())
+        continue;
+
+      if ((*it)->ProcessInput())
+        bSignal = true;
+      else
+        m_communications.erase(it);
+    }
+    lock.Leave();
+
+    if (bSignal)
+      SignalDispatcher();
+  }
+#endif
+
+  return NULL;
+}
+
+void CAdapterReactor::Dispatch(void)
+{
+  {
+    CLockObject lock(&m_signalMutex);
+    if (!m_bSignalled)
+      m_signalCondition.Wait(&m_signalMutex, CEC_REACTOR_TICK);
+    m_bSignalled = false;
+  }
+
+  CLockObject lock(&m_dispatchMutex);
+  for (unsigned int iPtr = 0; iPtr < m_processors.size(); iPtr++)
+    m_processors[iPtr]->ProcessPending();
+}
+
+void CAdapterReactor::Wakeup(void)
+{
+#if !defined(__WINDOWS__)
+  if (m_wakeupPipe[1] != -1)
+  {
+    //if the pipe is full, the i/o thread will wake up anyway
+    uint8_t iByte(0);
+    if (write(m_wakeupPipe[1], &iByte, 1) != 1)
+      return;
+  }
+#endif
+}
+
+void CAdapterReactor::SignalDispatcher(void)
+{
+  //don't use m_dispatchMutex here: processors wait for input from this thread while it's locked
+  CLockObject lock(&m_signalMutex);
+  m_bSignalled = true;
+  m_signalCondition.Signal();
+}
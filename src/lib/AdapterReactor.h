@@ -0,0 +1,98 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "../../include/CECExports.h"
+#include "platform/threads.h"
+
+namespace CEC
+{
+  class CAdapterCommunication;
+  class CAdapterReactor;
+  class CCECProcessor;
+
+  class CReactorDispatcher : public CThread
+  {
+  public:
+    CReactorDispatcher(CAdapterReactor *reactor) : CThread("cec-dispatcher"), m_reactor(reactor) {}
+    virtual ~CReactorDispatcher(void) {}
+
+    void *Process(void);
+
+  private:
+    CAdapterReactor *m_reactor;
+  };
+
+  /*!
+   * Multiplexes the input of all registered adapters onto a single I/O thread, and runs the
+   * frame parsing and timers of all registered processors on a single dispatcher thread,
+   * instead of using a reader and a processor thread for every adapter.
+   * Only implemented on platforms that provide poll().
+   */
+  class CAdapterReactor : public CThread
+  {
+  public:
+    static CAdapterReactor *Acquire(void);
+    static void Release(void);
+
+    bool Register(CAdapterCommunication *communication);
+    void Unregister(CAdapterCommunication *communication);
+    bool Register(CCECProcessor *processor);
+    void Unregister(CCECProcessor *processor);
+    bool SetDispatcherThreadConfig(const cec_thread_config &config) { return m_dispatcher.SetThreadConfig(config); }
+
+    void *Process(void);
+    void Dispatch(void);
+
+  private:
+    CAdapterReactor(void);
+    virtual ~CAdapterReactor(void);
+
+    bool Start(void);
+    void Wakeup(void);
+    void SignalDispatcher(void);
+
+    std::vector<CAdapterCommunication *> m_communications;
+    std::vector<CCECProcessor *>         m_processors;
+    CMutex                               m_mutex;
+    CMutex                               m_dispatchMutex;
+    CMutex                               m_signalMutex;
+    CCondition                           m_signalCondition;
+    bool                                 m_bSignalled;
+    int                                  m_wakeupPipe[2];
+    CReactorDispatcher                   m_dispatcher;
+
+    static CAdapterReactor *m_instance;
+    static unsigned int     m_iReferences;
+    static CMutex           m_instanceMutex;
+  };
+};
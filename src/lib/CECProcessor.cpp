@@ -33,20 +33,84 @@
 #include "CECProcessor.h"
 
 #include "AdapterCommunication.h"
+#include "AdapterReactor.h"
 #include "LibCEC.h"
+#include "TraceWriter.h"
+#include "platform/probes.h"
 #include "util/StdString.h"
 #include "platform/timeutils.h"
 
+#define CEC_LINE_TIMEOUT              3
+#define CEC_HEALTH_CHECK_INTERVAL     5000
+#define CEC_HEALTH_MAX_PING_FAILURES  2
+#define CEC_RECONNECT_TIMEOUT         1000
+#define CEC_RECONNECT_MIN_INTERVAL    100
+#define CEC_RECONNECT_MAX_INTERVAL    5000
+#define CEC_RECONNECT_MAX_QUEUE_TIME  2000
+#define CEC_REACTOR_MAX_FRAMES        32
+#define CEC_ALLOCATE_TIMEOUT          1000
+#define CEC_MAX_ALLOCATE_CANDIDATES   4
+/* start, escaped code, escaped data and end for every byte of the frame. the line timeout and ack polarity are sent by CAdapterCommunication */
+#define CEC_MAX_FORMATTED_SIZE        (CEC_MAX_FRAME_SIZE * 6)
+
 using namespace CEC;
 using namespace std;
 
 CCECProcessor::CCECProcessor(CLibCEC *controller, CAdapterCommunication *serComm, const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS*/) :
+    CThread("cec-processor"),
+    m_handlerMutex("processor-handlers"),
+    m_iCurrentFrameLength(0),
+    m_iFrameStartTime(0),
+    m_iFrameEomTime(0),
+    m_iFrameParsedTime(0),
+    m_iTransmitAcceptedTime(0),
     m_physicaladdress(iPhysicalAddress),
     m_iLogicalAddress(iLogicalAddress),
-    m_strDeviceName(strDeviceName),
+    m_iAckMask(0),
+    m_bAllocateAddress(false),
+    m_devicesMutex("processor-devices"),
+    m_frameBuffer("frame-buffer"),
+    m_transmitBuffer("transmit-queue"),
+    m_iReconnecting(0),
+    m_iPingFailures(0),
+    m_iNextHealthCheck(0),
+    m_iPingDeadline(0),
+    m_iReconnectInterval(CEC_RECONNECT_MIN_INTERVAL),
+    m_healthMutex("processor-health"),
+    m_reconnector(this),
+    m_statisticsMutex("processor-statistics"),
+    m_bUseReactor(false),
+    m_reactor(NULL),
+    m_mutex("processor"),
     m_communication(serComm),
     m_controller(controller)
 {
+  memset(&m_statistics, 0, sizeof(m_statistics));
+  memset(m_handlers, 0, sizeof(m_handlers));
+  memset(m_devices, 0, sizeof(m_devices));
+
+  if (iLogicalAddress > CECDEVICE_UNKNOWN && iLogicalAddress < CECDEVICE_BROADCAST)
+  {
+    LogicalDevice &device = m_devices[iLogicalAddress];
+    device.bActive = true;
+    device.type    = GetDeviceType(iLogicalAddress);
+    if (strDeviceName)
+      strncpy(device.strName, strDeviceName, sizeof(device.strName) - 1);
+    UpdateAckMask();
+  }
+
+  for (unsigned int iPtr = 0; iPtr < 256; iPtr++)
+    m_builtinHandlers[iPtr] = NULL;
+  m_builtinHandlers[CEC_OPCODE_GIVE_PHYSICAL_ADDRESS]     = &CCECProcessor::HandleGivePhysicalAddress;
+  m_builtinHandlers[CEC_OPCODE_GIVE_OSD_NAME]             = &CCECProcessor::HandleGiveOSDName;
+  m_builtinHandlers[CEC_OPCODE_GIVE_DEVICE_VENDOR_ID]     = &CCECProcessor::HandleGiveDeviceVendorId;
+  m_builtinHandlers[CEC_OPCODE_MENU_REQUEST]              = &CCECProcessor::HandleMenuRequest;
+  m_builtinHandlers[CEC_OPCODE_GIVE_DEVICE_POWER_STATUS]  = &CCECProcessor::HandleGiveDevicePowerStatus;
+  m_builtinHandlers[CEC_OPCODE_GET_CEC_VERSION]           = &CCECProcessor::HandleGetCECVersion;
+  m_builtinHandlers[CEC_OPCODE_USER_CONTROL_PRESSED]      = &CCECProcessor::HandleUserControlPressed;
+  m_builtinHandlers[CEC_OPCODE_USER_CONTROL_RELEASE]      = &CCECProcessor::HandleUserControlRelease;
+  m_builtinHandlers[CEC_OPCODE_REQUEST_ACTIVE_SOURCE]     = &CCECProcessor::HandleRequestActiveSource;
+  m_builtinHandlers[CEC_OPCODE_SET_STREAM_PATH]           = &CCECProcessor::HandleSetStreamPath;
 }
 
 CCECProcessor::~CCECProcessor(void)
@@ -61,45 +125,170 @@ bool CCECProcessor::Start(void)
   if (!m_communication || !m_communication->IsOpen())
     return false;
 
-  if (!SetLogicalAddress(m_iLogicalAddress))
+  if (m_bAllocateAddress ? !AllocateLogicalAddress() : !SetLogicalAddress(m_iLogicalAddress))
   {
     m_controller->AddLog(CEC_LOG_ERROR, "could not set the logical address");
     return false;
   }
 
+  AtomicStore(&m_iReconnecting, 0);
+  {
+    CLockObject lock(&m_healthMutex);
+    m_iPingFailures    = 0;
+    m_iPingDeadline    = 0;
+    m_iNextHealthCheck = GetTimeMs() + CEC_HEALTH_CHECK_INTERVAL;
+  }
+
+  if (m_bUseReactor)
+  {
+    m_bStop = false;
+    if ((m_reactor = CAdapterReactor::Acquire()) != NULL && m_reactor->Register(this))
+    {
+      if (HasThreadConfig() && !m_reactor->SetDispatcherThreadConfig(GetThreadConfig()))
+        m_controller->AddLog(CEC_LOG_WARNING, "could not apply the configuration of the processor thread to the shared dispatcher");
+      return true;
+    }
+
+    m_controller->AddLog(CEC_LOG_ERROR, "could not register with the shared reactor");
+    if (m_reactor)
+    {
+      CAdapterReactor::Release();
+      m_reactor = NULL;
+    }
+    return false;
+  }
+
   if (CreateThread())
+  {
+    if (GetThreadConfigError() != 0)
+    {
+      CStdString strError;
+      strError.Format("could not apply the configuration of the processor thread: %s", strerror(GetThreadConfigError()));
+      m_controller->AddLog(CEC_LOG_WARNING, strError);
+    }
     return true;
+  }
   else
     m_controller->AddLog(CEC_LOG_ERROR, "could not create a processor thread");
 
   return false;
 }
 
+bool CCECProcessor::StopThread(bool bWaitForExit /* = true */)
+{
+  if (m_reactor)
+  {
+    m_reactor->Unregister(this);
+    CAdapterReactor::Release();
+    m_reactor = NULL;
+  }
+
+  bool bReturn = CThread::StopThread(bWaitForExit);
+
+  //started by the thread that was just stopped. waits for the attempt to reopen the adapter that's in progress
+  if (bWaitForExit)
+    m_reconnector.StopThread();
+  return bReturn;
+}
+
+bool CCECProcessor::SetThreadConfig(const cec_thread_config &config)
+{
+  if (!CThread::SetThreadConfig(config))
+    return false;
+
+  //the shared reactor's dispatcher thread processes the frames of this adapter
+  return m_reactor ? m_reactor->SetDispatcherThreadConfig(config) : true;
+}
+
+bool CCECProcessor::SetUseReactor(bool bEnable)
+{
+  if (IsRunning() || m_reactor)
+    return false;
+
+  m_bUseReactor = bEnable;
+  return true;
+}
+
 void *CCECProcessor::Process(void)
 {
   m_controller->AddLog(CEC_LOG_DEBUG, "processor thread started");
 
   while (!m_bStop)
   {
-    bool bParseFrame(false);
+    bool bProcessed = ProcessFrame(CEC_BUTTON_TIMEOUT);
+
+    if (!m_bStop)
     {
-      CLockObject lock(&m_mutex);
-      cec_frame msg;
-      if (!m_bStop && m_communication->IsOpen() && m_communication->Read(msg, CEC_BUTTON_TIMEOUT))
-        bParseFrame = ParseMessage(msg);
+      ProcessTimers();
+      if (!bProcessed)
+        Sleep(50);
     }
+  }
 
-    if (!m_bStop && bParseFrame)
-      ParseCurrentFrame();
+  return NULL;
+}
 
-    if (!m_bStop)
+void CCECProcessor::ProcessPending(void)
+{
+  //called by the reactor's dispatcher. handle all frames that have been received, without waiting
+  for (int iFrames = 0; iFrames < CEC_REACTOR_MAX_FRAMES && !m_bStop && ProcessFrame(0); iFrames++) {}
+
+  if (!m_bStop)
+    ProcessTimers();
+}
+
+bool CCECProcessor::ProcessFrame(uint64_t iTimeout)
+{
+  //frames that were received while waiting for an ack are handled first, in the order they were received
+  bool bBuffered = m_frameBuffer.Size() > 0;
+
+  //wait for input without holding m_mutex, so transmissions don't have to wait for the timeout
+  if (!bBuffered && iTimeout > 0 && (!m_communication->IsOpen() || !m_communication->WaitForData(iTimeout)))
+    return false;
+
+  bool bRead(false), bParseFrame(false);
+  {
+    CLockObject lock(&m_mutex);
+    if (!m_bStop && (m_frameBuffer.Pop(m_message) || (m_communication->IsOpen() && m_communication->Read(m_message, 0))))
     {
-      m_controller->CheckKeypressTimeout();
-      Sleep(50);
+      bRead = true;
+      bParseFrame = ParseMessage(m_message);
     }
   }
 
-  return NULL;
+  if (!m_bStop && bParseFrame)
+  {
+    m_iFrameParsedTime = 0;
+    ParseCurrentFrame();
+    if (m_iFrameStartTime > 0)
+      TraceReceivedFrame();
+  }
+
+  return bRead;
+}
+
+void CCECProcessor::TraceReceivedFrame(void)
+{
+  //frames that were ignored end after parsing, frames that were handled or queued end when they were delivered
+  int64_t iEnd = GetTimeUs();
+  int64_t iEom = m_iFrameEomTime > 0 ? m_iFrameEomTime : m_iFrameStartTime;
+  int64_t iParsed = m_iFrameParsedTime > 0 ? m_iFrameParsedTime : iEnd;
+
+  CTraceWriter::AddSpan("frame", m_iFrameStartTime, iEom);
+  CTraceWriter::AddSpan("parse", iEom, iParsed);
+  if (m_iFrameParsedTime > 0)
+    CTraceWriter::AddSpan("deliver", m_iFrameParsedTime, iEnd);
+  CTraceWriter::AddSpan("receive", m_iFrameStartTime, iEnd,
+      "header", ((uint8_t) m_currentCommand.source << 4) | (uint8_t) m_currentCommand.destination,
+      "opcode", m_iCurrentFrameLength > 1 ? (int) m_currentCommand.opcode : -1,
+      "delivered", m_iFrameParsedTime > 0);
+  m_iFrameStartTime = 0;
+}
+
+void CCECProcessor::ProcessTimers(void)
+{
+  m_controller->CheckKeypressTimeout();
+  CheckAdapterHealth();
 }
 
 bool CCECProcessor::PowerOnDevices(cec_logical_address address /* = CECDEVICE_TV */)
@@ -110,10 +299,7 @@ bool CCECProcessor::PowerOnDevices(cec_logical_address address /* = CECDEVICE_TV
   CStdString strLog;
   strLog.Format("powering on devices with logical address %d", (int8_t)address);
   m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
-  cec_frame frame;
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_TEXT_VIEW_ON);
-  return Transmit(frame);
+  return Transmit(cec_message_builder<CEC_OPCODE_TEXT_VIEW_ON>::Build(m_iLogicalAddress, address));
 }
 
 bool CCECProcessor::StandbyDevices(cec_logical_address address /* = CECDEVICE_BROADCAST */)
@@ -124,10 +310,7 @@ bool CCECProcessor::StandbyDevices(cec_logical_address address /* = CECDEVICE_BR
   CStdString strLog;
   strLog.Format("putting all devices with logical address %d in standby mode", (int8_t)address);
   m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
-  cec_frame frame;
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_STANDBY);
-  return Transmit(frame);
+  return Transmit(cec_message_builder<CEC_OPCODE_STANDBY>::Build(m_iLogicalAddress, address));
 }
 
 bool CCECProcessor::SetActiveView(void)
@@ -136,12 +319,7 @@ bool CCECProcessor::SetActiveView(void)
     return false;
 
   m_controller->AddLog(CEC_LOG_DEBUG, "setting active view");
-  cec_frame frame;
-  frame.push_back(GetSourceDestination(CECDEVICE_BROADCAST));
-  frame.push_back((uint8_t) CEC_OPCODE_ACTIVE_SOURCE);
-  frame.push_back((m_physicaladdress >> 8) & 0xFF);
-  frame.push_back(m_physicaladdress & 0xFF);
-  return Transmit(frame);
+  return Transmit(cec_message_builder<CEC_OPCODE_ACTIVE_SOURCE>::Build(m_iLogicalAddress, m_physicaladdress));
 }
 
 bool CCECProcessor::SetInactiveView(void)
@@ -150,75 +328,711 @@ bool CCECProcessor::SetInactiveView(void)
     return false;
 
   m_controller->AddLog(CEC_LOG_DEBUG, "setting inactive view");
-  cec_frame frame;
-  frame.push_back(GetSourceDestination(CECDEVICE_BROADCAST));
-  frame.push_back((uint8_t) CEC_OPCODE_INACTIVE_SOURCE);
-  frame.push_back((m_physicaladdress >> 8) & 0xFF);
-  frame.push_back(m_physicaladdress & 0xFF);
-  return Transmit(frame);
+  return Transmit(cec_message_builder<CEC_OPCODE_INACTIVE_SOURCE>::Build(m_iLogicalAddress, m_physicaladdress));
 }
 
 bool CCECProcessor::Transmit(const cec_frame &data, bool bWaitForAck /* = true */)
 {
-  CStdString txStr = "transmit ";
+  if (data.size() > CEC_MAX_FRAME_SIZE)
+  {
+    CStdString strLog;
+    strLog.Format("not transmitting frame: %u bytes is more than the maximum of %u", (unsigned int) data.size(), CEC_MAX_FRAME_SIZE);
+    m_controller->AddLog(CEC_LOG_WARNING, strLog.c_str());
+    return false;
+  }
+
+  cec_message message;
+  message.size = (uint8_t) data.size();
   for (unsigned int i = 0; i < data.size(); i++)
-    txStr.AppendFormat(" %02x", data[i]);
-  m_controller->AddLog(CEC_LOG_DEBUG, txStr.c_str());
+    message.data[i] = data[i];
+
+  return Transmit(message, bWaitForAck);
+}
 
-  if (data.empty())
+bool CCECProcessor::Transmit(const cec_message &message, bool bWaitForAck /* = true */)
+{
+  CEC_PROBE3(transmit_queued, message.data, message.size, GetTimeUs());
+  int64_t iQueued = CTraceWriter::IsEnabled() ? GetTimeUs() : 0;
+
+  if (m_controller->IsLogging(CEC_LOG_DEBUG))
+  {
+    CStdString txStr = "transmit ";
+    for (unsigned int i = 0; i < message.size; i++)
+      txStr.AppendFormat(" %02x", message.data[i]);
+    m_controller->AddLog(CEC_LOG_DEBUG, txStr.c_str());
+  }
+
+  if (message.size == 0)
   {
     m_controller->AddLog(CEC_LOG_WARNING, "transmit buffer is empty");
     return false;
   }
 
-  cec_frame output;
+  if (!IsValidFrame(message))
+    return false;
 
-  //set ack polarity to high when transmitting to the broadcast address
-  //set ack polarity low when transmitting to any other address
-  output.push_back(MSGSTART);
-  CAdapterCommunication::PushEscaped(output, MSGCODE_TRANSMIT_ACK_POLARITY);
+  if (AtomicLoad(&m_iReconnecting) == 1)
+  {
+    //report a queued frame as sent, so the application doesn't transmit it again after reconnecting
+    QueuedTransmit queued;
+    queued.message     = message;
+    queued.iQueuedTime = GetTimeMs();
+    if (!m_transmitBuffer.PushMove(queued))
+    {
+      m_controller->AddLog(CEC_LOG_WARNING, "reconnecting to the adapter and the transmit buffer is full, frame dropped");
+      return false;
+    }
+    m_controller->AddLog(CEC_LOG_NOTICE, "reconnecting to the adapter, frame will be transmitted after reconnecting");
 
-  if ((data[0] & 0xF) == 0xF)
-    CAdapterCommunication::PushEscaped(output, CEC_TRUE);
-  else
-    CAdapterCommunication::PushEscaped(output, CEC_FALSE);
+    //the connection may have been restored after checking, and the queue emptied before this frame was added
+    if (AtomicLoad(&m_iReconnecting) == 0)
+      TransmitQueued();
+    return true;
+  }
 
-  output.push_back(MSGEND);
+  uint8_t output[CEC_MAX_FORMATTED_SIZE];
+  unsigned int iOutputSize = 0;
+  FormatFrame(message, output, iOutputSize);
 
-  for (unsigned int i = 0; i < data.size(); i++)
+  //ack polarity is high when transmitting to the broadcast address, low when transmitting to any other address
+  bool bReturn = TransmitFormatted(output, iOutputSize, message.size, (message.data[0] & 0xF) == CECDEVICE_BROADCAST, bWaitForAck);
+
+  //the stages of the transmission are recorded by TransmitFormatted() and WaitForAck(), and shown inside this span
+  if (iQueued > 0)
+    CTraceWriter::AddSpan("transmit", iQueued, GetTimeUs(), "header", message.data[0], "opcode", message.size > 1 ? message.data[1] : -1, "acked", bReturn);
+  return bReturn;
+}
+
+void CCECProcessor::FormatFrame(const cec_message &message, uint8_t *output, unsigned int &iOutputSize)
+{
+  for (unsigned int i = 0; i < message.size; i++)
   {
-    output.push_back(MSGSTART);
+    output[iOutputSize++] = MSGSTART;
 
-    if (i == data.size() - 1)
-      CAdapterCommunication::PushEscaped(output, MSGCODE_TRANSMIT_EOM);
+    if (i == (unsigned int) message.size - 1)
+      CAdapterCommunication::PushEscaped(output, iOutputSize, MSGCODE_TRANSMIT_EOM);
     else
-      CAdapterCommunication::PushEscaped(output, MSGCODE_TRANSMIT);
+      CAdapterCommunication::PushEscaped(output, iOutputSize, MSGCODE_TRANSMIT);
 
-    CAdapterCommunication::PushEscaped(output, data[i]);
+    CAdapterCommunication::PushEscaped(output, iOutputSize, message.data[i]);
 
-    output.push_back(MSGEND);
+    output[iOutputSize++] = MSGEND;
   }
+}
+
+bool CCECProcessor::IsValidFrame(const cec_message &message)
+{
+  //a frame without an opcode is a poll
+  if (message.size < 2)
+    return true;
+
+  const CecOpcodeDescriptor &descriptor = GetOpcodeDescriptor(message.data[1]);
+  if (descriptor.iFlags == 0)
+    return true;
 
-  return TransmitFormatted(output, bWaitForAck);
+  CStdString strLog;
+  bool bBroadcast = (message.data[0] & 0xF) == CECDEVICE_BROADCAST;
+  if (!(descriptor.iFlags & (bBroadcast ? CEC_OPCODE_FLAG_BROADCAST : CEC_OPCODE_FLAG_DIRECTED)))
+  {
+    strLog.Format("not transmitting frame: opcode %02x can't be sent as %s message", message.data[1], bBroadcast ? "a broadcast" : "a directed");
+    m_controller->AddLog(CEC_LOG_WARNING, strLog.c_str());
+    return false;
+  }
+
+  //additional operands are allowed, like when receiving: vendor commands and newer versions of the specification extend messages
+  unsigned int iParameters = message.size - 2;
+  if (iParameters < descriptor.iMinParameters)
+  {
+    strLog.Format("not transmitting frame: opcode %02x needs at least %u operands, got %u", message.data[1], descriptor.iMinParameters, iParameters);
+    m_controller->AddLog(CEC_LOG_WARNING, strLog.c_str());
+    return false;
+  }
+
+  return true;
 }
 
 bool CCECProcessor::SetLogicalAddress(cec_logical_address iLogicalAddress)
 {
+  if (iLogicalAddress <= CECDEVICE_UNKNOWN || iLogicalAddress >= CECDEVICE_BROADCAST)
+    return false;
+
+  {
+    //the device keeps its name when it moves to another logical address. an address that a device was added
+    //on with AddLogicalDevice() is taken, and isn't overwritten
+    CLockObject lock(&m_devicesMutex);
+    if (iLogicalAddress != m_iLogicalAddress && m_devices[iLogicalAddress].bActive)
+    {
+      lock.Leave();
+      CStdString strError;
+      strError.Format("can't set the logical address to %d, a logical device was added on that address", iLogicalAddress);
+      m_controller->AddLog(CEC_LOG_ERROR, strError.c_str());
+      return false;
+    }
+
+    CStdString strLog;
+    strLog.Format("setting logical address to %d", iLogicalAddress);
+    m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
+
+    if (iLogicalAddress != m_iLogicalAddress)
+    {
+      m_devices[iLogicalAddress] = m_devices[m_iLogicalAddress];
+      m_devices[iLogicalAddress].type = GetDeviceType(iLogicalAddress);
+      m_devices[m_iLogicalAddress].bActive = false;
+      m_iLogicalAddress = iLogicalAddress;
+    }
+    m_devices[iLogicalAddress].bActive = true;
+    UpdateAckMask();
+  }
+
+  {
+    CLockObject statsLock(&m_statisticsMutex);
+    m_statistics.logical_address = iLogicalAddress;
+  }
+
+  return SendAckMask();
+}
+
+bool CCECProcessor::SetDeviceType(cec_device_type type)
+{
+  CLockObject lock(&m_devicesMutex);
+  m_devices[m_iLogicalAddress].type = type;
+  m_bAllocateAddress = true;
+  return true;
+}
+
+bool CCECProcessor::AllocateLogicalAddress(void)
+{
+  static const cec_logical_address tvAddresses[]        = { CECDEVICE_TV, CECDEVICE_FREEUSE };
+  static const cec_logical_address recordingAddresses[] = { CECDEVICE_RECORDINGDEVICE1, CECDEVICE_RECORDINGDEVICE2, CECDEVICE_RECORDINGDEVICE3 };
+  static const cec_logical_address tunerAddresses[]     = { CECDEVICE_TUNER1, CECDEVICE_TUNER2, CECDEVICE_TUNER3, CECDEVICE_TUNER4 };
+  static const cec_logical_address playbackAddresses[]  = { CECDEVICE_PLAYBACKDEVICE1, CECDEVICE_PLAYBACKDEVICE2, CECDEVICE_PLAYBACKDEVICE3 };
+  static const cec_logical_address audioAddresses[]     = { CECDEVICE_AUDIOSYSTEM };
+
+  cec_device_type type = GetLogicalDevice(m_iLogicalAddress).type;
+  const cec_logical_address *candidates = NULL;
+  unsigned int iCandidates = 0;
+  switch (type)
+  {
+  case CEC_DEVICE_TYPE_TV:
+    candidates = tvAddresses;        iCandidates = sizeof(tvAddresses) / sizeof(tvAddresses[0]);
+    break;
+  case CEC_DEVICE_TYPE_RECORDING_DEVICE:
+    candidates = recordingAddresses; iCandidates = sizeof(recordingAddresses) / sizeof(recordingAddresses[0]);
+    break;
+  case CEC_DEVICE_TYPE_TUNER:
+    candidates = tunerAddresses;     iCandidates = sizeof(tunerAddresses) / sizeof(tunerAddresses[0]);
+    break;
+  case CEC_DEVICE_TYPE_PLAYBACK_DEVICE:
+    candidates = playbackAddresses;  iCandidates = sizeof(playbackAddresses) / sizeof(playbackAddresses[0]);
+    break;
+  case CEC_DEVICE_TYPE_AUDIO_SYSTEM:
+    candidates = audioAddresses;     iCandidates = sizeof(audioAddresses) / sizeof(audioAddresses[0]);
+    break;
+  default:
+    break;
+  }
+
+  if (iCandidates == 0)
+  {
+    CStdString strLog;
+    strLog.Format("can't allocate a logical address for device type %d", type);
+    m_controller->AddLog(CEC_LOG_ERROR, strLog.c_str());
+    return false;
+  }
+
+  //don't ack our own polls
+  {
+    CLockObject lock(&m_devicesMutex);
+    m_devices[m_iLogicalAddress].bActive = false;
+    UpdateAckMask();
+  }
+  if (!SendAckMask())
+    return false;
+
+  int64_t iStartTime = GetTimeUs();
+  cec_logical_address address = CECDEVICE_UNKNOWN;
+  cec_message poll;
+  poll.size = 1;
+
+  CLockObject lock(&m_mutex);
+  m_communication->SetLineTimeout(CEC_LINE_TIMEOUT);
+  m_communication->SetAckPolarity(false);
+  if (m_communication->HasCapability(CEC_ADAPTER_CAPABILITY_PIPELINED_TRANSMIT))
+  {
+    //send all polls in one go. the firmware reports the result of every one of them in order, so
+    //the allocation takes one round trip on the bus per candidate and no write delays
+    uint8_t output[CEC_MAX_FORMATTED_SIZE * CEC_MAX_ALLOCATE_CANDIDATES];
+    unsigned int iOutputSize = 0;
+    for (unsigned int iPtr = 0; iPtr < iCandidates; iPtr++)
+    {
+      poll.data[0] = (uint8_t) (((uint8_t) candidates[iPtr] << 4) | (uint8_t) candidates[iPtr]);
+      FormatFrame(poll, output, iOutputSize);
+    }
+
+    if (m_communication->Write(output, iOutputSize, iCandidates))
+    {
+      AddTransmittedFrames(iCandidates);
+
+      //wait for all results, so none of them is taken for the result of the next transmission
+      for (unsigned int iPtr = 0; iPtr < iCandidates; iPtr++)
+      {
+        uint8_t iResult = MSGCODE_NOTHING;
+        WaitForAck(CEC_ALLOCATE_TIMEOUT, MSGCODE_TRANSMIT_SUCCEEDED, &iResult);
+        if (iResult == MSGCODE_NOTHING)
+          break;
+        if (address == CECDEVICE_UNKNOWN && iResult == MSGCODE_TRANSMIT_FAILED_ACK)
+          address = candidates[iPtr];
+      }
+    }
+  }
+  else
+  {
+    for (unsigned int iPtr = 0; iPtr < iCandidates && address == CECDEVICE_UNKNOWN; iPtr++)
+    {
+      uint8_t output[CEC_MAX_FORMATTED_SIZE];
+      unsigned int iOutputSize = 0;
+      poll.data[0] = (uint8_t) (((uint8_t) candidates[iPtr] << 4) | (uint8_t) candidates[iPtr]);
+      FormatFrame(poll, output, iOutputSize);
+
+      uint8_t iResult = MSGCODE_NOTHING;
+      if (!m_communication->Write(output, iOutputSize, 1))
+        break;
+      AddTransmittedFrames(1);
+      WaitForAck(CEC_ALLOCATE_TIMEOUT, MSGCODE_TRANSMIT_SUCCEEDED, &iResult);
+      if (iResult == MSGCODE_TRANSMIT_FAILED_ACK)
+        address = candidates[iPtr];
+    }
+  }
+  lock.Leave();
+
+  int64_t iAllocationTime = GetTimeUs() - iStartTime;
+  CStdString strLog;
+  if (address == CECDEVICE_UNKNOWN)
+  {
+    strLog.Format("no free logical address for device type %d after %.1f ms", type, (float) iAllocationTime / 1000);
+    m_controller->AddLog(CEC_LOG_ERROR, strLog.c_str());
+
+    CLockObject devicesLock(&m_devicesMutex);
+    m_devices[m_iLogicalAddress].bActive = true;
+    UpdateAckMask();
+    devicesLock.Leave();
+    SendAckMask();
+    return false;
+  }
+
+  strLog.Format("allocated logical address %d in %.1f ms", address, (float) iAllocationTime / 1000);
+  m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
+
+  bool bReturn = SetLogicalAddress(address);
+
+  CLockObject devicesLock(&m_devicesMutex);
+  m_devices[address].type = type;
+  devicesLock.Leave();
+
+  CLockObject statsLock(&m_statisticsMutex);
+  m_statistics.allocation_time = iAllocationTime;
+  return bReturn;
+}
+
+bool CCECProcessor::AddLogicalDevice(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type)
+{
+  if (iLogicalAddress <= CECDEVICE_UNKNOWN || iLogicalAddress >= CECDEVICE_BROADCAST)
+  {
+    m_controller->AddLog(CEC_LOG_WARNING, "can't add a logical device without a valid logical address");
+    return false;
+  }
+
+  CStdString strLog;
+  strLog.Format("adding logical device %d with name '%s'", iLogicalAddress, strDeviceName ? strDeviceName : "");
+  m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
+
+  {
+    CLockObject lock(&m_devicesMutex);
+    LogicalDevice &device = m_devices[iLogicalAddress];
+    memset(&device, 0, sizeof(device));
+    device.bActive = true;
+    device.type    = type;
+    if (strDeviceName)
+      strncpy(device.strName, strDeviceName, sizeof(device.strName) - 1);
+    UpdateAckMask();
+  }
+
+  //the mask is sent when the connection is opened
+  return !m_communication || !m_communication->IsOpen() || SendAckMask();
+}
+
+bool CCECProcessor::RemoveLogicalDevice(cec_logical_address iLogicalAddress)
+{
+  if (iLogicalAddress <= CECDEVICE_UNKNOWN || iLogicalAddress >= CECDEVICE_BROADCAST || iLogicalAddress == m_iLogicalAddress)
+  {
+    m_controller->AddLog(CEC_LOG_WARNING, "can't remove a logical device that wasn't added");
+    return false;
+  }
+
+  {
+    CLockObject lock(&m_devicesMutex);
+    if (!m_devices[iLogicalAddress].bActive)
+      return false;
+    m_devices[iLogicalAddress].bActive = false;
+    UpdateAckMask();
+  }
+
   CStdString strLog;
-  strLog.Format("setting logical address to %d", iLogicalAddress);
+  strLog.Format("removed logical device %d", iLogicalAddress);
   m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
 
-  m_iLogicalAddress = iLogicalAddress;
-  return m_communication && m_communication->SetAckMask(0x1 << (uint8_t)m_iLogicalAddress);
+  return !m_communication || !m_communication->IsOpen() || SendAckMask();
+}
+
+void CCECProcessor::UpdateAckMask(void)
+{
+  m_iAckMask = 0;
+  for (uint8_t iPtr = 0; iPtr < CECDEVICE_BROADCAST; iPtr++)
+    if (m_devices[iPtr].bActive)
+      m_iAckMask |= 0x1 << iPtr;
+}
+
+bool CCECProcessor::SendAckMask(void)
+{
+  CLockObject lock(&m_devicesMutex);
+  uint16_t iMask = m_iAckMask;
+  lock.Leave();
+
+  return m_communication && m_communication->SetAckMask(iMask);
+}
+
+bool CCECProcessor::IsLogicalDevice(uint8_t iAddress)
+{
+  CLockObject lock(&m_devicesMutex);
+  return iAddress < CECDEVICE_BROADCAST && (m_iAckMask & (0x1 << iAddress)) != 0;
+}
+
+CCECProcessor::LogicalDevice CCECProcessor::GetLogicalDevice(cec_logical_address iLogicalAddress)
+{
+  CLockObject lock(&m_devicesMutex);
+  return m_devices[(uint8_t) iLogicalAddress & 0xF];
+}
+
+cec_device_type CCECProcessor::GetDeviceType(cec_logical_address iLogicalAddress)
+{
+  switch (iLogicalAddress)
+  {
+  case CECDEVICE_TV:
+    return CEC_DEVICE_TYPE_TV;
+  case CECDEVICE_RECORDINGDEVICE1:
+  case CECDEVICE_RECORDINGDEVICE2:
+  case CECDEVICE_RECORDINGDEVICE3:
+    return CEC_DEVICE_TYPE_RECORDING_DEVICE;
+  case CECDEVICE_TUNER1:
+  case CECDEVICE_TUNER2:
+  case CECDEVICE_TUNER3:
+  case CECDEVICE_TUNER4:
+    return CEC_DEVICE_TYPE_TUNER;
+  case CECDEVICE_AUDIOSYSTEM:
+    return CEC_DEVICE_TYPE_AUDIO_SYSTEM;
+  default:
+    return CEC_DEVICE_TYPE_PLAYBACK_DEVICE;
+  }
+}
+
+bool CCECProcessor::IsAdapterReply(uint8_t iCode)
+{
+  switch (iCode & ~(MSGCODE_FRAME_EOM | MSGCODE_FRAME_ACK))
+  {
+  case MSGCODE_COMMAND_ACCEPTED:
+  case MSGCODE_COMMAND_REJECTED:
+  case MSGCODE_RECEIVE_FAILED:
+  case MSGCODE_TRANSMIT_SUCCEEDED:
+  case MSGCODE_TRANSMIT_FAILED_LINE:
+  case MSGCODE_TRANSMIT_FAILED_ACK:
+  case MSGCODE_TRANSMIT_FAILED_TIMEOUT_DATA:
+  case MSGCODE_TRANSMIT_FAILED_TIMEOUT_LINE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool CCECProcessor::PingAdapter(void)
+{
+  CLockObject lock(&m_mutex);
+  int iResult(0);
+  int64_t iRtt(0);
+  if (m_communication && m_communication->PingAdapter())
+  {
+    //the reply to the ping is matched by the communication class, so late replies to earlier commands don't count as the pong
+    int64_t iNow = GetTimeUs();
+    int64_t iTargetTime = iNow + (int64_t) CEC_PING_TIMEOUT * (int64_t) 1000;
+    cec_frame msg;
+    while ((iResult = m_communication->GetPingResult(iRtt)) == 0 && iNow < iTargetTime)
+    {
+      if (m_communication->Read(msg, GetWaitTime(iTargetTime, iNow, CEC_PING_TIMEOUT)) && !msg.empty() && !IsAdapterReply(msg[0]))
+      {
+        if (!m_frameBuffer.Push(msg))
+          m_controller->AddLog(CEC_LOG_WARNING, "frame buffer is full");
+      }
+      iNow = GetTimeUs();
+    }
+
+    if (iResult == 0)
+      m_communication->CancelPing();
+  }
+  lock.Leave();
+
+  AddPingResult(iResult == 1, iRtt);
+  return iResult == 1;
+}
+
+void CCECProcessor::AddPingResult(bool bSuccess, int64_t iRtt)
+{
+  CLockObject statsLock(&m_statisticsMutex);
+  ++m_statistics.pings_sent;
+  if (!bSuccess)
+  {
+    ++m_statistics.pings_failed;
+    statsLock.Leave();
+    m_controller->AddLog(CEC_LOG_WARNING, "the adapter did not respond to the ping");
+    return;
+  }
+
+  uint64_t iPongs = m_statistics.pings_sent - m_statistics.pings_failed;
+  m_statistics.ping_rtt_last = iRtt;
+  m_statistics.ping_rtt_avg  = (m_statistics.ping_rtt_avg * (int64_t) (iPongs - 1) + iRtt) / (int64_t) iPongs;
+  if (iPongs == 1 || iRtt < m_statistics.ping_rtt_min)
+    m_statistics.ping_rtt_min = iRtt;
+  if (iRtt > m_statistics.ping_rtt_max)
+    m_statistics.ping_rtt_max = iRtt;
+  statsLock.Leave();
+
+  if (m_controller->IsLogging(CEC_LOG_DEBUG))
+  {
+    CStdString strLog;
+    strLog.Format("pong received after %.1f ms", (float) iRtt / 1000);
+    m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
+  }
+}
+
+void CCECProcessor::AddTransmittedFrames(unsigned int iFrames)
+{
+  CLockObject lock(&m_statisticsMutex);
+  m_statistics.frames_transmitted += iFrames;
+}
+
+void CCECProcessor::AddReceivedFrame(void)
+{
+  CLockObject lock(&m_statisticsMutex);
+  ++m_statistics.frames_received;
+}
+
+bool CCECProcessor::GetStatistics(cec_statistics *statistics)
+{
+  if (!statistics)
+    return false;
+
+  CLockObject lock(&m_statisticsMutex);
+  *statistics = m_statistics;
+  lock.Leave();
+
+  if (m_communication)
+  {
+    m_communication->GetWriteStatistics(statistics->write_calls, statistics->bytes_written);
+    m_communication->GetReadStatistics(statistics->input_buffer_size, statistics->bytes_discarded);
+  }
+  return true;
+}
+
+void CCECProcessor::CheckAdapterHealth(void)
+{
+  //called by the thread that handles the input of this adapter, which may be the reactor's dispatcher
+  //that's shared by all adapters. nothing in here waits for the adapter: the ping is sent and its reply
+  //is read like any other message, and the adapter is reopened by m_reconnector.
+  int64_t iNow = GetTimeMs();
+  if (!m_communication->IsOpen())
+  {
+    if (m_reconnector.IsRunning())
+      return;
+
+    CLockObject lock(&m_healthMutex);
+    bool bDisconnected(false);
+    if (AtomicLoad(&m_iReconnecting) == 0)
+    {
+      AtomicStore(&m_iReconnecting, 1);
+      m_iReconnectInterval = CEC_RECONNECT_MIN_INTERVAL;
+      m_iNextHealthCheck   = iNow;
+      m_iPingDeadline      = 0;
+      bDisconnected        = true;
+    }
+    bool bReconnect = iNow >= m_iNextHealthCheck;
+    lock.Leave();
+
+    if (bDisconnected)
+    {
+      m_controller->AddLog(CEC_LOG_ERROR, "lost the connection to the adapter");
+      cec_adapter adapter;
+      adapter.comm = m_communication->GetPortName();
+      m_controller->AddAdapterEvent(CEC_ADAPTER_EVENT_DISCONNECTED, adapter);
+    }
+
+    if (bReconnect && !m_reconnector.CreateThread())
+      m_controller->AddLog(CEC_LOG_ERROR, "could not create a thread to reconnect to the adapter");
+    return;
+  }
+
+  CLockObject lock(&m_healthMutex);
+  if (m_iPingDeadline > 0)
+  {
+    int64_t iRtt(0);
+    int iResult = m_communication->GetPingResult(iRtt);
+    if (iResult == 0 && iNow < m_iPingDeadline)
+      return;
+
+    m_iPingDeadline = 0;
+    if (iResult == 0)
+      m_communication->CancelPing();
+
+    bool bClose(false);
+    if (iResult == 1)
+      m_iPingFailures = 0;
+    else if (++m_iPingFailures >= CEC_HEALTH_MAX_PING_FAILURES)
+    {
+      //the adapter stopped responding. close the connection, it will be reopened on the next check
+      bClose = true;
+      m_iNextHealthCheck = iNow;
+    }
+    lock.Leave();
+
+    AddPingResult(iResult == 1, iRtt);
+    if (bClose)
+    {
+      m_controller->AddLog(CEC_LOG_ERROR, "the adapter stopped responding");
+      m_communication->Close();
+    }
+    return;
+  }
+
+  if (iNow < m_iNextHealthCheck)
+    return;
+  m_iNextHealthCheck = iNow + CEC_HEALTH_CHECK_INTERVAL;
+
+  if (m_communication->PingAdapter())
+  {
+    m_iPingDeadline = iNow + CEC_PING_TIMEOUT;
+    return;
+  }
+
+  bool bClose = ++m_iPingFailures >= CEC_HEALTH_MAX_PING_FAILURES;
+  if (bClose)
+    m_iNextHealthCheck = iNow;
+  lock.Leave();
+
+  AddPingResult(false, 0);
+  if (bClose)
+  {
+    m_controller->AddLog(CEC_LOG_ERROR, "the adapter stopped responding");
+    m_communication->Close();
+  }
+}
+
+void *CAdapterReconnector::Process(void)
+{
+  m_processor->Reconnect();
+  return NULL;
+}
+
+bool CCECProcessor::Reconnect(void)
+{
+  //called by m_reconnector. m_mutex isn't held while reopening, transmissions are queued until reconnected
+  if (!m_communication->Reopen(CEC_RECONNECT_TIMEOUT) || !SetLogicalAddress(m_iLogicalAddress))
+  {
+    CLockObject lock(&m_healthMutex);
+    m_iNextHealthCheck = GetTimeMs() + m_iReconnectInterval;
+
+    CStdString strLog;
+    strLog.Format("could not reconnect to the adapter, retrying in %d ms", (int) m_iReconnectInterval);
+
+    m_iReconnectInterval *= 2;
+    if (m_iReconnectInterval > CEC_RECONNECT_MAX_INTERVAL)
+      m_iReconnectInterval = CEC_RECONNECT_MAX_INTERVAL;
+    lock.Leave();
+
+    m_controller->AddLog(CEC_LOG_WARNING, strLog.c_str());
+    return false;
+  }
+
+  {
+    CLockObject lock(&m_healthMutex);
+    m_iPingFailures    = 0;
+    m_iPingDeadline    = 0;
+    m_iNextHealthCheck = GetTimeMs() + CEC_HEALTH_CHECK_INTERVAL;
+  }
+  AtomicStore(&m_iReconnecting, 0);
+
+  {
+    CLockObject statsLock(&m_statisticsMutex);
+    ++m_statistics.reconnects;
+  }
+
+  m_controller->AddLog(CEC_LOG_NOTICE, "reconnected to the adapter");
+  cec_adapter adapter;
+  adapter.comm = m_communication->GetPortName();
+  m_controller->AddAdapterEvent(CEC_ADAPTER_EVENT_RECONNECTED, adapter);
+
+  TransmitQueued();
+  return true;
+}
+
+void CCECProcessor::TransmitQueued(void)
+{
+  //send the frames that were queued while reconnecting, in order. frames that waited too long are out of date, like key presses
+  QueuedTransmit queued;
+  while (m_transmitBuffer.Pop(queued))
+  {
+    if (GetTimeMs() - queued.iQueuedTime > CEC_RECONNECT_MAX_QUEUE_TIME)
+    {
+      CStdString strLog;
+      strLog.Format("frame %02x was queued for more than %d ms while reconnecting, dropped", queued.message.data[0], CEC_RECONNECT_MAX_QUEUE_TIME);
+      m_controller->AddLog(CEC_LOG_WARNING, strLog.c_str());
+      continue;
+    }
+    Transmit(queued.message);
+  }
 }
 
-bool CCECProcessor::TransmitFormatted(const cec_frame &data, bool bWaitForAck /* = true */)
+bool CCECProcessor::TransmitFormatted(const uint8_t *data, unsigned int iSize, unsigned int iCommands, bool bAckPolarity, bool bWaitForAck /* = true */)
 {
+  int64_t iQueued = CTraceWriter::IsEnabled() ? GetTimeUs() : 0;
   CLockObject lock(&m_mutex);
-  if (!m_communication || !m_communication->Write(data))
+  if (!m_communication)
     return false;
 
-  if (bWaitForAck && !WaitForAck())
+  //both are only sent to the adapter when they changed, in the same write as the frame itself
+  m_communication->SetLineTimeout(CEC_LINE_TIMEOUT);
+  m_communication->SetAckPolarity(bAckPolarity);
+
+  if (!m_communication->Write(data, iSize, iCommands))
+    return false;
+  AddTransmittedFrames(1);
+  CEC_PROBE3(transmit_written, data, iSize, GetTimeUs());
+  int64_t iWritten = iQueued > 0 ? GetTimeUs() : 0;
+  if (iQueued > 0)
+    CTraceWriter::AddSpan("write", iQueued, iWritten, "bytes", iSize);
+
+  if (!bWaitForAck)
+    return true;
+
+  uint8_t iResult(MSGCODE_NOTHING);
+  m_iTransmitAcceptedTime = 0;
+  bool bAcked = WaitForAck(1000, MSGCODE_TRANSMIT_SUCCEEDED, &iResult);
+  CEC_PROBE3(transmit_acked, bAcked, iResult, GetTimeUs());
+  if (iQueued > 0)
+  {
+    //firmware that doesn't report accepted commands shows the whole wait as a single stage
+    int64_t iAccepted = m_iTransmitAcceptedTime > 0 ? m_iTransmitAcceptedTime : iWritten;
+    if (iAccepted > iWritten)
+      CTraceWriter::AddSpan("accept", iWritten, iAccepted);
+    CTraceWriter::AddSpan("ack", iAccepted, GetTimeUs(), "result", iResult);
+  }
+  if (!bAcked)
   {
     m_controller->AddLog(CEC_LOG_DEBUG, "did not receive ACK");
     return false;
@@ -227,119 +1041,89 @@ bool CCECProcessor::TransmitFormatted(const cec_frame &data, bool bWaitForAck /*
   return true;
 }
 
-void CCECProcessor::TransmitAbort(cec_logical_address address, cec_opcode opcode, ECecAbortReason reason /* = CEC_ABORT_REASON_UNRECOGNIZED_OPCODE */)
+void CCECProcessor::TransmitAbort(cec_logical_address initiator, cec_logical_address address, cec_opcode opcode, cec_abort_reason reason /* = CEC_ABORT_REASON_UNRECOGNIZED_OPCODE */)
 {
   m_controller->AddLog(CEC_LOG_DEBUG, "transmitting abort message");
-  cec_frame frame;
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_FEATURE_ABORT);
-  frame.push_back((uint8_t) opcode);
-  frame.push_back((uint8_t) reason);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_FEATURE_ABORT>::Build(initiator, address, opcode, reason));
 }
 
-void CCECProcessor::ReportCECVersion(cec_logical_address address /* = CECDEVICE_TV */)
+void CCECProcessor::ReportCECVersion(cec_logical_address initiator, cec_logical_address address /* = CECDEVICE_TV */)
 {
-  cec_frame frame;
   m_controller->AddLog(CEC_LOG_NOTICE, "reporting CEC version as 1.3a");
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_CEC_VERSION);
-  frame.push_back(CEC_VERSION_1_3A);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_CEC_VERSION>::Build(initiator, address, CEC_VERSION_1_3A));
 }
 
-void CCECProcessor::ReportPowerState(cec_logical_address address /*= CECDEVICE_TV */, bool bOn /* = true */)
+void CCECProcessor::ReportPowerState(cec_logical_address initiator, cec_logical_address address /*= CECDEVICE_TV */, bool bOn /* = true */)
 {
-  cec_frame frame;
   if (bOn)
     m_controller->AddLog(CEC_LOG_NOTICE, "reporting \"On\" power status");
   else
     m_controller->AddLog(CEC_LOG_NOTICE, "reporting \"Off\" power status");
 
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_REPORT_POWER_STATUS);
-  frame.push_back(bOn ? (uint8_t) CEC_POWER_STATUS_ON : (uint8_t) CEC_POWER_STATUS_STANDBY);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_REPORT_POWER_STATUS>::Build(initiator, address, bOn ? CEC_POWER_STATUS_ON : CEC_POWER_STATUS_STANDBY));
 }
 
-void CCECProcessor::ReportMenuState(cec_logical_address address /* = CECDEVICE_TV */, bool bActive /* = true */)
+void CCECProcessor::ReportMenuState(cec_logical_address initiator, cec_logical_address address /* = CECDEVICE_TV */, bool bActive /* = true */)
 {
-  cec_frame frame;
   if (bActive)
     m_controller->AddLog(CEC_LOG_NOTICE, "reporting menu state as active");
   else
     m_controller->AddLog(CEC_LOG_NOTICE, "reporting menu state as inactive");
 
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_MENU_STATUS);
-  frame.push_back(bActive ? (uint8_t) CEC_MENU_STATE_ACTIVATED : (uint8_t) CEC_MENU_STATE_DEACTIVATED);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_MENU_STATUS>::Build(initiator, address, bActive ? CEC_MENU_STATE_ACTIVATED : CEC_MENU_STATE_DEACTIVATED));
 }
 
-void CCECProcessor::ReportVendorID(cec_logical_address address /* = CECDEVICE_TV */)
+void CCECProcessor::ReportVendorID(cec_logical_address initiator, cec_logical_address address /* = CECDEVICE_TV */)
 {
   m_controller->AddLog(CEC_LOG_NOTICE, "vendor ID requested, feature abort");
-  TransmitAbort(address, CEC_OPCODE_GIVE_DEVICE_VENDOR_ID);
+  TransmitAbort(initiator, address, CEC_OPCODE_GIVE_DEVICE_VENDOR_ID);
 }
 
-void CCECProcessor::ReportOSDName(cec_logical_address address /* = CECDEVICE_TV */)
+void CCECProcessor::ReportOSDName(cec_logical_address initiator, cec_logical_address address /* = CECDEVICE_TV */)
 {
-  cec_frame frame;
-  const char *osdname = m_strDeviceName.c_str();
+  LogicalDevice device = GetLogicalDevice(initiator);
   CStdString strLog;
-  strLog.Format("reporting OSD name as %s", osdname);
+  strLog.Format("reporting OSD name of %d as %s", initiator, device.strName);
   m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
-  frame.push_back(GetSourceDestination(address));
-  frame.push_back((uint8_t) CEC_OPCODE_SET_OSD_NAME);
-
-  for (unsigned int i = 0; i < strlen(osdname); i++)
-    frame.push_back(osdname[i]);
-
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_SET_OSD_NAME>::Build(initiator, address, device.strName));
 }
 
-void CCECProcessor::ReportPhysicalAddress(void)
+void CCECProcessor::ReportPhysicalAddress(cec_logical_address initiator)
 {
-  cec_frame frame;
+  LogicalDevice device = GetLogicalDevice(initiator);
   CStdString strLog;
-  strLog.Format("reporting physical address as %04x", m_physicaladdress);
+  strLog.Format("reporting physical address of %d as %04x", initiator, m_physicaladdress);
   m_controller->AddLog(CEC_LOG_NOTICE, strLog.c_str());
-  frame.push_back(GetSourceDestination(CECDEVICE_BROADCAST));
-  frame.push_back((uint8_t) CEC_OPCODE_REPORT_PHYSICAL_ADDRESS);
-  frame.push_back((m_physicaladdress >> 8) & 0xFF);
-  frame.push_back(m_physicaladdress & 0xFF);
-  frame.push_back(CEC_DEVICE_TYPE_PLAYBACK_DEVICE);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_REPORT_PHYSICAL_ADDRESS>::Build(initiator, m_physicaladdress, device.type));
 }
 
 void CCECProcessor::BroadcastActiveSource(void)
 {
-  cec_frame frame;
   m_controller->AddLog(CEC_LOG_NOTICE, "broadcasting active source");
-  frame.push_back(GetSourceDestination(CECDEVICE_BROADCAST));
-  frame.push_back((uint8_t) CEC_OPCODE_ACTIVE_SOURCE);
-  frame.push_back((m_physicaladdress >> 8) & 0xFF);
-  frame.push_back(m_physicaladdress & 0xFF);
-  Transmit(frame);
+  Transmit(cec_message_builder<CEC_OPCODE_ACTIVE_SOURCE>::Build(m_iLogicalAddress, m_physicaladdress));
 }
 
-uint8_t CCECProcessor::GetSourceDestination(cec_logical_address destination /* = CECDEVICE_BROADCAST */) const
+uint64_t CCECProcessor::GetWaitTime(int64_t iTargetTimeUs, int64_t iNowUs, int iTimeout)
 {
-  return ((uint8_t)m_iLogicalAddress << 4) + (uint8_t)destination;
+  if (iTimeout <= 0)
+    return 1000;
+
+  // round up, so we never wait for 0 ms before the deadline has passed
+  return iTargetTimeUs > iNowUs ? (uint64_t) ((iTargetTimeUs - iNowUs + 999) / 1000) : 0;
 }
 
-bool CCECProcessor::WaitForAck(int iTimeout /* = 1000 */)
+bool CCECProcessor::WaitForAck(int iTimeout /* = 1000 */, ECecMessageCode iSuccessCode /* = MSGCODE_TRANSMIT_SUCCEEDED */, uint8_t *iResult /* = NULL */)
 {
   bool bGotAck(false);
   bool bError(false);
 
-  int64_t iNow = GetTimeMs();
-  int64_t iTargetTime = iNow + (int64_t) iTimeout;
+  int64_t iNow = GetTimeUs();
+  int64_t iTargetTime = iNow + (int64_t) iTimeout * (int64_t) 1000;
 
   while (!bGotAck && !bError && (iTimeout <= 0 || iNow < iTargetTime))
   {
     cec_frame msg;
-    while (!bGotAck && !bError && m_communication->Read(msg, iTimeout))
+    while (!bGotAck && !bError && m_communication->Read(msg, GetWaitTime(iTargetTime, iNow, iTimeout)))
     {
       uint8_t iCode = msg[0] & ~(MSGCODE_FRAME_EOM | MSGCODE_FRAME_ACK);
 
@@ -347,11 +1131,14 @@ bool CCECProcessor::WaitForAck(int iTimeout /* = 1000 */)
       {
       case MSGCODE_COMMAND_ACCEPTED:
         m_controller->AddLog(CEC_LOG_DEBUG, "MSGCODE_COMMAND_ACCEPTED");
+        if (CTraceWriter::IsEnabled())
+          m_iTransmitAcceptedTime = GetTimeUs();
+        bGotAck = iSuccessCode == MSGCODE_COMMAND_ACCEPTED;
         break;
       case MSGCODE_TRANSMIT_SUCCEEDED:
         m_controller->AddLog(CEC_LOG_DEBUG, "MSGCODE_TRANSMIT_SUCCEEDED");
         // TODO
-        bGotAck = true;
+        bGotAck = iSuccessCode == MSGCODE_TRANSMIT_SUCCEEDED;
         break;
       case MSGCODE_RECEIVE_FAILED:
         m_controller->AddLog(CEC_LOG_WARNING, "MSGCODE_RECEIVE_FAILED");
@@ -378,12 +1165,18 @@ bool CCECProcessor::WaitForAck(int iTimeout /* = 1000 */)
         bError = true;
         break;
       default:
-        m_frameBuffer.Push(msg);
-        bGotAck = (msg[0] & MSGCODE_FRAME_ACK) != 0;
+        if (!m_frameBuffer.Push(msg))
+          m_controller->AddLog(CEC_LOG_WARNING, "frame buffer is full");
+        if (iSuccessCode == MSGCODE_TRANSMIT_SUCCEEDED)
+          bGotAck = (msg[0] & MSGCODE_FRAME_ACK) != 0;
         break;
       }
-      iNow = GetTimeMs();
+
+      if (iResult && (bGotAck || bError))
+        *iResult = iCode;
+      iNow = GetTimeUs();
     }
+    iNow = GetTimeUs();
   }
 
   return bGotAck && !bError;
@@ -409,6 +1202,7 @@ bool CCECProcessor::ParseMessage(cec_frame &msg)
   case MSGCODE_TIMEOUT_ERROR:
   case MSGCODE_HIGH_ERROR:
   case MSGCODE_LOW_ERROR:
+    if (m_controller->IsLogging(CEC_LOG_WARNING))
     {
       if (iCode == MSGCODE_TIMEOUT_ERROR)
         logStr = "MSGCODE_TIMEOUT";
@@ -426,32 +1220,55 @@ bool CCECProcessor::ParseMessage(cec_frame &msg)
     break;
   case MSGCODE_FRAME_START:
     {
-      logStr = "MSGCODE_FRAME_START";
-      m_currentframe.clear();
+      //every byte of a frame is logged, so the line is only formatted when it won't be dropped
+      bool bLog = m_controller->IsLogging(CEC_LOG_DEBUG);
+      if (bLog)
+        logStr = "MSGCODE_FRAME_START";
+      m_iFrameStartTime = CTraceWriter::IsEnabled() ? GetTimeUs() : 0;
+      m_iFrameEomTime   = 0;
+      //the command is built in place and moved to the application, so clearing it keeps the capacity of the parameters
+      m_currentCommand.parameters.clear();
+      m_iCurrentFrameLength = 0;
       if (msg.size() >= 2)
       {
         int iInitiator = msg[1] >> 4;
         int iDestination = msg[1] & 0xF;
-        logStr.AppendFormat(" initiator:%u destination:%u ack:%s %s", iInitiator, iDestination, bAck ? "high" : "low", bEom ? "eom" : "");
-
-        m_currentframe.push_back(msg[1]);
+        if (bLog)
+          logStr.AppendFormat(" initiator:%u destination:%u ack:%s %s", iInitiator, iDestination, bAck ? "high" : "low", bEom ? "eom" : "");
+
+        AddToCurrentFrame(msg[1]);
+        CEC_PROBE3(frame_start, msg[1], bAck, GetTimeUs());
+        if (bEom)
+        {
+          CEC_PROBE5(frame_eom, iInitiator, iDestination, -1, m_iCurrentFrameLength, GetTimeUs());
+          AddReceivedFrame();
+          if (m_iFrameStartTime > 0)
+            CTraceWriter::AddInstant("poll", m_iFrameStartTime, "header", msg[1]);
+        }
       }
-      m_controller->AddLog(CEC_LOG_DEBUG, logStr.c_str());
+      if (bLog)
+        m_controller->AddLog(CEC_LOG_DEBUG, logStr.c_str());
     }
     break;
   case MSGCODE_FRAME_DATA:
+    if (msg.size() >= 2)
+      AddToCurrentFrame(msg[1]);
+    if (m_controller->IsLogging(CEC_LOG_DEBUG))
     {
       logStr = "MSGCODE_FRAME_DATA";
       if (msg.size() >= 2)
-      {
-        uint8_t iData = msg[1];
-        logStr.AppendFormat(" %02x", iData);
-        m_currentframe.push_back(iData);
-      }
+        logStr.AppendFormat(" %02x", msg[1]);
       m_controller->AddLog(CEC_LOG_DEBUG, logStr.c_str());
     }
     if (bEom)
+    {
+      CEC_PROBE5(frame_eom, m_currentCommand.source, m_currentCommand.destination,
+          m_iCurrentFrameLength > 1 ? (int) m_currentCommand.opcode : -1, m_iCurrentFrameLength, GetTimeUs());
+      AddReceivedFrame();
+      if (m_iFrameStartTime > 0)
+        m_iFrameEomTime = GetTimeUs();
       bReturn = true;
+    }
     break;
   default:
     break;
@@ -460,98 +1277,186 @@ bool CCECProcessor::ParseMessage(cec_frame &msg)
   return bReturn;
 }
 
+void CCECProcessor::AddToCurrentFrame(uint8_t iData)
+{
+  if (m_iCurrentFrameLength == 0)
+  {
+    m_currentCommand.source      = (cec_logical_address) (iData >> 4);
+    m_currentCommand.destination = (cec_logical_address) (iData & 0xF);
+  }
+  else if (m_iCurrentFrameLength == 1)
+  {
+    m_currentCommand.opcode = (cec_opcode) iData;
+  }
+  else
+  {
+    m_currentCommand.parameters.push_back(iData);
+  }
+  m_iCurrentFrameLength++;
+}
+
 void CCECProcessor::ParseCurrentFrame(void)
 {
-  uint8_t initiator = m_currentframe[0] >> 4;
-  uint8_t destination = m_currentframe[0] & 0xF;
+  if (m_iCurrentFrameLength == 0)
+    return;
 
-  CStdString dataStr;
-  dataStr.Format("received frame: initiator: %u destination: %u", initiator, destination);
+  uint8_t initiator = (uint8_t) m_currentCommand.source;
+  uint8_t destination = (uint8_t) m_currentCommand.destination;
+  const cec_frame &params = m_currentCommand.parameters;
 
-  if (m_currentframe.size() > 1)
+  if (m_controller->IsLogging(CEC_LOG_DEBUG))
   {
-    dataStr += " data:";
-    for (unsigned int i = 1; i < m_currentframe.size(); i++)
-      dataStr.AppendFormat(" %02x", m_currentframe[i]);
+    CStdString dataStr;
+    dataStr.Format("received frame: initiator: %u destination: %u", initiator, destination);
+
+    if (m_iCurrentFrameLength > 1)
+    {
+      dataStr.AppendFormat(" data: %02x", (uint8_t) m_currentCommand.opcode);
+      for (unsigned int i = 0; i < params.size(); i++)
+        dataStr.AppendFormat(" %02x", params[i]);
+    }
+    m_controller->AddLog(CEC_LOG_DEBUG, dataStr.c_str());
   }
-  m_controller->AddLog(CEC_LOG_DEBUG, dataStr.c_str());
 
-  if (m_currentframe.size() <= 1)
+  if (m_iCurrentFrameLength <= 1)
     return;
 
-  vector<uint8_t> tx;
-  cec_opcode opCode = (cec_opcode) m_currentframe[1];
-  if (destination == (uint16_t) m_iLogicalAddress)
+  if (destination != (uint8_t) CECDEVICE_BROADCAST && !IsLogicalDevice(destination))
   {
-    switch(opCode)
+    if (m_controller->IsLogging(CEC_LOG_DEBUG))
     {
-    case CEC_OPCODE_GIVE_PHYSICAL_ADDRESS:
-      ReportPhysicalAddress();
-      SetActiveView();
-      break;
-    case CEC_OPCODE_GIVE_OSD_NAME:
-      ReportOSDName((cec_logical_address)initiator);
-      break;
-    case CEC_OPCODE_GIVE_DEVICE_VENDOR_ID:
-      ReportVendorID((cec_logical_address)initiator);
-      break;
-    case CEC_OPCODE_MENU_REQUEST:
-      ReportMenuState((cec_logical_address)initiator);
-      break;
-    case CEC_OPCODE_GIVE_DEVICE_POWER_STATUS:
-      ReportPowerState((cec_logical_address)initiator);
-      break;
-    case CEC_OPCODE_GET_CEC_VERSION:
-      ReportCECVersion((cec_logical_address)initiator);
-      break;
-    case CEC_OPCODE_USER_CONTROL_PRESSED:
-      if (m_currentframe.size() > 2)
-      {
-        m_controller->AddKey();
-
-        if (m_currentframe[2] <= CEC_USER_CONTROL_CODE_MAX)
-          m_controller->SetCurrentButton((cec_user_control_code) m_currentframe[2]);
-      }
-      break;
-    case CEC_OPCODE_USER_CONTROL_RELEASE:
-      m_controller->AddKey();
-      break;
-    default:
-      cec_frame params = m_currentframe;
-      params.erase(params.begin(), params.begin() + 2);
-      m_controller->AddCommand((cec_logical_address) initiator, (cec_logical_address) destination, opCode, &params);
-      break;
+      CStdString strLog;
+      strLog.Format("ignoring frame: destination %u isn't one of our logical devices", destination);
+      m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
     }
+    return;
   }
-  else if (destination == (uint8_t) CECDEVICE_BROADCAST)
+
+  //frames with an opcode that isn't defined by the specification are passed on as is
+  const CecOpcodeDescriptor &descriptor = GetOpcodeDescriptor((uint8_t) m_currentCommand.opcode);
+  if (descriptor.iFlags != 0)
   {
-    if (opCode == CEC_OPCODE_REQUEST_ACTIVE_SOURCE)
+    bool bBroadcast = destination == (uint8_t) CECDEVICE_BROADCAST;
+    if (!(descriptor.iFlags & (bBroadcast ? CEC_OPCODE_FLAG_BROADCAST : CEC_OPCODE_FLAG_DIRECTED)))
     {
-      BroadcastActiveSource();
+      CStdString strLog;
+      strLog.Format("ignoring frame: opcode %02x can't be sent as %s message", (uint8_t) m_currentCommand.opcode, bBroadcast ? "a broadcast" : "a directed");
+      m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
+      return;
     }
-    else if (opCode == CEC_OPCODE_SET_STREAM_PATH)
-    {
-      if (m_currentframe.size() >= 4)
-      {
-        int streamaddr = ((int)m_currentframe[2] << 8) | ((int)m_currentframe[3]);
-        CStdString strLog;
-        strLog.Format("%i requests stream path from physical address %04x", initiator, streamaddr);
-        m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
-        if (streamaddr == m_physicaladdress)
-          BroadcastActiveSource();
-      }
-    }
-    else
+
+    //additional operands are ignored, so newer versions of the specification can extend messages
+    if (params.size() < descriptor.iMinParameters)
     {
-      cec_frame params = m_currentframe;
-      params.erase(params.begin(), params.begin() + 2);
-      m_controller->AddCommand((cec_logical_address) initiator, (cec_logical_address) destination, opCode, &params);
+      CStdString strLog;
+      strLog.Format("ignoring frame: opcode %02x needs at least %u operands, got %u", (uint8_t) m_currentCommand.opcode, descriptor.iMinParameters, (unsigned int) params.size());
+      m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
+      return;
     }
   }
-  else
-  {
-    CStdString strLog;
-    strLog.Format("ignoring frame: destination: %u != %u", destination, (uint16_t)m_iLogicalAddress);
-    m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
-  }
+
+  if (m_iFrameStartTime > 0)
+    m_iFrameParsedTime = GetTimeUs();
+
+  if (!HandleCommand(m_currentCommand))
+    m_controller->AddCommand(m_currentCommand);
+}
+
+bool CCECProcessor::SetCommandHandler(cec_opcode opcode, cec_command_handler handler, void *param)
+{
+  if ((unsigned int) opcode > 0xFF)
+    return false;
+
+  CLockObject lock(&m_handlerMutex);
+  m_handlers[opcode].handler = handler;
+  m_handlers[opcode].param   = handler ? param : NULL;
+  return true;
+}
+
+bool CCECProcessor::HandleCommand(const cec_command &command)
+{
+  uint8_t iOpcode = (uint8_t) command.opcode;
+
+  //handlers of the application run first, so they can override the built-in ones
+  CLockObject lock(&m_handlerMutex);
+  CommandHandler handler = m_handlers[iOpcode];
+  lock.Leave();
+
+  if (handler.handler && handler.handler(handler.param, &command))
+    return true;
+
+  BuiltinHandler builtinHandler = m_builtinHandlers[iOpcode];
+  return builtinHandler && (this->*builtinHandler)(command);
+}
+
+bool CCECProcessor::HandleGivePhysicalAddress(const cec_command &command)
+{
+  ReportPhysicalAddress(command.destination);
+  if (command.destination == m_iLogicalAddress)
+    SetActiveView();
+  return true;
+}
+
+bool CCECProcessor::HandleGiveOSDName(const cec_command &command)
+{
+  ReportOSDName(command.destination, command.source);
+  return true;
+}
+
+bool CCECProcessor::HandleGiveDeviceVendorId(const cec_command &command)
+{
+  ReportVendorID(command.destination, command.source);
+  return true;
+}
+
+bool CCECProcessor::HandleMenuRequest(const cec_command &command)
+{
+  ReportMenuState(command.destination, command.source);
+  return true;
+}
+
+bool CCECProcessor::HandleGiveDevicePowerStatus(const cec_command &command)
+{
+  ReportPowerState(command.destination, command.source);
+  return true;
+}
+
+bool CCECProcessor::HandleGetCECVersion(const cec_command &command)
+{
+  ReportCECVersion(command.destination, command.source);
+  return true;
+}
+
+bool CCECProcessor::HandleUserControlPressed(const cec_command &command)
+{
+  m_controller->AddKey();
+
+  if (command.parameters[0] <= CEC_USER_CONTROL_CODE_MAX)
+    m_controller->SetCurrentButton((cec_user_control_code) command.parameters[0]);
+  return true;
+}
+
+bool CCECProcessor::HandleUserControlRelease(const cec_command &command)
+{
+  (void) command;
+  m_controller->AddKey();
+  return true;
+}
+
+bool CCECProcessor::HandleRequestActiveSource(const cec_command &command)
+{
+  (void) command;
+  BroadcastActiveSource();
+  return true;
+}
+
+bool CCECProcessor::HandleSetStreamPath(const cec_command &command)
+{
+  int streamaddr = ((int)command.parameters[0] << 8) | ((int)command.parameters[1]);
+  CStdString strLog;
+  strLog.Format("%i requests stream path from physical address %04x", command.source, streamaddr);
+  m_controller->AddLog(CEC_LOG_DEBUG, strLog.c_str());
+  if (streamaddr == m_physicaladdress)
+    BroadcastActiveSource();
+  return true;
 }
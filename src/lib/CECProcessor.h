@@ -42,44 +42,163 @@ namespace CEC
 {
   class CLibCEC;
   class CAdapterCommunication;
+  class CAdapterReactor;
+
+  inline bool CecBufferEquals(const cec_message &a, const cec_message &b)
+  {
+    return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+  }
+
+  typedef struct QueuedTransmit
+  {
+    cec_message message;
+    int64_t     iQueuedTime; /*!< when the frame was queued, in milliseconds */
+  } QueuedTransmit;
+
+  inline bool CecBufferEquals(const QueuedTransmit &a, const QueuedTransmit &b)
+  {
+    return CecBufferEquals(a.message, b.message);
+  }
+
+  class CCECProcessor;
+
+  class CAdapterReconnector : public CThread
+  {
+  public:
+    CAdapterReconnector(CCECProcessor *processor) : CThread("cec-reconnect"), m_processor(processor) {}
+    virtual ~CAdapterReconnector(void) {}
+
+    void *Process(void);
+
+  private:
+    CCECProcessor *m_processor;
+  };
 
   class CCECProcessor : public CThread
   {
+    friend class CAdapterReconnector;
+
     public:
       CCECProcessor(CLibCEC *controller, CAdapterCommunication *serComm, const char *strDeviceName, cec_logical_address iLogicalAddress = CECDEVICE_PLAYBACKDEVICE1, uint16_t iPhysicalAddress = CEC_DEFAULT_PHYSICAL_ADDRESS);
       virtual ~CCECProcessor(void);
 
       virtual bool Start(void);
+      virtual bool StopThread(bool bWaitForExit = true);
+      virtual bool IsRunning(void) const { return m_reactor ? !m_bStop : CThread::IsRunning(); }
       void *Process(void);
+      void ProcessPending(void);
+      bool SetUseReactor(bool bEnable);
+      virtual bool SetThreadConfig(const cec_thread_config &config);
 
       virtual bool PowerOnDevices(cec_logical_address address = CECDEVICE_TV);
       virtual bool StandbyDevices(cec_logical_address address = CECDEVICE_BROADCAST);
       virtual bool SetActiveView(void);
       virtual bool SetInactiveView(void);
       virtual bool Transmit(const cec_frame &data, bool bWaitForAck = true);
+      virtual bool Transmit(const cec_message &message, bool bWaitForAck = true);
       virtual bool SetLogicalAddress(cec_logical_address iLogicalAddress);
+      virtual bool SetDeviceType(cec_device_type type);
+      virtual bool AddLogicalDevice(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type);
+      virtual bool RemoveLogicalDevice(cec_logical_address iLogicalAddress);
+      virtual bool PingAdapter(void);
+      virtual bool GetStatistics(cec_statistics *statistics);
+      virtual bool SetCommandHandler(cec_opcode opcode, cec_command_handler handler, void *param);
     protected:
-      virtual bool TransmitFormatted(const cec_frame &data, bool bWaitForAck = true);
-      virtual void TransmitAbort(cec_logical_address address, cec_opcode opcode, ECecAbortReason reason = CEC_ABORT_REASON_UNRECOGNIZED_OPCODE);
-      virtual void ReportCECVersion(cec_logical_address address = CECDEVICE_TV);
-      virtual void ReportPowerState(cec_logical_address address = CECDEVICE_TV, bool bOn = true);
-      virtual void ReportMenuState(cec_logical_address address = CECDEVICE_TV, bool bActive = true);
-      virtual void ReportVendorID(cec_logical_address address = CECDEVICE_TV);
-      virtual void ReportOSDName(cec_logical_address address = CECDEVICE_TV);
-      virtual void ReportPhysicalAddress(void);
+      virtual bool TransmitFormatted(const uint8_t *data, unsigned int iSize, unsigned int iCommands, bool bAckPolarity, bool bWaitForAck = true);
+      virtual void TransmitAbort(cec_logical_address initiator, cec_logical_address address, cec_opcode opcode, cec_abort_reason reason = CEC_ABORT_REASON_UNRECOGNIZED_OPCODE);
+      virtual void ReportCECVersion(cec_logical_address initiator, cec_logical_address address = CECDEVICE_TV);
+      virtual void ReportPowerState(cec_logical_address initiator, cec_logical_address address = CECDEVICE_TV, bool bOn = true);
+      virtual void ReportMenuState(cec_logical_address initiator, cec_logical_address address = CECDEVICE_TV, bool bActive = true);
+      virtual void ReportVendorID(cec_logical_address initiator, cec_logical_address address = CECDEVICE_TV);
+      virtual void ReportOSDName(cec_logical_address initiator, cec_logical_address address = CECDEVICE_TV);
+      virtual void ReportPhysicalAddress(cec_logical_address initiator);
       virtual void BroadcastActiveSource(void);
-      virtual uint8_t GetSourceDestination(cec_logical_address destination = CECDEVICE_BROADCAST) const;
 
     private:
-      bool WaitForAck(int iTimeout = 1000);
+      typedef bool (CCECProcessor::*BuiltinHandler)(const cec_command &command);
+
+      typedef struct CommandHandler
+      {
+        cec_command_handler handler;
+        void *              param;
+      } CommandHandler;
+
+      typedef struct LogicalDevice
+      {
+        bool            bActive;
+        char            strName[CEC_MAX_FRAME_SIZE - 1]; /*!< the OSD name. at most 14 characters, so it fits in a frame */
+        cec_device_type type;
+      } LogicalDevice;
+
+      void UpdateAckMask(void);
+      bool SendAckMask(void);
+      bool IsLogicalDevice(uint8_t iAddress);
+      LogicalDevice GetLogicalDevice(cec_logical_address iLogicalAddress);
+      static cec_device_type GetDeviceType(cec_logical_address iLogicalAddress);
+
+      bool IsValidFrame(const cec_message &message);
+      bool HandleCommand(const cec_command &command);
+      bool HandleGivePhysicalAddress(const cec_command &command);
+      bool HandleGiveOSDName(const cec_command &command);
+      bool HandleGiveDeviceVendorId(const cec_command &command);
+      bool HandleMenuRequest(const cec_command &command);
+      bool HandleGiveDevicePowerStatus(const cec_command &command);
+      bool HandleGetCECVersion(const cec_command &command);
+      bool HandleUserControlPressed(const cec_command &command);
+      bool HandleUserControlRelease(const cec_command &command);
+      bool HandleRequestActiveSource(const cec_command &command);
+      bool HandleSetStreamPath(const cec_command &command);
+
+      bool AllocateLogicalAddress(void);
+      void AddTransmittedFrames(unsigned int iFrames);
+      void AddReceivedFrame(void);
+      /*!
+       * @brief Format a frame as commands for the adapter, one command for every byte of the frame.
+       */
+      static void FormatFrame(const cec_message &message, uint8_t *output, unsigned int &iOutputSize);
+      bool WaitForAck(int iTimeout = 1000, ECecMessageCode iSuccessCode = MSGCODE_TRANSMIT_SUCCEEDED, uint8_t *iResult = NULL);
+      void TransmitQueued(void);
+      static bool IsAdapterReply(uint8_t iCode);
+      void AddPingResult(bool bSuccess, int64_t iRtt);
+      void CheckAdapterHealth(void);
+      bool Reconnect(void);
+      static uint64_t GetWaitTime(int64_t iTargetTimeUs, int64_t iNowUs, int iTimeout);
+      bool ProcessFrame(uint64_t iTimeout);
+      void ProcessTimers(void);
       bool ParseMessage(cec_frame &msg);
+      void AddToCurrentFrame(uint8_t iData);
       void ParseCurrentFrame(void);
+      void TraceReceivedFrame(void);
 
-      cec_frame                  m_currentframe;
+      cec_frame                  m_message;        /*!< the last message that was read from the adapter. reused to keep its capacity */
+      cec_command                m_currentCommand; /*!< the frame that is being received, built in place */
+      CommandHandler             m_handlers[256];        /*!< handlers registered by the application, by opcode */
+      BuiltinHandler             m_builtinHandlers[256]; /*!< libCEC's own replies, by opcode */
+      CMutex                     m_handlerMutex;
+      unsigned int               m_iCurrentFrameLength;
+      int64_t                    m_iFrameStartTime;  /*!< when the current frame started, only set while a trace is written */
+      int64_t                    m_iFrameEomTime;
+      int64_t                    m_iFrameParsedTime;
+      int64_t                    m_iTransmitAcceptedTime; /*!< when the adapter accepted the frame that is being transmitted, only set while a trace is written */
       uint16_t                   m_physicaladdress;
-      cec_logical_address        m_iLogicalAddress;
+      cec_logical_address        m_iLogicalAddress; /*!< the device that sends the frames that the application asks for */
+      LogicalDevice              m_devices[16];     /*!< all devices that are presented, by logical address */
+      uint16_t                   m_iAckMask;
+      bool                       m_bAllocateAddress;
+      CMutex                     m_devicesMutex;
       CecBuffer<cec_frame>       m_frameBuffer;
-      std::string                m_strDeviceName;
+      CecBuffer<QueuedTransmit>  m_transmitBuffer;   /*!< frames that were transmitted while reconnecting */
+      volatile uint32_t          m_iReconnecting;    /*!< 1 while reconnecting. read by the threads that transmit, so only used through the atomics */
+      int                        m_iPingFailures;
+      int64_t                    m_iNextHealthCheck;
+      int64_t                    m_iPingDeadline;      /*!< when the ping of the health check times out, 0 when no ping is pending */
+      int64_t                    m_iReconnectInterval;
+      CMutex                     m_healthMutex;
+      CAdapterReconnector        m_reconnector;
+      cec_statistics             m_statistics;
+      CMutex                     m_statisticsMutex;
+      bool                       m_bUseReactor;
+      CAdapterReactor           *m_reactor;
       CMutex                     m_mutex;
       CAdapterCommunication     *m_communication;
       CLibCEC                   *m_controller;
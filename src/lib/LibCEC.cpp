@@ -34,17 +34,38 @@
 
 #include "AdapterCommunication.h"
 #include "AdapterDetection.h"
+#include "AdapterManager.h"
 #include "CECProcessor.h"
+#include "TraceWriter.h"
+#include "platform/probes.h"
 #include "util/StdString.h"
 #include "platform/timeutils.h"
 
+#if !defined(__WINDOWS__)
+#include <sys/mman.h>
+#endif
+
+#define CEC_MAX_LOCK_STATISTICS 64
+
 using namespace std;
 using namespace CEC;
 
+CEC_PROBE_DEFINE_SEMAPHORES
+
 CLibCEC::CLibCEC(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */) :
     m_iCurrentButton(CEC_USER_CONTROL_CODE_UNKNOWN),
-    m_buttontime(0)
+    m_buttontime(0),
+    m_monitor(NULL),
+    m_manager(NULL),
+    m_iAdapterId(-1),
+    m_bTracing(false),
+    m_iLogLevel(CEC_LOG_DEBUG),
+    m_logBuffer("log-queue"),
+    m_keyBuffer("key-queue"),
+    m_commandBuffer("command-queue"),
+    m_eventBuffer("event-queue")
 {
+  memset(&m_monitorThreadConfig, 0, sizeof(m_monitorThreadConfig));
   m_comm = new CAdapterCommunication(this);
   m_cec = new CCECProcessor(this, m_comm, strDeviceName, iLogicalAddress, iPhysicalAddress);
 }
@@ -52,6 +73,12 @@ CLibCEC::CLibCEC(const char *strDeviceName, cec_logical_address iLogicalAddress
 CLibCEC::~CLibCEC(void)
 {
   Close();
+  if (m_bTracing)
+    StopTrace();
+
+  delete m_monitor;
+  m_monitor = NULL;
+
   delete m_cec;
   m_cec = NULL;
 
@@ -94,6 +121,8 @@ void CLibCEC::Close(void)
     m_cec->StopThread();
   if (m_comm)
     m_comm->Close();
+
+  LogLockStatistics();
 }
 
 int CLibCEC::FindAdapters(std::vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
@@ -105,12 +134,47 @@ int CLibCEC::FindAdapters(std::vector<cec_adapter> &deviceList, const char *strD
     strDebug.Format("trying to autodetect all CEC adapters");
   AddLog(CEC_LOG_DEBUG, strDebug);
 
+  if (m_monitor && m_monitor->IsRunning())
+    return m_monitor->GetAdapters(deviceList, strDevicePath);
+
   return CAdapterDetection::FindAdapters(deviceList, strDevicePath);
 }
 
+bool CLibCEC::UseSharedReactor(bool bEnable /* = true */)
+{
+  if (!m_comm || !m_cec || m_comm->IsOpen())
+    return false;
+
+  if (!m_comm->SetUseReactor(bEnable) || !m_cec->SetUseReactor(bEnable))
+  {
+    AddLog(CEC_LOG_ERROR, "could not change the reactor mode");
+    return false;
+  }
+
+  return true;
+}
+
+bool CLibCEC::EnableAdapterMonitor(bool bEnable /* = true */)
+{
+  if (!bEnable)
+  {
+    delete m_monitor;
+    m_monitor = NULL;
+    return true;
+  }
+
+  if (!m_monitor)
+  {
+    m_monitor = new CAdapterMonitor(this);
+    m_monitor->SetThreadConfig(m_monitorThreadConfig);
+  }
+
+  return m_monitor->Start();
+}
+
 bool CLibCEC::PingAdapter(void)
 {
-  return m_comm ? m_comm->PingAdapter() : false;
+  return m_cec ? m_cec->PingAdapter() : false;
 }
 
 bool CLibCEC::StartBootloader(void)
@@ -118,6 +182,11 @@ bool CLibCEC::StartBootloader(void)
   return m_comm ? m_comm->StartBootloader() : false;
 }
 
+uint16_t CLibCEC::GetFirmwareVersion(void)
+{
+  return m_comm ? m_comm->GetFirmwareVersion() : CEC_FIRMWARE_VERSION_UNKNOWN;
+}
+
 int CLibCEC::GetMinVersion(void)
 {
   return CEC_MIN_VERSION;
@@ -140,7 +209,175 @@ bool CLibCEC::GetNextKeypress(cec_keypress *key)
 
 bool CLibCEC::GetNextCommand(cec_command *command)
 {
-  return m_commandBuffer.Pop(*command);
+  if (!m_commandBuffer.Pop(*command))
+    return false;
+
+  CEC_PROBE5(command_dequeued, command->source, command->destination, command->opcode, m_iAdapterId, GetTimeUs());
+  return true;
+}
+
+bool CLibCEC::GetNextAdapterEvent(cec_adapter_event *event)
+{
+  return m_eventBuffer.Pop(*event);
+}
+
+unsigned int CLibCEC::GetNextLogMessages(cec_log_message *messages, unsigned int iMaxMessages)
+{
+  return messages ? m_logBuffer.Pop(messages, iMaxMessages) : 0;
+}
+
+unsigned int CLibCEC::GetNextKeypresses(cec_keypress *keys, unsigned int iMaxKeys)
+{
+  return keys ? m_keyBuffer.Pop(keys, iMaxKeys) : 0;
+}
+
+unsigned int CLibCEC::GetNextCommands(cec_command *commands, unsigned int iMaxCommands)
+{
+  unsigned int iCommands = commands ? m_commandBuffer.Pop(commands, iMaxCommands) : 0;
+  if (CEC_PROBE_ENABLED(command_dequeued))
+  {
+    for (unsigned int iPtr = 0; iPtr < iCommands; iPtr++)
+      CEC_PROBE5(command_dequeued, commands[iPtr].source, commands[iPtr].destination, commands[iPtr].opcode, m_iAdapterId, GetTimeUs());
+  }
+  return iCommands;
+}
+
+bool CLibCEC::GetStatistics(cec_statistics *statistics)
+{
+  return m_cec ? m_cec->GetStatistics(statistics) : false;
+}
+
+bool CLibCEC::SetQueueConfig(cec_queue queue, const cec_queue_config &config)
+{
+  switch (queue)
+  {
+  case CEC_QUEUE_LOG:
+    m_logBuffer.SetConfig(config);
+    return true;
+  case CEC_QUEUE_KEYPRESS:
+    m_keyBuffer.SetConfig(config);
+    return true;
+  case CEC_QUEUE_COMMAND:
+    m_commandBuffer.SetConfig(config);
+    return true;
+  case CEC_QUEUE_ADAPTER_EVENT:
+    m_eventBuffer.SetConfig(config);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool CLibCEC::GetQueueStatistics(cec_queue queue, cec_queue_statistics *statistics)
+{
+  if (!statistics)
+    return false;
+
+  switch (queue)
+  {
+  case CEC_QUEUE_LOG:
+    m_logBuffer.GetStatistics(*statistics);
+    return true;
+  case CEC_QUEUE_KEYPRESS:
+    m_keyBuffer.GetStatistics(*statistics);
+    return true;
+  case CEC_QUEUE_COMMAND:
+    m_commandBuffer.GetStatistics(*statistics);
+    return true;
+  case CEC_QUEUE_ADAPTER_EVENT:
+    m_eventBuffer.GetStatistics(*statistics);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool CLibCEC::SetThreadConfig(cec_thread thread, const cec_thread_config &config)
+{
+  switch (thread)
+  {
+  case CEC_THREAD_READER:
+    return m_comm ? m_comm->SetThreadConfig(config) : false;
+  case CEC_THREAD_PROCESSOR:
+    return m_cec ? m_cec->SetThreadConfig(config) : false;
+  case CEC_THREAD_MONITOR:
+    m_monitorThreadConfig = config;
+    return m_monitor ? m_monitor->SetThreadConfig(config) : CThread::IsValidThreadConfig(config);
+  default:
+    return false;
+  }
+}
+
+bool CLibCEC::LockMemory(bool bLock /* = true */)
+{
+#if !defined(__WINDOWS__)
+  if ((bLock ? mlockall(MCL_CURRENT | MCL_FUTURE) : munlockall()) != 0)
+  {
+    CStdString strError;
+    strError.Format("could not %s the memory of the process: %s", bLock ? "lock" : "unlock", strerror(errno));
+    AddLog(CEC_LOG_ERROR, strError);
+    return false;
+  }
+
+  AddLog(CEC_LOG_DEBUG, bLock ? "memory locked" : "memory unlocked");
+  return true;
+#else
+  (void) bLock;
+  AddLog(CEC_LOG_ERROR, "locking the memory of the process is not supported on this platform");
+  return false;
+#endif
+}
+
+unsigned int CLibCEC::GetLockStatistics(cec_lock_statistics *statistics, unsigned int iMaxLocks)
+{
+  return CMutex::GetStatistics(statistics, iMaxLocks);
+}
+
+bool CLibCEC::StartTrace(const char *strFile)
+{
+  if (!CTraceWriter::Start(strFile))
+  {
+    CStdString strError;
+    strError.Format("could not start writing a trace to '%s'", strFile ? strFile : "");
+    AddLog(CEC_LOG_ERROR, strError);
+    return false;
+  }
+
+  m_bTracing = true;
+  CStdString strLog;
+  strLog.Format("writing a trace to '%s'", strFile);
+  AddLog(CEC_LOG_NOTICE, strLog);
+  return true;
+}
+
+bool CLibCEC::StopTrace(void)
+{
+  m_bTracing = false;
+  return CTraceWriter::Stop();
+}
+
+void CLibCEC::LogLockStatistics(void)
+{
+  cec_lock_statistics statistics[CEC_MAX_LOCK_STATISTICS];
+  unsigned int iLocks = CMutex::GetStatistics(statistics, CEC_MAX_LOCK_STATISTICS);
+  for (unsigned int iPtr = 0; iPtr < iLocks; iPtr++)
+  {
+    const cec_lock_statistics &lock = statistics[iPtr];
+    if (lock.acquisitions == 0)
+      continue;
+
+    CStdString strLog;
+    strLog.Format("lock '%s': %llu acquisitions, %llu contended, wait avg %llu us max %llu us, hold avg %llu us max %llu us", lock.name,
+        (unsigned long long) lock.acquisitions, (unsigned long long) lock.contended,
+        (unsigned long long) (lock.contended > 0 ? lock.wait_time_total / lock.contended : 0), (unsigned long long) lock.wait_time_max,
+        (unsigned long long) (lock.hold_time_total / lock.acquisitions), (unsigned long long) lock.hold_time_max);
+    AddLog(CEC_LOG_NOTICE, strLog);
+  }
+}
+
+bool CLibCEC::SetCommandHandler(cec_opcode opcode, cec_command_handler handler, void *param /* = NULL */)
+{
+  return m_cec ? m_cec->SetCommandHandler(opcode, handler, param) : false;
 }
 
 bool CLibCEC::Transmit(const cec_frame &data, bool bWaitForAck /* = true */)
@@ -148,11 +385,34 @@ bool CLibCEC::Transmit(const cec_frame &data, bool bWaitForAck /* = true */)
   return m_cec ? m_cec->Transmit(data, bWaitForAck) : false;
 }
 
+bool CLibCEC::Transmit(const cec_message &message, bool bWaitForAck /* = true */)
+{
+  return m_cec ? m_cec->Transmit(message, bWaitForAck) : false;
+}
+
 bool CLibCEC::SetLogicalAddress(cec_logical_address iLogicalAddress)
 {
   return m_cec ? m_cec->SetLogicalAddress(iLogicalAddress) : false;
 }
 
+bool CLibCEC::SetDeviceType(cec_device_type type)
+{
+  if (!m_cec || (m_comm && m_comm->IsOpen()))
+    return false;
+
+  return m_cec->SetDeviceType(type);
+}
+
+bool CLibCEC::AddLogicalDevice(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type)
+{
+  return m_cec ? m_cec->AddLogicalDevice(iLogicalAddress, strDeviceName, type) : false;
+}
+
+bool CLibCEC::RemoveLogicalDevice(cec_logical_address iLogicalAddress)
+{
+  return m_cec ? m_cec->RemoveLogicalDevice(iLogicalAddress) : false;
+}
+
 bool CLibCEC::PowerOnDevices(cec_logical_address address /* = CECDEVICE_TV */)
 {
   return m_cec ? m_cec->PowerOnDevices(address) : false;
@@ -175,10 +435,32 @@ bool CLibCEC::SetInactiveView(void)
 
 void CLibCEC::AddLog(cec_log_level level, const string &strMessage)
 {
-  cec_log_message message;
-  message.level = level;
-  message.message.assign(strMessage.c_str());
-  m_logBuffer.Push(message);
+  AddLog(level, strMessage.c_str());
+}
+
+void CLibCEC::SetLogLevel(cec_log_level level)
+{
+  AtomicStore(&m_iLogLevel, (uint32_t) level);
+}
+
+bool CLibCEC::IsLogging(cec_log_level level)
+{
+  //a message that a full log queue would drop isn't formatted either. the drop is counted by AddLog()
+  return (uint32_t) level >= AtomicLoad(&m_iLogLevel) && !m_logBuffer.IsFull();
+}
+
+void CLibCEC::AddLog(cec_log_level level, const char *strMessage)
+{
+  if ((uint32_t) level < AtomicLoad(&m_iLogLevel))
+    return;
+
+  //don't copy a message that would be dropped, so logging doesn't allocate when the application doesn't read the log
+  if (m_logBuffer.DropWhenFull())
+    return;
+
+  //the message is copied into the string of the slot, which has the storage of a message that the application popped
+  CecLogLine line = { level, strMessage };
+  m_logBuffer.PushFrom(line);
 }
 
 void CLibCEC::AddKey(void)
@@ -186,37 +468,63 @@ void CLibCEC::AddKey(void)
   if (m_iCurrentButton != CEC_USER_CONTROL_CODE_UNKNOWN)
   {
     cec_keypress key;
-    key.duration = (unsigned int) (GetTimeMs() - m_buttontime);
+    key.duration = (unsigned int) ((GetTimeUs() - m_buttontime) / (int64_t)1000);
     key.keycode = m_iCurrentButton;
-    m_keyBuffer.Push(key);
+    CEC_PROBE3(keypress, key.keycode, key.duration, GetTimeUs());
+    if (m_manager)
+    {
+      if (!m_manager->AddKey(m_iAdapterId, key))
+        AddLog(CEC_LOG_WARNING, "event buffer is full");
+    }
+    else if (!m_keyBuffer.PushMove(key))
+      AddLog(CEC_LOG_WARNING, "keypress buffer is full");
     m_iCurrentButton = CEC_USER_CONTROL_CODE_UNKNOWN;
     m_buttontime = 0;
   }
 }
 
-void CLibCEC::AddCommand(cec_logical_address source, cec_logical_address destination, cec_opcode opcode, cec_frame *parameters)
+void CLibCEC::AddCommand(cec_command &command)
 {
-  cec_command command;
-  command.source       = source;
-  command.destination  = destination;
-  command.opcode       = opcode;
-  if (parameters)
-    command.parameters = *parameters;
-  if (m_commandBuffer.Push(command))
+  //the command is moved to the queue, so the probe reports what was queued before pushing it
+  CEC_PROBE5(command_queued, command.source, command.destination, command.opcode, m_iAdapterId, GetTimeUs());
+
+  if (m_manager)
+  {
+    if (!m_manager->AddCommand(m_iAdapterId, command))
+      AddLog(CEC_LOG_WARNING, "event buffer is full");
+    return;
+  }
+
+  cec_opcode opcode = command.opcode;
+  if (!m_commandBuffer.PushMove(command))
+  {
+    AddLog(CEC_LOG_WARNING, "command buffer is full");
+  }
+  else if (IsLogging(CEC_LOG_DEBUG))
   {
     CStdString strDebug;
     strDebug.Format("stored command '%d' in the command buffer. buffer size = %d", opcode, m_commandBuffer.Size());
     AddLog(CEC_LOG_DEBUG, strDebug);
   }
-  else
+}
+
+void CLibCEC::AddAdapterEvent(cec_adapter_event_type type, const cec_adapter &adapter)
+{
+  cec_adapter_event event;
+  event.type    = type;
+  event.adapter = adapter;
+  if (m_manager)
   {
-    AddLog(CEC_LOG_WARNING, "command buffer is full");
+    if (!m_manager->AddAdapterEvent(m_iAdapterId, event))
+      AddLog(CEC_LOG_WARNING, "event buffer is full");
   }
+  else if (!m_eventBuffer.PushMove(event))
+    AddLog(CEC_LOG_WARNING, "adapter event buffer is full");
 }
 
 void CLibCEC::CheckKeypressTimeout(void)
 {
-  if (m_iCurrentButton != CEC_USER_CONTROL_CODE_UNKNOWN && GetTimeMs() - m_buttontime > CEC_BUTTON_TIMEOUT)
+  if (m_iCurrentButton != CEC_USER_CONTROL_CODE_UNKNOWN && GetTimeUs() - m_buttontime > (int64_t)CEC_BUTTON_TIMEOUT * (int64_t)1000)
   {
     AddKey();
     m_iCurrentButton = CEC_USER_CONTROL_CODE_UNKNOWN;
@@ -226,7 +534,13 @@ void CLibCEC::CheckKeypressTimeout(void)
 void CLibCEC::SetCurrentButton(cec_user_control_code iButtonCode)
 {
   m_iCurrentButton = iButtonCode;
-  m_buttontime = GetTimeMs();
+  m_buttontime = GetTimeUs();
+}
+
+void CLibCEC::SetManager(CAdapterManager *manager, int iAdapterId)
+{
+  m_manager    = manager;
+  m_iAdapterId = iAdapterId;
 }
 
 DECLSPEC void * CECCreate(const char *strDeviceName, CEC::cec_logical_address iLogicalAddress /*= CEC::CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
@@ -37,7 +37,103 @@
 
 namespace CEC
 {
+  /*!
+   * @brief A log line that is stored in a slot of the log buffer without building a cec_log_message first, so the
+   * message reuses the storage of the slot.
+   */
+  typedef struct CecLogLine
+  {
+    cec_log_level level;
+    const char *  message;
+  } CecLogLine;
+
+  /* sequence numbers and coalescing for the entries of the buffers in libCEC */
+  inline void CecBufferSetSequence(cec_log_message &entry, uint32_t iSequence)   { entry.sequence = iSequence; }
+  inline void CecBufferSetSequence(cec_keypress &entry, uint32_t iSequence)      { entry.sequence = iSequence; }
+  inline void CecBufferSetSequence(cec_command &entry, uint32_t iSequence)       { entry.sequence = iSequence; }
+  inline void CecBufferSetSequence(cec_adapter_event &entry, uint32_t iSequence) { entry.sequence = iSequence; }
+  inline void CecBufferSetSequence(cec_event &entry, uint32_t iSequence)         { entry.sequence = iSequence; }
+
+  inline bool CecBufferEquals(const cec_log_message &a, const cec_log_message &b)
+  {
+    return a.level == b.level && a.message == b.message;
+  }
+
+  inline bool CecBufferEquals(const cec_log_message &a, const CecLogLine &b)
+  {
+    return a.level == b.level && a.message == b.message;
+  }
+
+  inline bool CecBufferEquals(const cec_keypress &a, const cec_keypress &b)
+  {
+    return a.keycode == b.keycode && a.duration == b.duration;
+  }
+
+  inline bool CecBufferEquals(const cec_command &a, const cec_command &b)
+  {
+    return a.source == b.source && a.destination == b.destination && a.opcode == b.opcode && a.parameters == b.parameters;
+  }
+
+  inline bool CecBufferEquals(const cec_adapter_event &a, const cec_adapter_event &b)
+  {
+    return a.type == b.type && a.adapter.path == b.adapter.path && a.adapter.comm == b.adapter.comm;
+  }
+
+  inline bool CecBufferEquals(const cec_event &a, const cec_event &b)
+  {
+    if (a.type != b.type || a.adapter_id != b.adapter_id)
+      return false;
+    if (a.type == CEC_EVENT_KEYPRESS)
+      return CecBufferEquals(a.keypress, b.keypress);
+    if (a.type == CEC_EVENT_COMMAND)
+      return CecBufferEquals(a.command, b.command);
+    return CecBufferEquals(a.adapter_event, b.adapter_event);
+  }
+
+  /* moves that recycle the storage of the containers in the entries of the buffers in libCEC */
+  inline void CecBufferMove(cec_log_message &dst, cec_log_message &src)
+  {
+    dst.message.swap(src.message);
+    dst.level    = src.level;
+    dst.sequence = src.sequence;
+  }
+
+  inline void CecBufferStore(cec_log_message &dst, const CecLogLine &src)
+  {
+    dst.message.assign(src.message);
+    dst.level = src.level;
+  }
+
+  inline void CecBufferMove(cec_command &dst, cec_command &src)
+  {
+    dst.source      = src.source;
+    dst.destination = src.destination;
+    dst.opcode      = src.opcode;
+    dst.sequence    = src.sequence;
+    dst.parameters.swap(src.parameters);
+  }
+
+  inline void CecBufferMove(cec_adapter_event &dst, cec_adapter_event &src)
+  {
+    dst.type     = src.type;
+    dst.sequence = src.sequence;
+    dst.adapter.path.swap(src.adapter.path);
+    dst.adapter.comm.swap(src.adapter.comm);
+  }
+
+  inline void CecBufferMove(cec_event &dst, cec_event &src)
+  {
+    dst.type       = src.type;
+    dst.adapter_id = src.adapter_id;
+    dst.keypress   = src.keypress;
+    dst.sequence   = src.sequence;
+    CecBufferMove(dst.command, src.command);
+    CecBufferMove(dst.adapter_event, src.adapter_event);
+  }
+
   class CAdapterCommunication;
+  class CAdapterManager;
+  class CAdapterMonitor;
   class CCECProcessor;
 
   class CLibCEC : public ICECAdapter
@@ -53,8 +149,11 @@ namespace CEC
       virtual bool Open(const char *strPort, uint64_t iTimeout = 10000);
       virtual void Close(void);
       virtual int  FindAdapters(std::vector<cec_adapter> &deviceList, const char *strDevicePath = NULL);
+      virtual bool EnableAdapterMonitor(bool bEnable = true);
+      virtual bool UseSharedReactor(bool bEnable = true);
       virtual bool PingAdapter(void);
       virtual bool StartBootloader(void);
+      virtual uint16_t GetFirmwareVersion(void);
 
       virtual int  GetMinVersion(void);
       virtual int  GetLibVersion(void);
@@ -62,9 +161,27 @@ namespace CEC
       virtual bool GetNextLogMessage(cec_log_message *message);
       virtual bool GetNextKeypress(cec_keypress *key);
       virtual bool GetNextCommand(cec_command *command);
+      virtual bool GetNextAdapterEvent(cec_adapter_event *event);
+      virtual unsigned int GetNextLogMessages(cec_log_message *messages, unsigned int iMaxMessages);
+      virtual void SetLogLevel(cec_log_level level);
+      virtual unsigned int GetNextKeypresses(cec_keypress *keys, unsigned int iMaxKeys);
+      virtual unsigned int GetNextCommands(cec_command *commands, unsigned int iMaxCommands);
+      virtual bool GetStatistics(cec_statistics *statistics);
+      virtual bool SetQueueConfig(cec_queue queue, const cec_queue_config &config);
+      virtual bool GetQueueStatistics(cec_queue queue, cec_queue_statistics *statistics);
+      virtual bool SetThreadConfig(cec_thread thread, const cec_thread_config &config);
+      virtual bool LockMemory(bool bLock = true);
+      virtual unsigned int GetLockStatistics(cec_lock_statistics *statistics, unsigned int iMaxLocks);
+      virtual bool StartTrace(const char *strFile);
+      virtual bool StopTrace(void);
 
+      virtual bool SetCommandHandler(cec_opcode opcode, cec_command_handler handler, void *param = NULL);
       virtual bool Transmit(const cec_frame &data, bool bWaitForAck = true);
+      virtual bool Transmit(const cec_message &message, bool bWaitForAck = true);
       virtual bool SetLogicalAddress(cec_logical_address iLogicalAddress);
+      virtual bool SetDeviceType(cec_device_type type);
+      virtual bool AddLogicalDevice(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type);
+      virtual bool RemoveLogicalDevice(cec_logical_address iLogicalAddress);
 
       virtual bool PowerOnDevices(cec_logical_address address = CECDEVICE_TV);
       virtual bool StandbyDevices(cec_logical_address address = CECDEVICE_BROADCAST);
@@ -73,18 +190,37 @@ namespace CEC
     //@}
 
       virtual void AddLog(cec_log_level level, const std::string &strMessage);
+      virtual void AddLog(cec_log_level level, const char *strMessage);
+      /*!
+       * @brief Check whether a message with this level would be logged, before formatting it on a hot path.
+       *        Doesn't count a message as dropped, AddLog() does that.
+       */
+      virtual bool IsLogging(cec_log_level level);
       virtual void AddKey(void);
-      virtual void AddCommand(cec_logical_address source, cec_logical_address destination, cec_opcode opcode, cec_frame *parameters);
+      /*!
+       * @brief Queue a received command for the application. The command is moved into the queue, not copied.
+       */
+      virtual void AddCommand(cec_command &command);
+      virtual void AddAdapterEvent(cec_adapter_event_type type, const cec_adapter &adapter);
       virtual void CheckKeypressTimeout(void);
       virtual void SetCurrentButton(cec_user_control_code iButtonCode);
+      virtual void SetManager(CAdapterManager *manager, int iAdapterId);
+      virtual void LogLockStatistics(void);
 
     protected:
       cec_user_control_code      m_iCurrentButton;
-      int64_t                    m_buttontime;
+      int64_t                    m_buttontime; /*!< in microseconds */
       CCECProcessor             *m_cec;
       CAdapterCommunication     *m_comm;
+      CAdapterMonitor           *m_monitor;
+      cec_thread_config          m_monitorThreadConfig;
+      CAdapterManager           *m_manager;
+      int                        m_iAdapterId;
+      bool                       m_bTracing; /*!< true when this instance started the trace that is being written */
+      volatile uint32_t          m_iLogLevel; /*!< the lowest cec_log_level that is logged */
       CecBuffer<cec_log_message> m_logBuffer;
       CecBuffer<cec_keypress>    m_keyBuffer;
       CecBuffer<cec_command>     m_commandBuffer;
+      CecBuffer<cec_adapter_event> m_eventBuffer;
   };
 };
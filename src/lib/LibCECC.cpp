@@ -39,130 +39,621 @@ using namespace std;
  * C interface implementation
  */
 //@{
-ICECAdapter *cec_parser;
+cec_handle_t cec_parser;
 
-bool cec_init(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint8_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
+bool cec_init(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
 {
-  cec_parser = (ICECAdapter *) CECCreate(strDeviceName, iLogicalAddress, iPhysicalAddress);
+  cec_parser = libcec_create(strDeviceName, iLogicalAddress, iPhysicalAddress);
   return (cec_parser != NULL);
 }
 
 void cec_destroy(void)
 {
-  cec_close();
-  delete cec_parser;
+  libcec_destroy(cec_parser);
   cec_parser = NULL;
 }
 
 bool cec_open(const char *strPort, uint64_t iTimeout)
 {
-  if (cec_parser)
-    return cec_parser->Open(strPort, iTimeout);
-  return false;
+  return libcec_open(cec_parser, strPort, iTimeout);
 }
 
 void cec_close(void)
 {
-  if (cec_parser)
-    cec_parser->Close();
+  libcec_close(cec_parser);
 }
 
 int cec_find_adapters(vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
 {
-  if (cec_parser)
-    return cec_parser->FindAdapters(deviceList, strDevicePath);
-  return -1;
+  return libcec_find_adapters(cec_parser, deviceList, strDevicePath);
+}
+
+bool cec_use_shared_reactor(bool bEnable /* = true */)
+{
+  return libcec_use_shared_reactor(cec_parser, bEnable);
+}
+
+bool cec_enable_adapter_monitor(bool bEnable /* = true */)
+{
+  return libcec_enable_adapter_monitor(cec_parser, bEnable);
 }
 
 bool cec_ping_adapters(void)
 {
-  if (cec_parser)
-    return cec_parser->PingAdapter();
-  return false;
+  return libcec_ping_adapters(cec_parser);
 }
 
 bool cec_start_bootloader(void)
 {
-  if (cec_parser)
-    return cec_parser->StartBootloader();
-  return false;
+  return libcec_start_bootloader(cec_parser);
+}
+
+uint16_t cec_get_firmware_version(void)
+{
+  return libcec_get_firmware_version(cec_parser);
 }
 
 int cec_get_min_version(void)
 {
-  if (cec_parser)
-    return cec_parser->GetMinVersion();
-  return -1;
+  return libcec_get_min_version(cec_parser);
 }
 
 int cec_get_lib_version(void)
 {
-  if (cec_parser)
-    return cec_parser->GetLibVersion();
-  return -1;
+  return libcec_get_lib_version(cec_parser);
+}
+
+bool cec_power_on_devices(cec_logical_address address /* = CECDEVICE_TV */)
+{
+  return libcec_power_on_devices(cec_parser, address);
+}
+
+bool cec_standby_devices(cec_logical_address address /* = CECDEVICE_BROADCAST */)
+{
+  return libcec_standby_devices(cec_parser, address);
+}
+
+bool cec_set_active_view(void)
+{
+  return libcec_set_active_view(cec_parser);
+}
+
+bool cec_set_inactive_view(void)
+{
+  return libcec_set_inactive_view(cec_parser);
 }
 
 bool cec_get_next_log_message(cec_log_message *message)
 {
-  if (cec_parser)
-    return cec_parser->GetNextLogMessage(message);
-  return false;
+  return libcec_get_next_log_message(cec_parser, message);
 }
 
 bool cec_get_next_keypress(cec_keypress *key)
 {
-  if (cec_parser)
-    return cec_parser->GetNextKeypress(key);
-  return false;
+  return libcec_get_next_keypress(cec_parser, key);
 }
 
 bool cec_get_next_command(cec_command *command)
 {
-  if (cec_parser)
-    return cec_parser->GetNextCommand(command);
+  return libcec_get_next_command(cec_parser, command);
+}
+
+bool cec_get_next_adapter_event(cec_adapter_event *event)
+{
+  return libcec_get_next_adapter_event(cec_parser, event);
+}
+
+unsigned int cec_get_next_log_messages(cec_log_message *messages, unsigned int iMaxMessages)
+{
+  return libcec_get_next_log_messages(cec_parser, messages, iMaxMessages);
+}
+
+void cec_set_log_level(cec_log_level level)
+{
+  libcec_set_log_level(cec_parser, level);
+}
+
+unsigned int cec_get_next_keypresses(cec_keypress *keys, unsigned int iMaxKeys)
+{
+  return libcec_get_next_keypresses(cec_parser, keys, iMaxKeys);
+}
+
+unsigned int cec_get_next_commands(cec_command *commands, unsigned int iMaxCommands)
+{
+  return libcec_get_next_commands(cec_parser, commands, iMaxCommands);
+}
+
+bool cec_get_statistics(cec_statistics *statistics)
+{
+  return libcec_get_statistics(cec_parser, statistics);
+}
+
+bool cec_set_queue_config(cec_queue queue, const cec_queue_config *config)
+{
+  return libcec_set_queue_config(cec_parser, queue, config);
+}
+
+bool cec_get_queue_statistics(cec_queue queue, cec_queue_statistics *statistics)
+{
+  return libcec_get_queue_statistics(cec_parser, queue, statistics);
+}
+
+bool cec_set_thread_config(cec_thread thread, const cec_thread_config *config)
+{
+  return libcec_set_thread_config(cec_parser, thread, config);
+}
+
+bool cec_lock_memory(bool bLock)
+{
+  return libcec_lock_memory(cec_parser, bLock);
+}
+
+unsigned int cec_get_lock_statistics(cec_lock_statistics *statistics, unsigned int iMaxLocks)
+{
+  return libcec_get_lock_statistics(cec_parser, statistics, iMaxLocks);
+}
+
+bool cec_start_trace(const char *strFile)
+{
+  return libcec_start_trace(cec_parser, strFile);
+}
+
+bool cec_stop_trace(void)
+{
+  return libcec_stop_trace(cec_parser);
+}
+
+bool cec_set_command_handler(cec_opcode opcode, cec_command_handler handler, void *param)
+{
+  return libcec_set_command_handler(cec_parser, opcode, handler, param);
+}
+
+bool cec_transmit(const cec_frame &data, bool bWaitForAck /* = true */)
+{
+  return libcec_transmit(cec_parser, data, bWaitForAck);
+}
+
+bool cec_transmit_message(const cec_message *message, bool bWaitForAck /* = true */)
+{
+  return libcec_transmit_message(cec_parser, message, bWaitForAck);
+}
+
+bool cec_set_logical_address(cec_logical_address iLogicalAddress)
+{
+  return libcec_set_logical_address(cec_parser, iLogicalAddress);
+}
+
+bool cec_set_device_type(cec_device_type type)
+{
+  return libcec_set_device_type(cec_parser, type);
+}
+
+bool cec_add_logical_device(cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type)
+{
+  return libcec_add_logical_device(cec_parser, iLogicalAddress, strDeviceName, type);
+}
+
+bool cec_remove_logical_device(cec_logical_address iLogicalAddress)
+{
+  return libcec_remove_logical_device(cec_parser, iLogicalAddress);
+}
+
+cec_handle_t libcec_create(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
+{
+  return (cec_handle_t) CECCreate(strDeviceName, iLogicalAddress, iPhysicalAddress);
+}
+
+void libcec_destroy(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+  {
+    adapter->Close();
+    delete (CLibCEC *) adapter;
+  }
+}
+
+bool libcec_open(cec_handle_t handle, const char *strPort, uint64_t iTimeout)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->Open(strPort, iTimeout);
   return false;
 }
 
-bool cec_transmit(const CEC::cec_frame &data, bool bWaitForAck /* = true */)
+void libcec_close(cec_handle_t handle)
 {
-  if (cec_parser)
-    return cec_parser->Transmit(data, bWaitForAck);
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    adapter->Close();
+}
+
+int libcec_find_adapters(cec_handle_t handle, vector<cec_adapter> &deviceList, const char *strDevicePath /* = NULL */)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->FindAdapters(deviceList, strDevicePath);
+  return -1;
+}
+
+bool libcec_use_shared_reactor(cec_handle_t handle, bool bEnable /* = true */)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->UseSharedReactor(bEnable);
   return false;
 }
 
-bool cec_set_logical_address(cec_logical_address iLogicalAddress)
+bool libcec_enable_adapter_monitor(cec_handle_t handle, bool bEnable /* = true */)
 {
-  if (cec_parser)
-    return cec_parser->SetLogicalAddress(iLogicalAddress);
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->EnableAdapterMonitor(bEnable);
   return false;
 }
 
-bool cec_power_on_devices(cec_logical_address address /* = CECDEVICE_TV */)
+bool libcec_ping_adapters(cec_handle_t handle)
 {
-  if (cec_parser)
-    return cec_parser->PowerOnDevices(address);
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->PingAdapter();
   return false;
 }
 
-bool cec_standby_devices(cec_logical_address address /* = CECDEVICE_BROADCAST */)
+bool libcec_start_bootloader(cec_handle_t handle)
 {
-  if (cec_parser)
-    return cec_parser->StandbyDevices(address);
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->StartBootloader();
   return false;
 }
 
-bool cec_set_active_view(void)
+uint16_t libcec_get_firmware_version(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetFirmwareVersion();
+  return CEC_FIRMWARE_VERSION_UNKNOWN;
+}
+
+int libcec_get_min_version(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetMinVersion();
+  return -1;
+}
+
+int libcec_get_lib_version(cec_handle_t handle)
 {
-  if (cec_parser)
-    return cec_parser->SetActiveView();
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetLibVersion();
+  return -1;
+}
+
+bool libcec_power_on_devices(cec_handle_t handle, cec_logical_address address /* = CECDEVICE_TV */)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->PowerOnDevices(address);
   return false;
 }
 
-bool cec_set_inactive_view(void)
+bool libcec_standby_devices(cec_handle_t handle, cec_logical_address address /* = CECDEVICE_BROADCAST */)
 {
-  if (cec_parser)
-    return cec_parser->SetInactiveView();
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->StandbyDevices(address);
   return false;
 }
 
+bool libcec_set_active_view(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->SetActiveView();
+  return false;
+}
+
+bool libcec_set_inactive_view(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->SetInactiveView();
+  return false;
+}
+
+bool libcec_get_next_log_message(cec_handle_t handle, cec_log_message *message)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextLogMessage(message);
+  return false;
+}
+
+bool libcec_get_next_keypress(cec_handle_t handle, cec_keypress *key)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextKeypress(key);
+  return false;
+}
+
+bool libcec_get_next_command(cec_handle_t handle, cec_command *command)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextCommand(command);
+  return false;
+}
+
+bool libcec_get_next_adapter_event(cec_handle_t handle, cec_adapter_event *event)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextAdapterEvent(event);
+  return false;
+}
+
+unsigned int libcec_get_next_log_messages(cec_handle_t handle, cec_log_message *messages, unsigned int iMaxMessages)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextLogMessages(messages, iMaxMessages);
+  return 0;
+}
+
+void libcec_set_log_level(cec_handle_t handle, cec_log_level level)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    adapter->SetLogLevel(level);
+}
+
+unsigned int libcec_get_next_keypresses(cec_handle_t handle, cec_keypress *keys, unsigned int iMaxKeys)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextKeypresses(keys, iMaxKeys);
+  return 0;
+}
+
+unsigned int libcec_get_next_commands(cec_handle_t handle, cec_command *commands, unsigned int iMaxCommands)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetNextCommands(commands, iMaxCommands);
+  return 0;
+}
+
+bool libcec_get_statistics(cec_handle_t handle, cec_statistics *statistics)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetStatistics(statistics);
+  return false;
+}
+
+bool libcec_set_queue_config(cec_handle_t handle, cec_queue queue, const cec_queue_config *config)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter && config)
+    return adapter->SetQueueConfig(queue, *config);
+  return false;
+}
+
+bool libcec_get_queue_statistics(cec_handle_t handle, cec_queue queue, cec_queue_statistics *statistics)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetQueueStatistics(queue, statistics);
+  return false;
+}
+
+bool libcec_set_thread_config(cec_handle_t handle, cec_thread thread, const cec_thread_config *config)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter && config)
+    return adapter->SetThreadConfig(thread, *config);
+  return false;
+}
+
+bool libcec_lock_memory(cec_handle_t handle, bool bLock)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->LockMemory(bLock);
+  return false;
+}
+
+unsigned int libcec_get_lock_statistics(cec_handle_t handle, cec_lock_statistics *statistics, unsigned int iMaxLocks)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->GetLockStatistics(statistics, iMaxLocks);
+  return 0;
+}
+
+bool libcec_start_trace(cec_handle_t handle, const char *strFile)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->StartTrace(strFile);
+  return false;
+}
+
+bool libcec_stop_trace(cec_handle_t handle)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->StopTrace();
+  return false;
+}
+
+bool libcec_set_command_handler(cec_handle_t handle, cec_opcode opcode, cec_command_handler handler, void *param)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->SetCommandHandler(opcode, handler, param);
+  return false;
+}
+
+bool libcec_transmit(cec_handle_t handle, const cec_frame &data, bool bWaitForAck /* = true */)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->Transmit(data, bWaitForAck);
+  return false;
+}
+
+bool libcec_transmit_message(cec_handle_t handle, const cec_message *message, bool bWaitForAck /* = true */)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter && message)
+    return adapter->Transmit(*message, bWaitForAck);
+  return false;
+}
+
+bool libcec_set_logical_address(cec_handle_t handle, cec_logical_address iLogicalAddress)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->SetLogicalAddress(iLogicalAddress);
+  return false;
+}
+
+bool libcec_set_device_type(cec_handle_t handle, cec_device_type type)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->SetDeviceType(type);
+  return false;
+}
+
+bool libcec_add_logical_device(cec_handle_t handle, cec_logical_address iLogicalAddress, const char *strDeviceName, cec_device_type type)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->AddLogicalDevice(iLogicalAddress, strDeviceName, type);
+  return false;
+}
+
+bool libcec_remove_logical_device(cec_handle_t handle, cec_logical_address iLogicalAddress)
+{
+  ICECAdapter *adapter = (ICECAdapter *) handle;
+  if (adapter)
+    return adapter->RemoveLogicalDevice(iLogicalAddress);
+  return false;
+}
+
+cec_manager_handle_t libcec_manager_create(const char *strDeviceName, cec_logical_address iLogicalAddress /* = CECDEVICE_PLAYBACKDEVICE1 */, uint16_t iPhysicalAddress /* = CEC_DEFAULT_PHYSICAL_ADDRESS */)
+{
+  return (cec_manager_handle_t) CECCreateManager(strDeviceName, iLogicalAddress, iPhysicalAddress);
+}
+
+void libcec_manager_destroy(cec_manager_handle_t manager)
+{
+  delete (ICECAdapterManager *) manager;
+}
+
+int libcec_manager_open(cec_manager_handle_t manager, const vector<string> &ports, uint64_t iTimeout)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->Open(ports, iTimeout);
+  return 0;
+}
+
+void libcec_manager_close(cec_manager_handle_t manager)
+{
+  if (manager)
+    ((ICECAdapterManager *) manager)->Close();
+}
+
+bool libcec_manager_use_shared_reactor(cec_manager_handle_t manager, bool bEnable /* = true */)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->UseSharedReactor(bEnable);
+  return false;
+}
+
+int libcec_manager_get_adapter_count(cec_manager_handle_t manager)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->GetAdapterCount();
+  return 0;
+}
+
+cec_handle_t libcec_manager_get_adapter(cec_manager_handle_t manager, int iAdapterId)
+{
+  if (manager)
+    return (cec_handle_t) ((ICECAdapterManager *) manager)->GetAdapter(iAdapterId);
+  return NULL;
+}
+
+bool libcec_manager_get_next_event(cec_manager_handle_t manager, cec_event *event)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->GetNextEvent(event);
+  return false;
+}
+
+unsigned int libcec_manager_get_next_events(cec_manager_handle_t manager, cec_event *events, unsigned int iMaxEvents)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->GetNextEvents(events, iMaxEvents);
+  return 0;
+}
+
+bool libcec_manager_set_queue_config(cec_manager_handle_t manager, const cec_queue_config *config)
+{
+  if (!manager || !config)
+    return false;
+  ((ICECAdapterManager *) manager)->SetEventQueueConfig(*config);
+  return true;
+}
+
+bool libcec_manager_get_queue_statistics(cec_manager_handle_t manager, cec_queue_statistics *statistics)
+{
+  if (!manager || !statistics)
+    return false;
+  ((ICECAdapterManager *) manager)->GetEventQueueStatistics(statistics);
+  return true;
+}
+
+int libcec_manager_transmit(cec_manager_handle_t manager, const cec_frame &data, bool bWaitForAck /* = true */)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->Transmit(data, bWaitForAck);
+  return 0;
+}
+
+int libcec_manager_power_on_devices(cec_manager_handle_t manager, cec_logical_address address /* = CECDEVICE_TV */)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->PowerOnDevices(address);
+  return 0;
+}
+
+int libcec_manager_standby_devices(cec_manager_handle_t manager, cec_logical_address address /* = CECDEVICE_BROADCAST */)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->StandbyDevices(address);
+  return 0;
+}
+
+int libcec_manager_set_active_view(cec_manager_handle_t manager)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->SetActiveView();
+  return 0;
+}
+
+int libcec_manager_set_inactive_view(cec_manager_handle_t manager)
+{
+  if (manager)
+    return ((ICECAdapterManager *) manager)->SetInactiveView();
+  return 0;
+}
+
 //@}
@@ -0,0 +1,344 @@
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+
+#include "TraceWriter.h"
+
+#include "platform/atomics.h"
+
+#if !defined(__WINDOWS__)
+#include <unistd.h>
+#endif
+
+#define CEC_TRACE_BUFFER_SIZE     1024 /* events per thread, a power of 2 */
+#define CEC_TRACE_FLUSH_INTERVAL  100
+
+using namespace std;
+using namespace CEC;
+
+namespace CEC
+{
+  /*!
+   * A single producer, single consumer ring of the events of one thread.
+   * Only the thread that owns it pushes, and only the writer thread pops.
+   */
+  class CTraceBuffer
+  {
+  public:
+    CTraceBuffer(void) :
+      m_iHead(0),
+      m_iTail(0),
+      m_iReleased(0),
+      m_iDropped(0),
+      m_iThreadId(0),
+      m_iNamedThreadId(0)
+    {
+      m_strThreadName[0] = 0;
+    }
+
+    bool Push(const TraceEvent &event)
+    {
+      uint32_t iHead = m_iHead;
+      if (iHead - AtomicLoad(&m_iTail) >= CEC_TRACE_BUFFER_SIZE)
+      {
+        AtomicAdd(&m_iDropped, 1);
+        return false;
+      }
+
+      m_events[iHead & (CEC_TRACE_BUFFER_SIZE - 1)] = event;
+      AtomicStore(&m_iHead, iHead + 1);
+      return true;
+    }
+
+    bool Pop(TraceEvent &event)
+    {
+      uint32_t iTail = m_iTail;
+      if (iTail == AtomicLoad(&m_iHead))
+        return false;
+
+      event = m_events[iTail & (CEC_TRACE_BUFFER_SIZE - 1)];
+      AtomicStore(&m_iTail, iTail + 1);
+      return true;
+    }
+
+    bool IsEmpty(void) const { return AtomicLoad(&m_iTail) == AtomicLoad(&m_iHead); }
+    void Clear(void) { AtomicStore(&m_iTail, AtomicLoad(&m_iHead)); }
+
+    TraceEvent   m_events[CEC_TRACE_BUFFER_SIZE];
+    volatile uint32_t m_iHead;
+    volatile uint32_t m_iTail;
+    volatile uint32_t m_iReleased;      /*!< 1 when the thread exited, so the buffer can be reused once it's empty */
+    volatile uint32_t m_iDropped;
+    uint32_t          m_iThreadId;      /*!< the id of the thread on the timeline, changes when the buffer is reused */
+    uint32_t          m_iNamedThreadId; /*!< the last id that the writer wrote the name of */
+    char              m_strThreadName[32];
+  };
+};
+
+CTraceWriter *              CTraceWriter::m_instance(NULL);
+CMutex                      CTraceWriter::m_instanceMutex("trace-instance");
+volatile uint32_t           CTraceWriter::m_iEnabled(0);
+vector<CTraceBuffer *>      CTraceWriter::m_buffers;
+CMutex                      CTraceWriter::m_buffersMutex("trace-buffers");
+pthread_key_t               CTraceWriter::m_bufferKey;
+pthread_once_t              CTraceWriter::m_bufferKeyOnce = PTHREAD_ONCE_INIT;
+uint32_t                    CTraceWriter::m_iNextThreadId(0);
+
+bool CTraceWriter::Start(const char *strFile)
+{
+  CLockObject lock(&m_instanceMutex);
+  if (m_instance || !strFile)
+    return false;
+
+  FILE *file = fopen(strFile, "w");
+  if (!file)
+    return false;
+
+  //drop what was recorded while the previous trace was being stopped, and name every thread again
+  {
+    CLockObject buffersLock(&m_buffersMutex);
+    for (vector<CTraceBuffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); it++)
+    {
+      (*it)->Clear();
+      (*it)->m_iNamedThreadId = 0;
+    }
+  }
+
+  m_instance = new CTraceWriter(file);
+  if (!m_instance->CreateThread())
+  {
+    delete m_instance;
+    m_instance = NULL;
+    return false;
+  }
+
+  AtomicStore(&m_iEnabled, 1);
+  return true;
+}
+
+bool CTraceWriter::Stop(void)
+{
+  CLockObject lock(&m_instanceMutex);
+  if (!m_instance)
+    return false;
+
+  AtomicStore(&m_iEnabled, 0);
+  m_instance->StopThread();
+  m_instance->Flush();
+  delete m_instance;
+  m_instance = NULL;
+  return true;
+}
+
+bool CTraceWriter::IsEnabled(void)
+{
+  return AtomicLoad(&m_iEnabled) != 0;
+}
+
+void CTraceWriter::AddSpan(const char *strName, int64_t iStart, int64_t iEnd,
+    const char *strArg1 /* = NULL */, int64_t iArg1 /* = 0 */, const char *strArg2 /* = NULL */, int64_t iArg2 /* = 0 */, const char *strArg3 /* = NULL */, int64_t iArg3 /* = 0 */)
+{
+  if (!IsEnabled())
+    return;
+
+  TraceEvent event;
+  event.strName        = strName;
+  event.phase          = 'X';
+  event.iStart         = iStart;
+  event.iDuration      = iEnd > iStart ? iEnd - iStart : 0;
+  event.strArgNames[0] = strArg1;
+  event.iArgs[0]       = iArg1;
+  event.strArgNames[1] = strArg2;
+  event.iArgs[1]       = iArg2;
+  event.strArgNames[2] = strArg3;
+  event.iArgs[2]       = iArg3;
+  AddEvent(event);
+}
+
+void CTraceWriter::AddInstant(const char *strName, int64_t iTime, const char *strArg1 /* = NULL */, int64_t iArg1 /* = 0 */)
+{
+  if (!IsEnabled())
+    return;
+
+  TraceEvent event;
+  event.strName        = strName;
+  event.phase          = 'i';
+  event.iStart         = iTime;
+  event.iDuration      = 0;
+  event.strArgNames[0] = strArg1;
+  event.iArgs[0]       = iArg1;
+  event.strArgNames[1] = NULL;
+  event.strArgNames[2] = NULL;
+  AddEvent(event);
+}
+
+void CTraceWriter::AddEvent(const TraceEvent &event)
+{
+  CTraceBuffer *buffer = GetThreadBuffer();
+  if (buffer)
+    buffer->Push(event);
+}
+
+void CTraceWriter::CreateThreadBufferKey(void)
+{
+  pthread_key_create(&m_bufferKey, ReleaseThreadBuffer);
+}
+
+void CTraceWriter::ReleaseThreadBuffer(void *buffer)
+{
+  //the events that are still in the buffer are written out before it's reused by another thread
+  AtomicStore(&((CTraceBuffer *) buffer)->m_iReleased, 1);
+}
+
+CTraceBuffer *CTraceWriter::GetThreadBuffer(void)
+{
+  pthread_once(&m_bufferKeyOnce, CreateThreadBufferKey);
+  CTraceBuffer *buffer = (CTraceBuffer *) pthread_getspecific(m_bufferKey);
+  if (buffer)
+    return buffer;
+
+  //buffers are never freed, because a thread may still be recording into its buffer while tracing is stopped
+  CLockObject lock(&m_buffersMutex);
+  for (vector<CTraceBuffer *>::iterator it = m_buffers.begin(); !buffer && it != m_buffers.end(); it++)
+  {
+    if (AtomicLoad(&(*it)->m_iReleased) == 1 && (*it)->IsEmpty())
+      buffer = *it;
+  }
+
+  if (!buffer)
+  {
+    buffer = new CTraceBuffer;
+    m_buffers.push_back(buffer);
+  }
+
+  AtomicStore(&buffer->m_iReleased, 0);
+  buffer->m_iThreadId = ++m_iNextThreadId;
+  buffer->m_strThreadName[0] = 0;
+#if defined(__linux__)
+  if (pthread_getname_np(pthread_self(), buffer->m_strThreadName, sizeof(buffer->m_strThreadName)) != 0)
+    buffer->m_strThreadName[0] = 0;
+#endif
+  if (!buffer->m_strThreadName[0])
+    sprintf(buffer->m_strThreadName, "thread %u", buffer->m_iThreadId);
+
+  pthread_setspecific(m_bufferKey, buffer);
+  return buffer;
+}
+
+CTraceWriter::CTraceWriter(FILE *file) :
+    CThread("cec-trace"),
+    m_file(file),
+    m_bFirstEvent(true),
+    m_iDropped(0)
+{
+#if defined(__WINDOWS__)
+  m_iProcessId = (int) GetCurrentProcessId();
+#else
+  m_iProcessId = (int) getpid();
+#endif
+  fprintf(m_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+}
+
+CTraceWriter::~CTraceWriter(void)
+{
+  StopThread();
+  fprintf(m_file, "\n],\"otherData\":{\"dropped_events\":\"%llu\"}}\n", (unsigned long long) m_iDropped);
+  fclose(m_file);
+}
+
+void *CTraceWriter::Process(void)
+{
+  while (!m_bStop)
+  {
+    Flush();
+    Sleep(CEC_TRACE_FLUSH_INTERVAL);
+  }
+
+  return NULL;
+}
+
+void CTraceWriter::Flush(void)
+{
+  CLockObject lock(&m_buffersMutex);
+  for (vector<CTraceBuffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); it++)
+  {
+    CTraceBuffer &buffer = **it;
+    if (buffer.IsEmpty())
+      continue;
+
+    //name the track of a thread before its first event
+    if (buffer.m_iNamedThreadId != buffer.m_iThreadId)
+    {
+      fprintf(m_file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"",
+          m_bFirstEvent ? "" : ",", m_iProcessId, buffer.m_iThreadId);
+      for (const char *c = buffer.m_strThreadName; *c; c++)
+        fputc(*c == '"' || *c == '\\' ? '_' : *c, m_file);
+      fprintf(m_file, "\"}}");
+      m_bFirstEvent = false;
+      buffer.m_iNamedThreadId = buffer.m_iThreadId;
+    }
+
+    TraceEvent event;
+    while (buffer.Pop(event))
+      WriteEvent(buffer, event);
+
+    uint32_t iDropped = AtomicLoad(&buffer.m_iDropped);
+    if (iDropped > 0)
+    {
+      m_iDropped += iDropped;
+      AtomicAdd(&buffer.m_iDropped, (uint32_t) 0 - iDropped);
+    }
+  }
+  fflush(m_file);
+}
+
+void CTraceWriter::WriteEvent(const CTraceBuffer &buffer, const TraceEvent &event)
+{
+  fprintf(m_file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%lld",
+      m_bFirstEvent ? "" : ",", event.strName, event.phase, m_iProcessId, buffer.m_iThreadId, (long long) event.iStart);
+  m_bFirstEvent = false;
+
+  if (event.phase == 'X')
+    fprintf(m_file, ",\"dur\":%lld", (long long) event.iDuration);
+  else if (event.phase == 'i')
+    fprintf(m_file, ",\"s\":\"t\"");
+
+  bool bFirstArg(true);
+  for (unsigned int iPtr = 0; iPtr < CEC_TRACE_MAX_ARGS; iPtr++)
+  {
+    if (!event.strArgNames[iPtr])
+      continue;
+    fprintf(m_file, "%s\"%s\":%lld", bFirstArg ? ",\"args\":{" : ",", event.strArgNames[iPtr], (long long) event.iArgs[iPtr]);
+    bFirstArg = false;
+  }
+  fprintf(m_file, bFirstArg ? "}" : "}}");
+}
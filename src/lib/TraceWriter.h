@@ -0,0 +1,99 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "../../include/CECExports.h"
+#include "platform/threads.h"
+#include <stdio.h>
+
+#define CEC_TRACE_MAX_ARGS 3
+
+namespace CEC
+{
+  class CTraceBuffer;
+
+  typedef struct TraceEvent
+  {
+    const char *strName;                          /*!< static string */
+    char        phase;                            /*!< 'X' for a span, 'i' for an instant */
+    int64_t     iStart;
+    int64_t     iDuration;
+    const char *strArgNames[CEC_TRACE_MAX_ARGS];  /*!< static strings, NULL when unused */
+    int64_t     iArgs[CEC_TRACE_MAX_ARGS];
+  } TraceEvent;
+
+  /*!
+   * Writes the spans and instants that libCEC's threads record to a Chrome trace_event JSON file,
+   * which can be opened in chrome://tracing or Perfetto.
+   * Every thread records into its own fixed size ring without taking a lock. A background thread
+   * empties the rings and writes them out, so recording never waits for the file.
+   */
+  class CTraceWriter : public CThread
+  {
+  public:
+    static bool Start(const char *strFile);
+    static bool Stop(void);
+    static bool IsEnabled(void);
+
+    static void AddSpan(const char *strName, int64_t iStart, int64_t iEnd,
+        const char *strArg1 = NULL, int64_t iArg1 = 0, const char *strArg2 = NULL, int64_t iArg2 = 0, const char *strArg3 = NULL, int64_t iArg3 = 0);
+    static void AddInstant(const char *strName, int64_t iTime, const char *strArg1 = NULL, int64_t iArg1 = 0);
+
+    void *Process(void);
+
+  private:
+    CTraceWriter(FILE *file);
+    virtual ~CTraceWriter(void);
+
+    static void AddEvent(const TraceEvent &event);
+    static CTraceBuffer *GetThreadBuffer(void);
+    static void ReleaseThreadBuffer(void *buffer);
+    static void CreateThreadBufferKey(void);
+
+    void Flush(void);
+    void WriteEvent(const CTraceBuffer &buffer, const TraceEvent &event);
+
+    FILE *   m_file;
+    bool     m_bFirstEvent;
+    uint64_t m_iDropped;
+    int      m_iProcessId;
+
+    static CTraceWriter *              m_instance;
+    static CMutex                      m_instanceMutex;
+    static volatile uint32_t           m_iEnabled;
+    static std::vector<CTraceBuffer *> m_buffers;
+    static CMutex                      m_buffersMutex;
+    static pthread_key_t               m_bufferKey;
+    static pthread_once_t              m_bufferKeyOnce;
+    static uint32_t                    m_iNextThreadId;
+  };
+};
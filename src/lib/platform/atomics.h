@@ -0,0 +1,102 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+#include "os-dependent.h"
+#include <stdint.h>
+
+namespace CEC
+{
+  /*!
+   * @return The value of iValue. Reads and writes that follow this call are not moved before it.
+   */
+  inline uint32_t AtomicLoad(const volatile uint32_t *iValue)
+  {
+  #if defined(__WINDOWS__)
+    uint32_t iReturn = *iValue;
+    _ReadWriteBarrier();
+    return iReturn;
+  #elif defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(iValue, __ATOMIC_ACQUIRE);
+  #else
+    uint32_t iReturn = *iValue;
+    __sync_synchronize();
+    return iReturn;
+  #endif
+  }
+
+  /*!
+   * @brief Change the value of iValue to iNewValue. Reads and writes that precede this call are not moved after it.
+   */
+  inline void AtomicStore(volatile uint32_t *iValue, uint32_t iNewValue)
+  {
+  #if defined(__WINDOWS__)
+    _ReadWriteBarrier();
+    *iValue = iNewValue;
+  #elif defined(__ATOMIC_RELEASE)
+    __atomic_store_n(iValue, iNewValue, __ATOMIC_RELEASE);
+  #else
+    __sync_synchronize();
+    *iValue = iNewValue;
+  #endif
+  }
+
+  /*!
+   * @brief Add iDelta to iValue as a single atomic operation. Acts as a full memory barrier.
+   * @return The new value.
+   */
+  inline uint32_t AtomicAdd(volatile uint32_t *iValue, uint32_t iDelta)
+  {
+  #if defined(__WINDOWS__)
+    return (uint32_t) InterlockedExchangeAdd((volatile LONG *) iValue, (LONG) iDelta) + iDelta;
+  #elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_add_fetch(iValue, iDelta, __ATOMIC_SEQ_CST);
+  #else
+    return __sync_add_and_fetch(iValue, iDelta);
+  #endif
+  }
+
+  /*!
+   * @brief Change the value of iValue to iNewValue if it's equal to iExpected, as a single atomic operation.
+   * @return True when the value was changed, false otherwise.
+   */
+  inline bool AtomicCompareAndSwap(volatile uint32_t *iValue, uint32_t iExpected, uint32_t iNewValue)
+  {
+  #if defined(__WINDOWS__)
+    return (uint32_t) InterlockedCompareExchange((volatile LONG *) iValue, (LONG) iNewValue, (LONG) iExpected) == iExpected;
+  #elif defined(__ATOMIC_ACQ_REL)
+    return __atomic_compare_exchange_n(iValue, &iExpected, iNewValue, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+  #else
+    return __sync_bool_compare_and_swap(iValue, iExpected, iNewValue);
+  #endif
+  }
+};
@@ -18,6 +18,8 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include "../serialport.h"
 #include "../baudrate.h"
 #include "../timeutils.h"
@@ -25,7 +27,10 @@
 using namespace std;
 using namespace CEC;
 
-CSerialPort::CSerialPort()
+CSerialPort::CSerialPort() :
+  m_mutex("serialport"),
+  m_iWriteSyscalls(0),
+  m_iBytesWritten(0)
 {
   m_fd = -1;
 }
@@ -35,7 +40,7 @@ CSerialPort::~CSerialPort()
   Close();
 }
 
-int32_t CSerialPort::Write(uint8_t* data, uint32_t len)
+int32_t CSerialPort::Write(const serial_buffer *buffers, unsigned int iBuffers)
 {
   fd_set port;
 
@@ -46,38 +51,69 @@ int32_t CSerialPort::Write(uint8_t* data, uint32_t len)
     return -1;
   }
 
+  if (iBuffers > SERIAL_MAX_WRITE_BUFFERS)
+  {
+    m_error = "too many buffers";
+    return -1;
+  }
+
+  struct iovec vectors[SERIAL_MAX_WRITE_BUFFERS];
+  int iVectors = 0;
+  int32_t len = 0;
+  for (unsigned int iPtr = 0; iPtr < iBuffers; iPtr++)
+  {
+    if (buffers[iPtr].size == 0)
+      continue;
+    vectors[iVectors].iov_base = (void *) buffers[iPtr].data;
+    vectors[iVectors].iov_len  = buffers[iPtr].size;
+    len += (int32_t) buffers[iPtr].size;
+    iVectors++;
+  }
+
   int32_t byteswritten = 0;
+  struct iovec *vector = vectors;
 
-  while (byteswritten < (int32_t) len)
+  while (byteswritten < len)
   {
-    FD_ZERO(&port);
-    FD_SET(m_fd, &port);
-    int returnv = select(m_fd + 1, NULL, &port, NULL, NULL);
+    //the port is non-blocking, so only wait for it when the output buffer is full
+    m_iWriteSyscalls++;
+    ssize_t returnv = writev(m_fd, vector, iVectors);
     if (returnv == -1)
     {
-      m_error = strerror(errno);
-      return -1;
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        m_error = strerror(errno);
+        return -1;
+      }
+
+      FD_ZERO(&port);
+      FD_SET(m_fd, &port);
+      m_iWriteSyscalls++;
+      if (select(m_fd + 1, NULL, &port, NULL, NULL) == -1 && errno != EINTR)
+      {
+        m_error = strerror(errno);
+        return -1;
+      }
+      continue;
     }
 
-    returnv = write(m_fd, data + byteswritten, len - byteswritten);
-    if (returnv == -1)
+    byteswritten   += (int32_t) returnv;
+    m_iBytesWritten += (uint64_t) returnv;
+
+    //skip what has been written after a partial write
+    while (iVectors > 0 && (size_t) returnv >= vector->iov_len)
     {
-      m_error = strerror(errno);
-      return -1;
+      returnv -= vector->iov_len;
+      vector++;
+      iVectors--;
+    }
+    if (iVectors > 0)
+    {
+      vector->iov_base = (uint8_t *) vector->iov_base + returnv;
+      vector->iov_len -= returnv;
     }
-    byteswritten += returnv;
   }
 
-  //print what's written to stdout for debugging
-//  if (m_tostdout)
-//  {
-//    printf("%s write:", m_name.c_str());
-//    for (int i = 0; i < byteswritten; i++)
-//      printf(" %02x", (unsigned int)data[i]);
-
-//    printf("\n");
-//  }
-
   return byteswritten;
 }
 
@@ -95,13 +131,18 @@ int32_t CSerialPort::Read(uint8_t* data, uint32_t len, uint64_t iTimeoutMs /*= 0
     return -1;
   }
 
+  // don't keep the port locked while waiting for data, so writes can be sent in the meantime
+  int fd = m_fd;
+  lock.Leave();
+
   if (iTimeoutMs > 0)
   {
-    now    = GetTimeMs();
-    target = now + (int64_t) iTimeoutMs;
+    now    = GetTimeUs();
+    target = now + (int64_t) iTimeoutMs * (int64_t) 1000;
   }
 
-  while (bytesread < (int32_t) len && (iTimeoutMs == 0 || target > now))
+  // return as soon as data has been read, instead of waiting for the timeout to pass
+  while (bytesread == 0 && (iTimeoutMs == 0 || target > now))
   {
     if (iTimeoutMs == 0)
     {
@@ -109,14 +150,14 @@ int32_t CSerialPort::Read(uint8_t* data, uint32_t len, uint64_t iTimeoutMs /*= 0
     }
     else
     {
-      timeout.tv_sec  = ((long int)target - (long int)now) / (long int)1000.;
-      timeout.tv_usec = ((long int)target - (long int)now) % (long int)1000.;
+      timeout.tv_sec  = (long int)((target - now) / (int64_t)1000000);
+      timeout.tv_usec = (long int)((target - now) % (int64_t)1000000);
       tv = &timeout;
     }
 
     FD_ZERO(&port);
-    FD_SET(m_fd, &port);
-    int32_t returnv = select(m_fd + 1, &port, NULL, NULL, tv);
+    FD_SET(fd, &port);
+    int32_t returnv = select(fd + 1, &port, NULL, NULL, tv);
 
     if (returnv == -1)
     {
@@ -128,17 +169,23 @@ int32_t CSerialPort::Read(uint8_t* data, uint32_t len, uint64_t iTimeoutMs /*= 0
       break; //nothing to read
     }
 
-    returnv = read(m_fd, data + bytesread, len - bytesread);
+    returnv = read(fd, data + bytesread, len - bytesread);
     if (returnv == -1)
     {
       m_error = strerror(errno);
       return -1;
     }
+    else if (returnv == 0)
+    {
+      //the port was readable, but there's nothing to read: the device has been disconnected
+      m_error = "device disconnected";
+      return -1;
+    }
 
     bytesread += returnv;
 
     if (iTimeoutMs > 0)
-      now = GetTimeMs();
+      now = GetTimeUs();
   }
 
   //print what's read to stdout for debugging
@@ -0,0 +1,90 @@
+#pragma once
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+/*
+ * Static user space probes (USDT) on the paths that a frame takes through libCEC, for tracers like perf and bpftrace:
+ *   perf probe -x libcec.so sdt_libcec:transmit_acked
+ *   bpftrace -e 'usdt:libcec.so:libcec:frame_eom { printf("%x -> %x: %x\n", arg0, arg1, arg2); }'
+ *
+ * The probes are only compiled in when libCEC is configured with --enable-probes (-DCEC_PROBES) and sys/sdt.h is available.
+ * Every probe has a semaphore that the tracer increments while it's attached, so the arguments of a probe, including
+ * its timestamp, are only evaluated while it's being traced. All timestamps are monotonic, in microseconds.
+ *
+ *   serial_read      (data, size, timestamp): bytes were read from the serial port
+ *   serial_write     (data, size, total size, timestamp): a write to the serial port completed. the total size includes the queued adapter commands
+ *   adapter_message  (code, data, size, timestamp): a message from the adapter was decoded
+ *   frame_start      (header, ack, timestamp): the first byte of a CEC frame was received
+ *   frame_eom        (initiator, destination, opcode, size, timestamp): the last byte of a CEC frame was received. opcode is -1 for polls
+ *   command_queued   (initiator, destination, opcode, adapter id, timestamp): a received command was queued for the application
+ *   command_dequeued (initiator, destination, opcode, adapter id, timestamp): the application took a command from the queue
+ *   transmit_queued  (data, size, timestamp): a frame was passed to Transmit()
+ *   transmit_written (data, size, timestamp): the formatted frame was written to the adapter
+ *   transmit_acked   (acked, result code, timestamp): the result of the transmission was received, or timed out
+ *   keypress         (keycode, duration, timestamp): a keypress was queued for the application
+ */
+
+#define CEC_PROBE_LIST(PROBE) \
+  PROBE(serial_read) \
+  PROBE(serial_write) \
+  PROBE(adapter_message) \
+  PROBE(frame_start) \
+  PROBE(frame_eom) \
+  PROBE(command_queued) \
+  PROBE(command_dequeued) \
+  PROBE(transmit_queued) \
+  PROBE(transmit_written) \
+  PROBE(transmit_acked) \
+  PROBE(keypress)
+
+#if defined(CEC_PROBES) && !defined(__WINDOWS__)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+//the semaphores are global symbols, because sdt.h refers to them by name
+#define CEC_PROBE_SEMAPHORE(name)         libcec_##name##_semaphore
+#define CEC_PROBE_DECLARE_SEMAPHORE(name) extern unsigned short CEC_PROBE_SEMAPHORE(name);
+#define CEC_PROBE_DEFINE_SEMAPHORE(name)  unsigned short CEC_PROBE_SEMAPHORE(name) __attribute__ ((section (".probes"))) = 0;
+#define CEC_PROBE_DEFINE_SEMAPHORES       CEC_PROBE_LIST(CEC_PROBE_DEFINE_SEMAPHORE)
+CEC_PROBE_LIST(CEC_PROBE_DECLARE_SEMAPHORE)
+
+#define CEC_PROBE_ENABLED(name)           __builtin_expect(CEC_PROBE_SEMAPHORE(name) != 0, 0)
+#define CEC_PROBE3(name, a, b, c)         do { if (CEC_PROBE_ENABLED(name)) DTRACE_PROBE3(libcec, name, a, b, c); } while (0)
+#define CEC_PROBE4(name, a, b, c, d)      do { if (CEC_PROBE_ENABLED(name)) DTRACE_PROBE4(libcec, name, a, b, c, d); } while (0)
+#define CEC_PROBE5(name, a, b, c, d, e)   do { if (CEC_PROBE_ENABLED(name)) DTRACE_PROBE5(libcec, name, a, b, c, d, e); } while (0)
+#else
+#define CEC_PROBE_DEFINE_SEMAPHORES
+#define CEC_PROBE_ENABLED(name)           false
+#define CEC_PROBE3(name, a, b, c)         do {} while (0)
+#define CEC_PROBE4(name, a, b, c, d)      do {} while (0)
+#define CEC_PROBE5(name, a, b, c, d, e)   do {} while (0)
+#endif
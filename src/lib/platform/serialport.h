@@ -36,6 +36,14 @@ namespace CEC
   #define PAR_EVEN 1
   #define PAR_ODD  2
 
+  #define SERIAL_MAX_WRITE_BUFFERS 8
+
+  typedef struct serial_buffer
+  {
+    const uint8_t *data;
+    uint32_t       size;
+  } serial_buffer;
+
   class CSerialPort
   {
     public:
@@ -46,15 +54,31 @@ namespace CEC
       bool IsOpen();
       void Close();
 
-      int32_t  Write(std::vector<uint8_t> data)
+      int32_t  Write(const std::vector<uint8_t> &data)
       {
         return Write(&data[0], (uint32_t) data.size());
       }
-      int32_t Write(uint8_t* data, uint32_t len);
+      int32_t Write(const uint8_t* data, uint32_t len)
+      {
+        serial_buffer buffer = { data, len };
+        return Write(&buffer, 1);
+      }
+
+      /*!
+       * @brief Write several buffers to the port, using as few system calls as possible.
+       * @param buffers The buffers to write, in order. At most SERIAL_MAX_WRITE_BUFFERS.
+       * @param iBuffers The number of buffers.
+       * @return The number of bytes that were written, or -1 on error.
+       */
+      int32_t Write(const serial_buffer *buffers, unsigned int iBuffers);
       int32_t Read(uint8_t* data, uint32_t len, uint64_t iTimeoutMs = 0);
 
       std::string GetError() { return m_error; }
       std::string GetName() { return m_name; }
+      void GetWriteStatistics(uint64_t &iSyscalls, uint64_t &iBytes) { CLockObject lock(&m_mutex); iSyscalls = m_iWriteSyscalls; iBytes = m_iBytesWritten; }
+  #ifndef __WINDOWS__
+      int GetFd() { CLockObject lock(&m_mutex); return m_fd; }
+  #endif
 
   private:
       bool SetBaudRate(uint32_t baudrate);
@@ -62,6 +86,8 @@ namespace CEC
       std::string     m_error;
       std::string     m_name;
       CMutex          m_mutex;
+      uint64_t        m_iWriteSyscalls;
+      uint64_t        m_iBytesWritten;
 
   #ifdef __WINDOWS__
       bool SetTimeouts(bool bBlocking);
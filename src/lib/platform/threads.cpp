@@ -32,12 +32,64 @@
 
 #include "threads.h"
 #include "timeutils.h"
+#include <limits.h>
+#include <string.h>
 
 using namespace CEC;
 
-CMutex::CMutex(void)
+#if defined(CEC_LOCK_STATISTICS)
+#define CEC_MAX_LOCK_STATISTICS 64
+
+// the statistics of all locks with the same name are kept together, and outlive the locks themselves
+static pthread_mutex_t     g_lockStatisticsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t     g_lockStatisticsEntryMutex[CEC_MAX_LOCK_STATISTICS];
+static cec_lock_statistics g_lockStatistics[CEC_MAX_LOCK_STATISTICS];
+static unsigned int        g_iLockStatistics = 0;
+
+static int FindLockStatistics(const char *strName)
+{
+  int iReturn(-1);
+  pthread_mutex_lock(&g_lockStatisticsMutex);
+  for (unsigned int iPtr = 0; iPtr < g_iLockStatistics && iReturn == -1; iPtr++)
+  {
+    if (!strncmp(g_lockStatistics[iPtr].name, strName, sizeof(g_lockStatistics[iPtr].name) - 1))
+      iReturn = (int) iPtr;
+  }
+
+  if (iReturn == -1 && g_iLockStatistics < CEC_MAX_LOCK_STATISTICS)
+  {
+    iReturn = (int) g_iLockStatistics;
+    memset(&g_lockStatistics[iReturn], 0, sizeof(g_lockStatistics[iReturn]));
+    strncpy(g_lockStatistics[iReturn].name, strName, sizeof(g_lockStatistics[iReturn].name) - 1);
+    pthread_mutex_init(&g_lockStatisticsEntryMutex[iReturn], NULL);
+    ++g_iLockStatistics;
+  }
+  pthread_mutex_unlock(&g_lockStatisticsMutex);
+
+  return iReturn;
+}
+
+static void AddToHistogram(uint32_t *histogram, int64_t iTime)
+{
+  unsigned int iBucket = 0;
+  while (iTime > 1 && iBucket < CEC_LOCK_HISTOGRAM_BUCKETS - 1)
+  {
+    iTime >>= 1;
+    ++iBucket;
+  }
+  ++histogram[iBucket];
+}
+#endif
+
+CMutex::CMutex(const char *strName /* = NULL */)
 {
   pthread_mutex_init(&m_mutex, NULL);
+#if defined(CEC_LOCK_STATISTICS)
+  m_iStatistics = strName ? FindLockStatistics(strName) : -1;
+  m_iHoldStart  = 0;
+#else
+  (void) strName;
+#endif
 }
 
 CMutex::~CMutex(void)
@@ -47,24 +99,118 @@ CMutex::~CMutex(void)
 
 bool CMutex::TryLock(void)
 {
-  return (pthread_mutex_trylock(&m_mutex) == 0);
+  if (pthread_mutex_trylock(&m_mutex) != 0)
+    return false;
+
+#if defined(CEC_LOCK_STATISTICS)
+  if (m_iStatistics != -1)
+  {
+    pthread_mutex_lock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+    ++g_lockStatistics[m_iStatistics].acquisitions;
+    pthread_mutex_unlock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+    StartHold();
+  }
+#endif
+  return true;
 }
 
 bool CMutex::Lock(void)
 {
+#if defined(CEC_LOCK_STATISTICS)
+  if (m_iStatistics != -1)
+  {
+    //only time the acquisitions that have to wait for another thread
+    int64_t iWaitTime(0);
+    bool bContended(pthread_mutex_trylock(&m_mutex) != 0);
+    if (bContended)
+    {
+      int64_t iWaitStart = GetTimeUs();
+      if (pthread_mutex_lock(&m_mutex) != 0)
+        return false;
+      iWaitTime = GetTimeUs() - iWaitStart;
+    }
+
+    cec_lock_statistics &statistics = g_lockStatistics[m_iStatistics];
+    pthread_mutex_lock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+    ++statistics.acquisitions;
+    if (bContended)
+    {
+      ++statistics.contended;
+      statistics.wait_time_total += (uint64_t) iWaitTime;
+      if ((uint64_t) iWaitTime > statistics.wait_time_max)
+        statistics.wait_time_max = (uint64_t) iWaitTime;
+      AddToHistogram(statistics.wait_histogram, iWaitTime);
+    }
+    pthread_mutex_unlock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+
+    StartHold();
+    return true;
+  }
+#endif
+
   return (pthread_mutex_lock(&m_mutex) == 0);
 }
 
 void CMutex::Unlock(void)
 {
+#if defined(CEC_LOCK_STATISTICS)
+  EndHold();
+#endif
   pthread_mutex_unlock(&m_mutex);
 }
 
+#if defined(CEC_LOCK_STATISTICS)
+void CMutex::StartHold(void)
+{
+  if (m_iStatistics != -1)
+    m_iHoldStart = GetTimeUs();
+}
+
+void CMutex::EndHold(void)
+{
+  if (m_iStatistics == -1)
+    return;
+
+  int64_t iHoldTime = GetTimeUs() - m_iHoldStart;
+  cec_lock_statistics &statistics = g_lockStatistics[m_iStatistics];
+  pthread_mutex_lock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+  statistics.hold_time_total += (uint64_t) iHoldTime;
+  if ((uint64_t) iHoldTime > statistics.hold_time_max)
+    statistics.hold_time_max = (uint64_t) iHoldTime;
+  AddToHistogram(statistics.hold_histogram, iHoldTime);
+  pthread_mutex_unlock(&g_lockStatisticsEntryMutex[m_iStatistics]);
+}
+#endif
+
+unsigned int CMutex::GetStatistics(cec_lock_statistics *statistics, unsigned int iMaxLocks)
+{
+#if defined(CEC_LOCK_STATISTICS)
+  if (!statistics)
+    return 0;
+
+  pthread_mutex_lock(&g_lockStatisticsMutex);
+  unsigned int iLocks = g_iLockStatistics < iMaxLocks ? g_iLockStatistics : iMaxLocks;
+  for (unsigned int iPtr = 0; iPtr < iLocks; iPtr++)
+  {
+    pthread_mutex_lock(&g_lockStatisticsEntryMutex[iPtr]);
+    statistics[iPtr] = g_lockStatistics[iPtr];
+    pthread_mutex_unlock(&g_lockStatisticsEntryMutex[iPtr]);
+  }
+  pthread_mutex_unlock(&g_lockStatisticsMutex);
+
+  return iLocks;
+#else
+  (void) statistics;
+  (void) iMaxLocks;
+  return 0;
+#endif
+}
+
 CLockObject::CLockObject(CMutex *mutex) :
-  m_mutex(mutex)
+  m_mutex(mutex),
+  m_bLocked(false)
 {
-  if (m_mutex)
-    m_mutex->Lock();
+  Lock();
 }
 
 CLockObject::~CLockObject(void)
@@ -75,19 +221,31 @@ CLockObject::~CLockObject(void)
 
 void CLockObject::Leave(void)
 {
-  if (m_mutex)
+  if (m_mutex && m_bLocked)
+  {
+    m_bLocked = false;
     m_mutex->Unlock();
+  }
 }
 
 void CLockObject::Lock(void)
 {
-  if (m_mutex)
-    m_mutex->Lock();
+  if (m_mutex && !m_bLocked)
+    m_bLocked = m_mutex->Lock();
 }
 
 CCondition::CCondition(void)
 {
+#if defined(__WINDOWS__) || defined(__APPLE__)
   pthread_cond_init(&m_cond, NULL);
+#else
+  // bind the condition to the monotonic clock, so timeouts aren't affected by changes to the wall clock
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&m_cond, &attr);
+  pthread_condattr_destroy(&attr);
+#endif
 }
 
 CCondition::~CCondition(void)
@@ -113,19 +271,34 @@ bool CCondition::Wait(CMutex *mutex, int64_t iTimeout)
   if (mutex)
   {
     struct timespec abstime;
-    struct timeval now;
-    if (gettimeofday(&now, NULL) == 0)
-    {
-      iTimeout       += now.tv_usec / 1000;
-      abstime.tv_sec  = now.tv_sec + (time_t)(iTimeout / 1000);
-      abstime.tv_nsec = (long)((iTimeout % (unsigned long)1000) * (unsigned long)1000000);
-      bReturn         = (pthread_cond_timedwait(&m_cond, &mutex->m_mutex, &abstime) == 0);
-    }
+    GetAbsTime(abstime, iTimeout * (int64_t)1000);
+#if defined(CEC_LOCK_STATISTICS)
+    //the mutex isn't held while waiting
+    mutex->EndHold();
+#endif
+    bReturn = (pthread_cond_timedwait(&m_cond, &mutex->m_mutex, &abstime) == 0);
+#if defined(CEC_LOCK_STATISTICS)
+    mutex->StartHold();
+#endif
   }
 
   return bReturn;
 }
 
+void CCondition::GetAbsTime(struct timespec &abstime, int64_t iTimeoutUs)
+{
+#if defined(__WINDOWS__) || defined(__APPLE__)
+  // pthread_cond_timedwait() uses the realtime clock on these platforms
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  int64_t iTargetUs = (int64_t)now.tv_sec * (int64_t)1000000 + (int64_t)now.tv_usec + iTimeoutUs;
+#else
+  int64_t iTargetUs = GetTimeUs() + iTimeoutUs;
+#endif
+  abstime.tv_sec  = (time_t)(iTargetUs / (int64_t)1000000);
+  abstime.tv_nsec = (long)((iTargetUs % (int64_t)1000000) * (int64_t)1000);
+}
+
 void CCondition::Sleep(int64_t iTimeout)
 {
   CCondition w;
@@ -134,17 +307,22 @@ void CCondition::Sleep(int64_t iTimeout)
   w.Wait(&m, iTimeout);
 }
 
-CThread::CThread(void) :
+CThread::CThread(const char *strName /* = NULL */) :
+    m_threadMutex(strName ? strName : "thread"),
     m_bRunning(false),
-    m_bStop(false)
+    m_bStop(false),
+    m_bJoinable(false),
+    m_strName(strName),
+    m_bHasThreadConfig(false),
+    m_iThreadConfigError(0)
 {
+  memset(&m_threadConfig, 0, sizeof(m_threadConfig));
+  memset(&m_appliedThreadConfig, 0, sizeof(m_appliedThreadConfig));
 }
 
 CThread::~CThread(void)
 {
-  m_bStop = true;
-  m_threadCondition.Broadcast();
-  pthread_join(m_thread, NULL);
+  StopThread();
 }
 
 bool CThread::CreateThread(void)
@@ -152,16 +330,156 @@ bool CThread::CreateThread(void)
   bool bReturn(false);
 
   CLockObject lock(&m_threadMutex);
+
+  //a thread that was stopped without waiting for it, or that returned by itself, is joined before a new one is started
+  if (m_bJoinable && !m_bRunning)
+  {
+    void *retVal;
+    pthread_join(m_thread, &retVal);
+    m_bJoinable = false;
+  }
   m_bStop = false;
-  if (!m_bRunning && pthread_create(&m_thread, NULL, (void *(*) (void *))&CThread::ThreadHandler, (void *)this) == 0)
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (m_threadConfig.stack_size > 0)
+    pthread_attr_setstacksize(&attr, m_threadConfig.stack_size);
+
+  if (!m_bRunning && !m_bJoinable && pthread_create(&m_thread, &attr, (void *(*) (void *))&CThread::ThreadHandler, (void *)this) == 0)
   {
-    m_bRunning = true;
+    m_bRunning  = true;
+    m_bJoinable = true;
     bReturn = true;
+
+    //the thread runs with the default scheduling parameters when they can't be applied
+    memset(&m_appliedThreadConfig, 0, sizeof(m_appliedThreadConfig));
+    m_iThreadConfigError = ApplyThreadConfig();
   }
 
+  pthread_attr_destroy(&attr);
   return bReturn;
 }
 
+bool CThread::SetThreadConfig(const cec_thread_config &config)
+{
+  if (!IsValidThreadConfig(config))
+    return false;
+
+  CLockObject lock(&m_threadMutex);
+  m_threadConfig     = config;
+  m_bHasThreadConfig = true;
+  return m_bJoinable ? ApplyThreadConfig() == 0 : true;
+}
+
+bool CThread::HasThreadConfig(void)
+{
+  CLockObject lock(&m_threadMutex);
+  return m_bHasThreadConfig;
+}
+
+cec_thread_config CThread::GetThreadConfig(void)
+{
+  CLockObject lock(&m_threadMutex);
+  return m_threadConfig;
+}
+
+int CThread::GetThreadConfigError(void)
+{
+  CLockObject lock(&m_threadMutex);
+  return m_iThreadConfigError;
+}
+
+bool CThread::IsValidThreadConfig(const cec_thread_config &config)
+{
+  switch (config.policy)
+  {
+  case CEC_THREAD_POLICY_DEFAULT:
+    break;
+#if !defined(__WINDOWS__)
+  case CEC_THREAD_POLICY_FIFO:
+  case CEC_THREAD_POLICY_RR:
+    {
+      int iPolicy = config.policy == CEC_THREAD_POLICY_FIFO ? SCHED_FIFO : SCHED_RR;
+      if (config.priority < sched_get_priority_min(iPolicy) || config.priority > sched_get_priority_max(iPolicy))
+        return false;
+    }
+    break;
+#endif
+  default:
+    return false;
+  }
+
+#if !defined(__linux__)
+  if (config.cpu_affinity != 0)
+    return false;
+#endif
+
+#if defined(PTHREAD_STACK_MIN)
+  if (config.stack_size > 0 && config.stack_size < (unsigned int) PTHREAD_STACK_MIN)
+    return false;
+#endif
+
+  return true;
+}
+
+int CThread::ApplyThreadConfig(void)
+{
+  int iReturn(0);
+
+#if !defined(__WINDOWS__)
+  //leave the scheduling parameters alone unless they are or were changed, so the ones of the creating thread are inherited
+  if (m_threadConfig.policy != CEC_THREAD_POLICY_DEFAULT || m_appliedThreadConfig.policy != CEC_THREAD_POLICY_DEFAULT)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    int iPolicy = SCHED_OTHER;
+    if (m_threadConfig.policy != CEC_THREAD_POLICY_DEFAULT)
+    {
+      iPolicy = m_threadConfig.policy == CEC_THREAD_POLICY_FIFO ? SCHED_FIFO : SCHED_RR;
+      param.sched_priority = m_threadConfig.priority;
+    }
+
+    int iError = pthread_setschedparam(m_thread, iPolicy, &param);
+    if (iError == 0)
+    {
+      m_appliedThreadConfig.policy   = m_threadConfig.policy;
+      m_appliedThreadConfig.priority = m_threadConfig.priority;
+    }
+    else
+    {
+      iReturn = iError;
+    }
+  }
+#endif
+
+#if defined(__linux__)
+  if (m_threadConfig.cpu_affinity != 0 || m_appliedThreadConfig.cpu_affinity != 0)
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int iCpu = 0; iCpu < CPU_SETSIZE; iCpu++)
+    {
+      if (m_threadConfig.cpu_affinity == 0 || (iCpu < 64 && (m_threadConfig.cpu_affinity & ((uint64_t)1 << iCpu))))
+        CPU_SET(iCpu, &cpus);
+    }
+
+    int iError = pthread_setaffinity_np(m_thread, sizeof(cpus), &cpus);
+    if (iError == 0)
+      m_appliedThreadConfig.cpu_affinity = m_threadConfig.cpu_affinity;
+    else if (iReturn == 0)
+      iReturn = iError;
+  }
+
+  char strName[sizeof(m_threadConfig.name)];
+  strncpy(strName, m_threadConfig.name[0] ? m_threadConfig.name : (m_strName ? m_strName : ""), sizeof(strName));
+  strName[sizeof(strName) - 1] = 0;
+  if (strName[0])
+    pthread_setname_np(m_thread, strName);
+#endif
+
+  return iReturn;
+}
+
 void *CThread::ThreadHandler(CThread *thread)
 {
   void *retVal = NULL;
@@ -176,11 +494,18 @@ void *CThread::ThreadHandler(CThread *thread)
 bool CThread::StopThread(bool bWaitForExit /* = true */)
 {
   bool bReturn(false);
+  CLockObject lock(&m_threadMutex);
   m_bStop = true;
-
   m_threadCondition.Broadcast();
+
+  //only join a thread once, or pthread_join() may block forever
+  bool bJoin(bWaitForExit && m_bJoinable);
+  if (bJoin)
+    m_bJoinable = false;
+  lock.Leave();
+
   void *retVal;
-  if (bWaitForExit)
+  if (bJoin)
     bReturn = (pthread_join(m_thread, &retVal) == 0);
 
   return bReturn;
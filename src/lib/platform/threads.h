@@ -32,6 +32,7 @@
  */
 
 #include "os-dependent.h"
+#include "../../../include/CECExports.h"
 #include <stdint.h>
 
 namespace CEC
@@ -50,20 +51,43 @@ namespace CEC
     static void Sleep(int64_t iTimeout);
 
   private:
+    static void GetAbsTime(struct timespec &abstime, int64_t iTimeoutUs);
+
     pthread_cond_t  m_cond;
   };
 
   class CMutex
   {
   public:
-    CMutex(void);
+    /*!
+     * @param strName The name that the statistics of this lock are recorded under when libCEC is built with CEC_LOCK_STATISTICS.
+     */
+    CMutex(const char *strName = NULL);
     virtual ~CMutex(void);
 
     bool TryLock(void);
     bool Lock(void);
     void Unlock(void);
 
+    /*!
+     * @brief Copy the acquisition, contention, wait and hold time statistics of all named locks.
+     * @param statistics The array to copy the statistics to.
+     * @param iMaxLocks The size of statistics.
+     * @return The number of locks that were copied. Always 0 unless libCEC is built with CEC_LOCK_STATISTICS.
+     */
+    static unsigned int GetStatistics(cec_lock_statistics *statistics, unsigned int iMaxLocks);
+
     pthread_mutex_t m_mutex;
+
+  private:
+    friend class CCondition;
+#if defined(CEC_LOCK_STATISTICS)
+    void StartHold(void);
+    void EndHold(void);
+
+    int     m_iStatistics; /*!< the index of the statistics of this lock, -1 when they're not recorded */
+    int64_t m_iHoldStart;
+#endif
   };
 
   class CLockObject
@@ -84,22 +108,53 @@ namespace CEC
   class CThread
   {
   public:
-    CThread(void);
+    /*!
+     * @param strName The name of the thread, used when the thread configuration doesn't name it. The statistics of its lock are recorded under this name too.
+     */
+    CThread(const char *strName = NULL);
     virtual ~CThread(void);
 
     virtual bool IsRunning(void) const { return m_bRunning; }
     virtual bool CreateThread(void);
+    /*!
+     * @brief Tell the thread to stop.
+     * @param bWaitForExit True to join the thread. Otherwise it's joined by the next call to StopThread(), by CreateThread() or by the destructor.
+     * @return True when the thread was joined.
+     */
     virtual bool StopThread(bool bWaitForExit = true);
     virtual bool Sleep(uint64_t iTimeout);
 
+    /*!
+     * @brief Change the scheduling policy, priority, CPU affinity, stack size and name of this thread.
+     * @param config The new configuration. Applied right away when the thread is running, otherwise by CreateThread().
+     * @return False when the configuration is invalid or couldn't be applied to the running thread.
+     */
+    virtual bool SetThreadConfig(const cec_thread_config &config);
+    bool HasThreadConfig(void);
+    cec_thread_config GetThreadConfig(void);
+
+    /*!
+     * @return The error that prevented the configuration from being applied when the thread was created, 0 if there was none.
+     */
+    int GetThreadConfigError(void);
+    static bool IsValidThreadConfig(const cec_thread_config &config);
+
     static void *ThreadHandler(CThread *thread);
     virtual void *Process(void) = 0;
 
   protected:
-    pthread_t  m_thread;
-    CMutex     m_threadMutex;
-    CCondition m_threadCondition;
-    bool       m_bRunning;
-    bool       m_bStop;
+    int ApplyThreadConfig(void);
+
+    pthread_t         m_thread;
+    CMutex            m_threadMutex;
+    CCondition        m_threadCondition;
+    bool              m_bRunning;
+    bool              m_bStop;
+    bool              m_bJoinable;
+    const char *      m_strName;
+    cec_thread_config m_threadConfig;
+    cec_thread_config m_appliedThreadConfig;
+    bool              m_bHasThreadConfig;
+    int               m_iThreadConfigError;
   };
 };
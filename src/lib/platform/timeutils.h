@@ -23,31 +23,40 @@
 
 namespace CEC
 {
-  inline int64_t GetTimeMs()
+  /*!
+   * @return A monotonic timestamp in microseconds. Not affected by changes to the wall clock.
+   */
+  inline int64_t GetTimeUs()
   {
   #ifdef __WINDOWS__
-    time_t rawtime;
-    time(&rawtime);
-
     LARGE_INTEGER tickPerSecond;
     LARGE_INTEGER tick;
     if (QueryPerformanceFrequency(&tickPerSecond))
     {
       QueryPerformanceCounter(&tick);
-      return (int64_t) (tick.QuadPart / 1000.);
+      return (int64_t) ((tick.QuadPart / tickPerSecond.QuadPart) * 1000000 +
+                        (tick.QuadPart % tickPerSecond.QuadPart) * 1000000 / tickPerSecond.QuadPart);
     }
     return -1;
   #else
     struct timespec time;
     clock_gettime(CLOCK_MONOTONIC, &time);
 
-    return ((int64_t)time.tv_sec * (int64_t)1000) + (int64_t)time.tv_nsec / (int64_t)1000;
+    return ((int64_t)time.tv_sec * (int64_t)1000000) + (int64_t)time.tv_nsec / (int64_t)1000;
   #endif
   }
 
+  /*!
+   * @return A monotonic timestamp in milliseconds.
+   */
+  inline int64_t GetTimeMs()
+  {
+    return GetTimeUs() / (int64_t)1000;
+  }
+
   template <class T>
   inline T GetTimeSec()
   {
-    return (T)GetTimeMs() / (T)1000.0;
+    return (T)GetTimeUs() / (T)1000000.0;
   }
 };
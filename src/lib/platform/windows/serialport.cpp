@@ -49,12 +49,16 @@ void FormatWindowsError(int iErrorCode, string &strMessage)
 }
 
 CSerialPort::CSerialPort(void) :
+  m_mutex("serialport"),
+  m_iWriteSyscalls(0),
+  m_iBytesWritten(0),
   m_handle(INVALID_HANDLE_VALUE),
   m_bIsOpen(false),
   m_iBaudrate(0),
   m_iDatabits(0),
   m_iStopbits(0),
-  m_iParity(0)
+  m_iParity(0),
+  m_buffer("serialport-buffer")
 {
 }
 
@@ -166,13 +170,40 @@ void CSerialPort::Close(void)
   }
 }
 
-int32_t CSerialPort::Write(uint8_t* data, uint32_t len)
+int32_t CSerialPort::Write(const serial_buffer *buffers, unsigned int iBuffers)
 {
   CLockObject lock(&m_mutex);
   DWORD iBytesWritten = 0;
   if (!m_bIsOpen)
     return -1;
 
+  //there's no gathering write for COM ports, so combine the buffers first unless there's only one of them
+  const uint8_t *data = NULL;
+  uint32_t len = 0;
+  vector<uint8_t> combined;
+  for (unsigned int iPtr = 0; iPtr < iBuffers; iPtr++)
+  {
+    if (buffers[iPtr].size == 0)
+      continue;
+
+    if (!data)
+    {
+      data = buffers[iPtr].data;
+    }
+    else
+    {
+      if (combined.empty())
+        combined.assign(data, data + len);
+      combined.insert(combined.end(), buffers[iPtr].data, buffers[iPtr].data + buffers[iPtr].size);
+      data = &combined[0];
+    }
+    len += buffers[iPtr].size;
+  }
+
+  if (len == 0)
+    return 0;
+
+  m_iWriteSyscalls++;
   if (!WriteFile(m_handle, data, len, &iBytesWritten, NULL))
   {
     m_error = "Error while writing to COM port";
@@ -180,6 +211,7 @@ int32_t CSerialPort::Write(uint8_t* data, uint32_t len)
     return -1;
   }
 
+  m_iBytesWritten += iBytesWritten;
   return iBytesWritten;
 }
 
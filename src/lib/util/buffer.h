@@ -31,49 +31,506 @@
  *     http://www.pulse-eight.net/
  */
 
+#include "../../../include/CECExports.h"
+#include "../platform/atomics.h"
 #include "../platform/threads.h"
-#include <queue>
+#include "../platform/timeutils.h"
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#include <utility>
+#define CEC_HAVE_MOVE
+#endif
 
 namespace CEC
 {
-  template<typename _BType>
+  /*!
+   * @brief Move the contents of src to dst. src is left in a valid but unspecified state.
+   *
+   * Containers are swapped, so the storage of dst is recycled by src instead of being freed. Compilers without
+   * rvalue references copy everything else. Add an overload next to the declaration of a type to make it cheap
+   * to move.
+   */
+#if defined(CEC_HAVE_MOVE)
+  template<typename _Type>
+    inline void CecBufferMove(_Type &dst, _Type &src) { dst = std::move(src); }
+#else
+  template<typename _Type>
+    inline void CecBufferMove(_Type &dst, _Type &src) { dst = src; }
+#endif
+  template<typename _Type>
+    inline void CecBufferMove(std::vector<_Type> &dst, std::vector<_Type> &src) { dst.swap(src); }
+  inline void CecBufferMove(std::string &dst, std::string &src) { dst.swap(src); }
+
+  /*!
+   * @brief Store an entry in a slot. Moves a mutable entry. A const entry is assigned, so the containers of the slot
+   * keep their storage. Add an overload for a type that can be stored without building a full entry first.
+   */
+  template<typename _Type>
+    inline void CecBufferStore(_Type &dst, _Type &src) { CecBufferMove(dst, src); }
+  template<typename _Type>
+    inline void CecBufferStore(_Type &dst, const _Type &src) { dst = src; }
+
+  /*!
+   * @return True when both entries are equal. Used by CEC_QUEUE_POLICY_COALESCE.
+   */
+  template<typename _Type>
+    inline bool CecBufferEquals(const _Type &a, const _Type &b) { return a == b; }
+
+  /*!
+   * @brief Store the sequence number of an entry. Overload this for types that carry a sequence number.
+   */
+  template<typename _Type>
+    inline void CecBufferSetSequence(_Type &entry, uint32_t iSequence) { (void) entry; (void) iSequence; }
+
+  /*!
+   * @brief Bounded, preallocated multi-producer/multi-consumer queue that doesn't take a lock.
+   *
+   * Every slot carries a sequence number that tells producers and consumers whether it's free or filled for
+   * the position they claimed, so a push or pop is a single compare-and-swap when there is no contention.
+   * Entries are moved in and out of the slots instead of being copied.
+   *
+   * An entry's sequence number is set when it claims its slot: the slot's position plus the number of entries that
+   * were dropped without getting a slot. So the numbers increase in the order the entries are popped, also with
+   * several producers, and a gap means that entries were dropped.
+   *
+   * What happens when the buffer is full depends on the cec_queue_policy that was set with SetConfig().
+   * CEC_QUEUE_POLICY_BLOCK and CEC_QUEUE_POLICY_COALESCE serialise producers with a mutex. Consumers never lock.
+   *
+   * The time that entries spend in the buffer is only recorded when libCEC is built with CEC_QUEUE_STATISTICS,
+   * so a push and a pop don't read the clock otherwise.
+   *
+   * @param _BType     The type of the entries. Must be default constructible.
+   * @param _iCapacity The maximum number of entries in this buffer. Must be a power of 2.
+   */
+  template<typename _BType, unsigned int _iCapacity = 128>
     struct CecBuffer
     {
     public:
-      CecBuffer(unsigned int iMaxSize = 100)
+      /*!
+       * @param strName The name that the statistics of the lock of this buffer are recorded under.
+       */
+      CecBuffer(const char *strName = "buffer") :
+        m_iEnqueuePos(0),
+        m_iDequeuePos(0),
+        m_policy(CEC_QUEUE_POLICY_DROP_NEWEST),
+        m_iLimit(_iCapacity),
+        m_iBlockTimeoutMs(0),
+        m_iHighWatermark(0),
+        m_watermarkCallback(NULL),
+        m_watermarkCallbackParam(NULL),
+        m_iAboveWatermark(0),
+        m_iPeakSize(0),
+        m_iDropped(0),
+        m_iCoalesced(0),
+        m_iRejected(0),
+        m_iWaiting(0),
+#if defined(CEC_QUEUE_STATISTICS)
+        m_iLatencyMax(0),
+#endif
+        m_bHaveLastEntry(false),
+        m_iLastEntryPos(0),
+        m_mutex(strName)
       {
-        m_maxSize = iMaxSize;
+        /* fails to compile when the capacity isn't a power of 2 */
+        typedef char CapacityIsPowerOfTwo[(_iCapacity >= 2 && (_iCapacity & (_iCapacity - 1)) == 0) ? 1 : -1];
+        (void) sizeof(CapacityIsPowerOfTwo);
+
+        for (uint32_t iPtr = 0; iPtr < _iCapacity; iPtr++)
+          m_cells[iPtr].iSequence = iPtr;
+#if defined(CEC_QUEUE_STATISTICS)
+        for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+          m_latencyHistogram[iPtr] = 0;
+#endif
       }
       virtual ~CecBuffer(void) {}
 
-      int Size(void) const { return m_buffer.size(); }
+      /*!
+       * @return The number of entries in this buffer. Only a snapshot when other threads are using the buffer.
+       */
+      int Size(void) const
+      {
+        int32_t iSize = (int32_t) (AtomicLoad(&m_iEnqueuePos) - AtomicLoad(&m_iDequeuePos));
+        if (iSize < 0)
+          return 0;
+        return iSize > (int32_t) _iCapacity ? (int) _iCapacity : (int) iSize;
+      }
+
+      /*!
+       * @return The configured maximum number of entries in this buffer.
+       */
+      unsigned int Capacity(void) const { return m_iLimit; }
 
-      bool Push(_BType entry)
+      /*!
+       * @brief Change the overflow policy, capacity and high watermark of this buffer.
+       *
+       * Entries that are already in the buffer are kept when the capacity is lowered. Producers that are waiting
+       * for room are woken up and use the new configuration.
+       */
+      void SetConfig(const cec_queue_config &config)
       {
         CLockObject lock(&m_mutex);
-        if (m_buffer.size() == m_maxSize)
+        m_iLimit                 = config.capacity == 0 || config.capacity > _iCapacity ? _iCapacity : config.capacity;
+        m_iBlockTimeoutMs        = config.block_timeout_ms;
+        m_iHighWatermark         = config.high_watermark;
+        m_watermarkCallback      = config.watermark_cb;
+        m_watermarkCallbackParam = config.watermark_cb_param;
+        m_policy                 = config.policy;
+        m_bHaveLastEntry         = false;
+        AtomicStore(&m_iAboveWatermark, 0);
+        m_condition.Broadcast();
+      }
+
+      void GetStatistics(cec_queue_statistics &statistics) const
+      {
+        statistics.capacity      = m_iLimit;
+        statistics.max_capacity  = _iCapacity;
+        statistics.size          = (unsigned int) Size();
+        statistics.peak_size     = AtomicLoad(&m_iPeakSize);
+        statistics.pushed        = AtomicLoad(&m_iEnqueuePos);
+        statistics.popped        = AtomicLoad(&m_iDequeuePos);
+        statistics.dropped       = AtomicLoad(&m_iDropped);
+        statistics.coalesced     = AtomicLoad(&m_iCoalesced);
+        statistics.last_sequence = AtomicLoad(&m_iEnqueuePos) + AtomicLoad(&m_iRejected);
+#if defined(CEC_QUEUE_STATISTICS)
+        statistics.latency_max   = AtomicLoad(&m_iLatencyMax);
+        for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+          statistics.latency_histogram[iPtr] = AtomicLoad(&m_latencyHistogram[iPtr]);
+#else
+        statistics.latency_max   = 0;
+        for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+          statistics.latency_histogram[iPtr] = 0;
+#endif
+      }
+
+      /*!
+       * @brief Copy an entry into the next free slot, reusing the storage of the slot.
+       * @return True when added or coalesced, false when it was dropped.
+       */
+      bool Push(const _BType &entry)
+      {
+        return PushEntry(entry);
+      }
+
+      /*!
+       * @brief Move an entry into this buffer, without copying it. The entry gets the next sequence number.
+       * @param entry The entry. Left in a valid but unspecified state, even when it was dropped.
+       * @return True when added or coalesced, false when it was dropped.
+       */
+      bool PushMove(_BType &entry)
+      {
+        return PushEntry(entry);
+      }
+
+      /*!
+       * @brief Store an entry of another type in the next free slot with CecBufferStore(), without building a _BType first.
+       * @return True when added or coalesced, false when it was dropped.
+       */
+      template<typename _Entry>
+      bool PushFrom(const _Entry &entry)
+      {
+        return PushEntry(entry);
+      }
+
+      /*!
+       * @return True when the buffer is full and its policy drops new entries, without counting anything.
+       *         Only a snapshot when other threads are using the buffer.
+       */
+      bool IsFull(void) const
+      {
+        return m_policy == CEC_QUEUE_POLICY_DROP_NEWEST && Size() >= (int) m_iLimit;
+      }
+
+      /*!
+       * @brief Count an entry as dropped without building it, when the buffer is full and its policy drops new entries.
+       * @return True when the entry was dropped. Only a snapshot when other threads are using the buffer.
+       */
+      bool DropWhenFull(void)
+      {
+        return IsFull() && !Pushed(false);
+      }
+
+      /*!
+       * @brief Remove the oldest entry from this buffer and move it to entry.
+       * @return True when an entry was removed, false when the buffer is empty.
+       */
+      bool Pop(_BType &entry)
+      {
+        return Pop(&entry, 1) == 1;
+      }
+
+      /*!
+       * @brief Pop up to iMaxEntries entries at once. The filled slots are claimed with a single compare-and-swap.
+       * @return The number of entries that were moved to entries.
+       */
+      unsigned int Pop(_BType *entries, unsigned int iMaxEntries)
+      {
+        if (iMaxEntries > _iCapacity)
+          iMaxEntries = _iCapacity;
+        if (iMaxEntries == 0)
+          return 0;
+
+        unsigned int iPopped;
+        uint32_t iPos = AtomicLoad(&m_iDequeuePos);
+        for (;;)
+        {
+          int32_t iDiff = (int32_t) (AtomicLoad(&m_cells[iPos & (_iCapacity - 1)].iSequence) - (iPos + 1));
+          if (iDiff < 0)
+          {
+            /* nothing has been pushed to this slot yet */
+            return 0;
+          }
+          else if (iDiff == 0)
+          {
+            /* the slots after the first one can only be taken by a consumer that claims the first one too */
+            iPopped = 1;
+            while (iPopped < iMaxEntries &&
+                   AtomicLoad(&m_cells[(iPos + iPopped) & (_iCapacity - 1)].iSequence) == iPos + iPopped + 1)
+              iPopped++;
+
+            if (AtomicCompareAndSwap(&m_iDequeuePos, iPos, iPos + iPopped))
+              break;
+          }
+          iPos = AtomicLoad(&m_iDequeuePos);
+        }
+
+#if defined(CEC_QUEUE_STATISTICS)
+        int64_t iNow = GetTimeUs();
+#endif
+        for (unsigned int iPtr = 0; iPtr < iPopped; iPtr++)
+        {
+          Cell *cell = &m_cells[(iPos + iPtr) & (_iCapacity - 1)];
+          CecBufferMove(entries[iPtr], cell->data);
+#if defined(CEC_QUEUE_STATISTICS)
+          int64_t iPushTime = cell->iPushTime;
+          AtomicStore(&cell->iSequence, iPos + iPtr + _iCapacity);
+          AddLatency(iNow - iPushTime);
+#else
+          AtomicStore(&cell->iSequence, iPos + iPtr + _iCapacity);
+#endif
+        }
+
+        /* the add acts as a full barrier, so a producer that started waiting before the slots were freed is seen */
+        if (m_policy == CEC_QUEUE_POLICY_BLOCK && AtomicAdd(&m_iWaiting, 0) > 0)
+        {
+          CLockObject lock(&m_mutex);
+          m_condition.Broadcast();
+        }
+
+        if (m_iHighWatermark > 0 && AtomicLoad(&m_iAboveWatermark) == 1 && Size() < (int) m_iHighWatermark)
+          AtomicCompareAndSwap(&m_iAboveWatermark, 1, 0);
+
+        return iPopped;
+      }
+
+    private:
+      CecBuffer(const CecBuffer &);
+      CecBuffer &operator=(const CecBuffer &);
+
+      /*!
+       * @brief Add an entry with the overflow policy of this buffer.
+       * @param entry A _BType that is moved, or a const entry that is copied into the slot with CecBufferStore().
+       */
+      template<typename _Entry>
+      bool PushEntry(_Entry &entry)
+      {
+        if (m_policy == CEC_QUEUE_POLICY_COALESCE)
+          return PushCoalesced(entry);
+
+        uint32_t iPos;
+        bool bPushed = TryPush(entry, iPos);
+        if (!bPushed && m_policy == CEC_QUEUE_POLICY_DROP_OLDEST)
+          bPushed = PushDropOldest(entry, iPos);
+        else if (!bPushed && m_policy == CEC_QUEUE_POLICY_BLOCK)
+          bPushed = PushBlocking(entry, iPos);
+
+        return Pushed(bPushed);
+      }
+
+      /*!
+       * @brief Claim the next free slot, store entry in it and give it its sequence number. entry is left untouched when the buffer is full.
+       * @return True when added, false when the buffer is full.
+       */
+      template<typename _Entry>
+      bool TryPush(_Entry &entry, uint32_t &iPos)
+      {
+        if (m_iLimit < _iCapacity && Size() >= (int) m_iLimit)
           return false;
 
-        m_buffer.push(entry);
+        Cell *cell;
+        uint32_t iRejected;
+        iPos = AtomicLoad(&m_iEnqueuePos);
+        for (;;)
+        {
+          /* read after the position, and so after the producer that claimed the previous slot read it */
+          iRejected = AtomicLoad(&m_iRejected);
+          cell = &m_cells[iPos & (_iCapacity - 1)];
+          int32_t iDiff = (int32_t) (AtomicLoad(&cell->iSequence) - iPos);
+          if (iDiff == 0)
+          {
+            if (AtomicCompareAndSwap(&m_iEnqueuePos, iPos, iPos + 1))
+              break;
+          }
+          else if (iDiff < 0)
+          {
+            /* the slot still holds the entry that was pushed one lap ago */
+            return false;
+          }
+          iPos = AtomicLoad(&m_iEnqueuePos);
+        }
+
+        CecBufferStore(cell->data, entry);
+        CecBufferSetSequence(cell->data, iPos + iRejected + 1);
+#if defined(CEC_QUEUE_STATISTICS)
+        cell->iPushTime = GetTimeUs();
+#endif
+        AtomicStore(&cell->iSequence, iPos + 1);
         return true;
       }
 
-      bool Pop(_BType &entry)
+      template<typename _Entry>
+      bool PushDropOldest(_Entry &entry, uint32_t &iPos)
       {
-        bool bReturn(false);
+        /* consumers and other producers race for the same slots, so give up after one lap */
+        for (unsigned int iTry = 0; iTry < _iCapacity; iTry++)
+        {
+          _BType oldest;
+          if (Pop(oldest))
+            AtomicAdd(&m_iDropped, 1);
+          if (TryPush(entry, iPos))
+            return true;
+        }
+        return false;
+      }
+
+      template<typename _Entry>
+      bool PushBlocking(_Entry &entry, uint32_t &iPos)
+      {
+        bool bPushed(false);
         CLockObject lock(&m_mutex);
-        if (m_buffer.size() > 0)
+        AtomicAdd(&m_iWaiting, 1);
+
+        int64_t iNow(GetTimeMs());
+        int64_t iTarget(iNow + m_iBlockTimeoutMs);
+        while (!(bPushed = TryPush(entry, iPos)) && m_policy == CEC_QUEUE_POLICY_BLOCK && iNow < iTarget)
         {
-          entry = m_buffer.front();
-          m_buffer.pop();
-          bReturn = true;
+          m_condition.Wait(&m_mutex, iTarget - iNow);
+          iNow = GetTimeMs();
         }
-        return bReturn;
+
+        AtomicAdd(&m_iWaiting, (uint32_t) -1);
+        return bPushed;
       }
 
-    private:
-      unsigned int       m_maxSize;
-      std::queue<_BType> m_buffer;
-      CMutex             m_mutex;
+      template<typename _Entry>
+      bool PushCoalesced(_Entry &entry)
+      {
+        CLockObject lock(&m_mutex);
+
+        /* the last entry is still queued when the consumers haven't passed its position yet */
+        if (m_bHaveLastEntry &&
+            (int32_t) (m_iLastEntryPos - AtomicLoad(&m_iDequeuePos)) >= 0 &&
+            CecBufferEquals(m_lastEntry, entry))
+        {
+          AtomicAdd(&m_iCoalesced, 1);
+          return true;
+        }
+
+        uint32_t iPos;
+        _BType lastEntry;
+        CecBufferStore(lastEntry, static_cast<const _Entry &>(entry));
+        bool bPushed = TryPush(entry, iPos);
+        if (bPushed)
+        {
+          CecBufferMove(m_lastEntry, lastEntry);
+          m_iLastEntryPos  = iPos;
+          m_bHaveLastEntry = true;
+        }
+
+        return Pushed(bPushed);
+      }
+
+      bool Pushed(bool bPushed)
+      {
+        if (!bPushed)
+        {
+          AtomicAdd(&m_iRejected, 1);
+          AtomicAdd(&m_iDropped, 1);
+          return false;
+        }
+
+        uint32_t iSize = (uint32_t) Size();
+        uint32_t iPeak = AtomicLoad(&m_iPeakSize);
+        while (iSize > iPeak && !AtomicCompareAndSwap(&m_iPeakSize, iPeak, iSize))
+          iPeak = AtomicLoad(&m_iPeakSize);
+
+        if (m_iHighWatermark > 0 && iSize >= m_iHighWatermark && AtomicCompareAndSwap(&m_iAboveWatermark, 0, 1))
+        {
+          cec_queue_watermark_cb callback = m_watermarkCallback;
+          if (callback)
+            callback(m_watermarkCallbackParam, iSize);
+        }
+
+        return true;
+      }
+
+#if defined(CEC_QUEUE_STATISTICS)
+      void AddLatency(int64_t iLatency)
+      {
+        uint32_t iLatencyUs = iLatency > 0xFFFFFFFF ? 0xFFFFFFFF : (iLatency < 0 ? 0 : (uint32_t) iLatency);
+        uint32_t iMax = AtomicLoad(&m_iLatencyMax);
+        while (iLatencyUs > iMax && !AtomicCompareAndSwap(&m_iLatencyMax, iMax, iLatencyUs))
+          iMax = AtomicLoad(&m_iLatencyMax);
+
+        unsigned int iBucket = 0;
+        while (iLatencyUs > 1 && iBucket < CEC_QUEUE_LATENCY_BUCKETS - 1)
+        {
+          iLatencyUs >>= 1;
+          ++iBucket;
+        }
+        AtomicAdd(&m_latencyHistogram[iBucket], 1);
+      }
+#endif
+
+      struct Cell
+      {
+        volatile uint32_t iSequence;
+#if defined(CEC_QUEUE_STATISTICS)
+        int64_t           iPushTime; /*!< when the entry was pushed, in microseconds */
+#endif
+        _BType            data;
+      };
+
+      /* keep the positions that producers and consumers write to on separate cache lines */
+      uint8_t                m_pad0[64];
+      Cell                   m_cells[_iCapacity];
+      uint8_t                m_pad1[64];
+      volatile uint32_t      m_iEnqueuePos;
+      uint8_t                m_pad2[64 - sizeof(uint32_t)];
+      volatile uint32_t      m_iDequeuePos;
+      uint8_t                m_pad3[64 - sizeof(uint32_t)];
+
+      cec_queue_policy       m_policy;
+      unsigned int           m_iLimit;
+      unsigned int           m_iBlockTimeoutMs;
+      unsigned int           m_iHighWatermark;
+      cec_queue_watermark_cb m_watermarkCallback;
+      void *                 m_watermarkCallbackParam;
+      volatile uint32_t      m_iAboveWatermark;
+      volatile uint32_t      m_iPeakSize;
+      volatile uint32_t      m_iDropped;
+      volatile uint32_t      m_iCoalesced;
+      volatile uint32_t      m_iRejected;   /*!< entries that were dropped without getting a slot */
+      volatile uint32_t      m_iWaiting;
+#if defined(CEC_QUEUE_STATISTICS)
+      volatile uint32_t      m_iLatencyMax;
+      volatile uint32_t      m_latencyHistogram[CEC_QUEUE_LATENCY_BUCKETS];
+#endif
+      bool                   m_bHaveLastEntry;
+      uint32_t               m_iLastEntryPos;
+      _BType                 m_lastEntry;
+      CMutex                 m_mutex;
+      CCondition             m_condition;
     };
 };
@@ -0,0 +1,1549 @@
+/*
+ * This file is part of the libCEC(R) library.
+ *
+ * libCEC(R) is Copyright (C) 2011 Pulse-Eight Limited.  All rights reserved.
+ * libCEC(R) is an original work, containing original code.
+ *
+ * libCEC(R) is a trademark of Pulse-Eight Limited.
+ *
+ * This program is dual-licensed; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *
+ * Alternatively, you can license this library under a commercial license,
+ * please contact Pulse-Eight Licensing for more information.
+ *
+ * For more information contact:
+ * Pulse-Eight Licensing       <license@pulse-eight.com>
+ *     http://www.pulse-eight.com/
+ *     http://www.pulse-eight.net/
+ */
+
+/*
+ * Runs libCEC against an emulated adapter on a pseudo terminal, so the library can be measured
+ * without hardware and with more traffic than a real CEC bus carries.
+ */
+
+#include "../../include/CECExports.h"
+#include "../../include/CECTypes.h"
+#include "../lib/AdapterDetection.h"
+#include "../lib/LibCEC.h"
+#include "../lib/platform/threads.h"
+#include "../lib/platform/timeutils.h"
+#include "../lib/util/StdString.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <iostream>
+#include <limits.h>
+#include <malloc.h>
+#include <new>
+#include <poll.h>
+#include <queue>
+#include <sched.h>
+#include <string>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace CEC;
+using namespace std;
+
+#define CEC_BENCH_START_DELAY  1000
+#define CEC_BENCH_MAX_OUTPUT   (64 * 1024)
+#define CEC_BENCH_NOISE_FRAMES 50
+#define CEC_BENCH_VID          0x2548
+#define CEC_BENCH_PID          0x1001
+#define CEC_BENCH_REALTIME_PRIORITY 50
+
+/* the frames that the emulated adapter receives from the bus, in hex. libCEC uses logical address 4 */
+static const char *g_mixes[][2] =
+{
+  { "power",  "0f9000" },                       /* REPORT_POWER_STATUS, broadcast */
+  { "direct", "049000" },                       /* REPORT_POWER_STATUS to libCEC */
+  { "keys",   "044401 044401 044401 0445" },    /* a repeated key press and its release */
+  { "escape", "0447fdfefffdfefffdfefffdfeff" }, /* SET_OSD_NAME, every byte of the name escaped */
+  { "other",  "059000 0836 0b4401" }            /* frames for other devices */
+};
+
+/* the frame that is used to measure the time it takes libCEC to hand a frame to a command handler: VENDOR_COMMAND to libCEC */
+static const char *g_strProbe = "048900";
+
+class CAdapterEmulator : public CThread
+{
+public:
+  CAdapterEmulator(void);
+  virtual ~CAdapterEmulator(void);
+
+  bool Open(void);
+  string GetPort(void) const { return m_strPort; }
+  void SetLoad(const vector<cec_frame> &frames, unsigned int iRate, unsigned int iSeconds, bool bNoise = false);
+  void GetCounters(uint64_t &iFramesSent, uint64_t &iTransmissions);
+  void FrameReceived(void);
+  void GetLatencies(vector<int64_t> &latencies);
+  void *Process(void);
+
+private:
+  void PushEscaped(uint8_t iByte);
+  void PushMessage(uint8_t iCode, const uint8_t *data, unsigned int iSize);
+  void PushFrame(const cec_frame &frame);
+  void ReadMessages(void);
+  void Reply(const cec_frame &message);
+
+  int               m_iMaster;
+  int               m_iSlave;
+  string            m_strPort;
+  vector<cec_frame> m_frames;
+  unsigned int      m_iRate;
+  bool              m_bNoise;
+  int64_t           m_iStartTime;
+  int64_t           m_iEndTime;
+  uint64_t          m_iFramesSent;
+  uint64_t          m_iTransmissions;
+  int64_t           m_iLastFrameTime; /*!< when the last frame was sent, in microseconds */
+  vector<int64_t>   m_latencies;
+  cec_frame         m_input;
+  cec_frame         m_output;
+  cec_frame         m_message; /*!< the message that is read from libCEC */
+  CMutex            m_mutex;
+};
+
+CAdapterEmulator::CAdapterEmulator(void) :
+    CThread("cec-emulator"),
+    m_iMaster(-1),
+    m_iSlave(-1),
+    m_iRate(0),
+    m_bNoise(false),
+    m_iStartTime(0),
+    m_iEndTime(0),
+    m_iFramesSent(0),
+    m_iTransmissions(0),
+    m_iLastFrameTime(0),
+    m_mutex("emulator")
+{
+  //the buffers are allocated up front, so the allocations that the benchmarks count are libCEC's
+  m_input.reserve(CEC_BENCH_MAX_OUTPUT);
+  m_output.reserve(CEC_BENCH_MAX_OUTPUT + 1024);
+  m_message.reserve(CEC_BENCH_MAX_OUTPUT);
+}
+
+CAdapterEmulator::~CAdapterEmulator(void)
+{
+  StopThread();
+  if (m_iSlave != -1)
+    close(m_iSlave);
+  if (m_iMaster != -1)
+    close(m_iMaster);
+}
+
+bool CAdapterEmulator::Open(void)
+{
+  if ((m_iMaster = posix_openpt(O_RDWR | O_NOCTTY)) == -1 || grantpt(m_iMaster) != 0 || unlockpt(m_iMaster) != 0)
+    return false;
+
+  m_strPort = ptsname(m_iMaster);
+
+  //keep the slave open, so the master doesn't report a hangup while libCEC reopens the port
+  struct termios options;
+  if ((m_iSlave = open(m_strPort.c_str(), O_RDWR | O_NOCTTY)) == -1 || tcgetattr(m_iSlave, &options) != 0)
+    return false;
+  cfmakeraw(&options);
+  if (tcsetattr(m_iSlave, TCSANOW, &options) != 0)
+    return false;
+
+  fcntl(m_iMaster, F_SETFL, fcntl(m_iMaster, F_GETFL, 0) | O_NONBLOCK);
+  return CreateThread();
+}
+
+void CAdapterEmulator::SetLoad(const vector<cec_frame> &frames, unsigned int iRate, unsigned int iSeconds, bool bNoise /* = false */)
+{
+  CLockObject lock(&m_mutex);
+  m_frames     = frames;
+  m_iRate      = iRate;
+  m_bNoise     = bNoise;
+  m_iStartTime = GetTimeMs() + CEC_BENCH_START_DELAY;
+  m_iEndTime   = m_iStartTime + (int64_t) iSeconds * 1000;
+}
+
+void CAdapterEmulator::GetCounters(uint64_t &iFramesSent, uint64_t &iTransmissions)
+{
+  CLockObject lock(&m_mutex);
+  iFramesSent    = m_iFramesSent;
+  iTransmissions = m_iTransmissions;
+}
+
+void CAdapterEmulator::FrameReceived(void)
+{
+  CLockObject lock(&m_mutex);
+  m_latencies.push_back(GetTimeUs() - m_iLastFrameTime);
+}
+
+void CAdapterEmulator::GetLatencies(vector<int64_t> &latencies)
+{
+  CLockObject lock(&m_mutex);
+  latencies.insert(latencies.end(), m_latencies.begin(), m_latencies.end());
+  m_latencies.clear();
+}
+
+void CAdapterEmulator::PushEscaped(uint8_t iByte)
+{
+  if (iByte >= MSGESC)
+  {
+    m_output.push_back(MSGESC);
+    m_output.push_back(iByte - ESCOFFSET);
+  }
+  else
+  {
+    m_output.push_back(iByte);
+  }
+}
+
+void CAdapterEmulator::PushMessage(uint8_t iCode, const uint8_t *data, unsigned int iSize)
+{
+  m_output.push_back(MSGSTART);
+  PushEscaped(iCode);
+  for (unsigned int iPtr = 0; iPtr < iSize; iPtr++)
+    PushEscaped(data[iPtr]);
+  m_output.push_back(MSGEND);
+}
+
+void CAdapterEmulator::PushFrame(const cec_frame &frame)
+{
+  for (unsigned int iPtr = 0; iPtr < frame.size(); iPtr++)
+  {
+    uint8_t iCode = iPtr == 0 ? MSGCODE_FRAME_START : MSGCODE_FRAME_DATA;
+    if (iPtr == frame.size() - 1)
+      iCode |= MSGCODE_FRAME_EOM;
+    PushMessage(iCode, &frame[iPtr], 1);
+  }
+}
+
+void CAdapterEmulator::Reply(const cec_frame &message)
+{
+  //every command is accepted. transmissions are acked by the bus, and the firmware supports pipelined transmissions
+  if (message[0] == MSGCODE_FIRMWARE_VERSION)
+  {
+    uint8_t version[2] = { 0, 2 };
+    PushMessage(MSGCODE_FIRMWARE_VERSION, version, 2);
+    return;
+  }
+
+  PushMessage(MSGCODE_COMMAND_ACCEPTED, NULL, 0);
+  if (message[0] == MSGCODE_TRANSMIT_EOM)
+  {
+    PushMessage(MSGCODE_TRANSMIT_SUCCEEDED, NULL, 0);
+    ++m_iTransmissions;
+  }
+}
+
+void CAdapterEmulator::ReadMessages(void)
+{
+  uint8_t buff[1024];
+  ssize_t iRead;
+  while ((iRead = read(m_iMaster, buff, sizeof(buff))) > 0)
+    m_input.insert(m_input.end(), buff, buff + iRead);
+
+  //libCEC doesn't escape MSGSTART, so it only starts a message outside of one
+  cec_frame &message = m_message;
+  message.clear();
+  unsigned int iStart(0);
+  bool bInMessage(false);
+  for (unsigned int iPtr = 0; iPtr < m_input.size(); iPtr++)
+  {
+    if (m_input[iPtr] == MSGSTART && !bInMessage)
+    {
+      message.clear();
+      bInMessage = true;
+    }
+    else if (m_input[iPtr] == MSGEND)
+    {
+      if (!message.empty())
+        Reply(message);
+      message.clear();
+      bInMessage = false;
+      iStart = iPtr + 1;
+    }
+    else if (m_input[iPtr] == MSGESC && iPtr + 1 < m_input.size())
+    {
+      message.push_back(m_input[++iPtr] + ESCOFFSET);
+    }
+    else if (m_input[iPtr] != MSGESC)
+    {
+      message.push_back(m_input[iPtr]);
+    }
+  }
+  m_input.erase(m_input.begin(), m_input.begin() + iStart);
+}
+
+void *CAdapterEmulator::Process(void)
+{
+  while (!m_bStop)
+  {
+    //wake up when the next frame is due, and at least every 20 ms to check whether the emulator has to stop
+    int iTimeout(20);
+    bool bOutput;
+    {
+      CLockObject lock(&m_mutex);
+      int64_t iNow = GetTimeMs();
+      if (!m_frames.empty() && iNow >= m_iStartTime && iNow < m_iEndTime)
+      {
+        //the frames that are due are sent in one go. when libCEC doesn't keep up, the output is capped like the bus would be
+        uint64_t iDue = (uint64_t) (iNow - m_iStartTime) * m_iRate / 1000;
+        while (m_iFramesSent < iDue && m_output.size() < CEC_BENCH_MAX_OUTPUT)
+        {
+          PushFrame(m_frames[m_iFramesSent++ % m_frames.size()]);
+          m_iLastFrameTime = GetTimeUs();
+
+          //line noise, bytes outside of a message like a device at the wrong baud rate would send
+          if (m_bNoise && m_iFramesSent % CEC_BENCH_NOISE_FRAMES == 0)
+            for (uint8_t iByte = 0x20; iByte < 0x60; iByte++)
+              m_output.push_back(iByte);
+        }
+      }
+
+      ReadMessages();
+
+      if (!m_output.empty())
+      {
+        ssize_t iWritten = write(m_iMaster, &m_output[0], m_output.size());
+        if (iWritten > 0)
+          m_output.erase(m_output.begin(), m_output.begin() + iWritten);
+      }
+      bOutput = !m_output.empty();
+
+      if (!m_frames.empty() && m_iRate > 0 && iNow < m_iEndTime)
+      {
+        int64_t iNext = iNow < m_iStartTime ? m_iStartTime : m_iStartTime + (int64_t) ((m_iFramesSent + 1) * 1000 / m_iRate);
+        if (iNext - iNow < iTimeout)
+          iTimeout = iNext > iNow ? (int) (iNext - iNow) : 1;
+      }
+    }
+
+    struct pollfd pfd;
+    pfd.fd      = m_iMaster;
+    pfd.events  = POLLIN | (bOutput ? POLLOUT : 0);
+    pfd.revents = 0;
+    poll(&pfd, 1, iTimeout);
+  }
+
+  return NULL;
+}
+
+static void get_frames(const char *strFrames, vector<cec_frame> &frames)
+{
+  cec_frame frame;
+  for (const char *strData = strFrames; ; strData += 2)
+  {
+    unsigned int iByte;
+    if (*strData != '\0' && *strData != ' ' && sscanf(strData, "%2x", &iByte) == 1)
+    {
+      frame.push_back((uint8_t) iByte);
+      continue;
+    }
+
+    frames.push_back(frame);
+    frame.clear();
+    if (*strData == '\0')
+      break;
+    --strData;
+  }
+}
+
+static bool get_mix(const string &strMix, vector<cec_frame> &frames)
+{
+  for (unsigned int iMix = 0; iMix < sizeof(g_mixes) / sizeof(g_mixes[0]); iMix++)
+  {
+    if (strMix == "all" || strMix == g_mixes[iMix][0])
+      get_frames(g_mixes[iMix][1], frames);
+  }
+
+  return !frames.empty();
+}
+
+static bool handle_probe(void *param, const cec_command *)
+{
+  ((CAdapterEmulator *) param)->FrameReceived();
+  return true;
+}
+
+static double get_percentile(vector<int64_t> &values, double fFraction)
+{
+  if (values.empty())
+    return 0;
+  sort(values.begin(), values.end());
+  size_t iPtr = (size_t) (fFraction * (values.size() - 1));
+  return (double) values[iPtr];
+}
+
+/*
+ * Counts the threads that libCEC created, and the cpu time they used in nanoseconds. All of libCEC's threads have a name
+ * that starts with "cec-".
+ */
+static void get_library_threads(unsigned int &iThreads, uint64_t &iCpuTime)
+{
+  iThreads = 0;
+  iCpuTime = 0;
+
+  DIR *dir;
+  if ((dir = opendir("/proc/self/task")) == NULL)
+    return;
+
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL)
+  {
+    if (dirent->d_name[0] == '.')
+      continue;
+
+    char strName[32] = "";
+    CStdString strPath;
+    strPath.Format("/proc/self/task/%s/comm", dirent->d_name);
+    FILE *file = fopen(strPath.c_str(), "r");
+    if (file)
+    {
+      if (!fgets(strName, sizeof(strName), file))
+        strName[0] = '\0';
+      fclose(file);
+    }
+    strName[strcspn(strName, "\n")] = '\0';
+    if (strncmp(strName, "cec-", 4) || !strcmp(strName, "cec-emulator") || !strcmp(strName, "cec-bench"))
+      continue;
+
+    //schedstat starts with the time spent on the cpu. the times in stat are in clock ticks, too coarse for idle threads
+    ++iThreads;
+    strPath.Format("/proc/self/task/%s/schedstat", dirent->d_name);
+    if ((file = fopen(strPath.c_str(), "r")) != NULL)
+    {
+      unsigned long long iTime;
+      if (fscanf(file, "%llu", &iTime) == 1)
+        iCpuTime += iTime;
+      fclose(file);
+    }
+  }
+
+  closedir(dir);
+}
+
+static bool run_reactor_step(unsigned int iAdapters, bool bShared, unsigned int iRate, unsigned int iSeconds)
+{
+  vector<CAdapterEmulator *> emulators;
+  vector<ICECAdapter *> adapters;
+  bool bReturn(true);
+  for (unsigned int iPtr = 0; bReturn && iPtr < iAdapters; iPtr++)
+  {
+    CAdapterEmulator *emulator = new CAdapterEmulator;
+    emulators.push_back(emulator);
+    ICECAdapter *adapter = emulator->Open() ? LoadLibCec("CEC Bench") : NULL;
+    if (adapter)
+      adapters.push_back(adapter);
+
+    bReturn = adapter && adapter->UseSharedReactor(bShared) &&
+        adapter->SetCommandHandler(CEC_OPCODE_VENDOR_COMMAND, handle_probe, emulator) &&
+        adapter->Open(emulator->GetPort().c_str());
+  }
+
+  if (!bReturn)
+  {
+    cout << "could not open " << iAdapters << " emulated adapters" << endl;
+  }
+  else
+  {
+    vector<cec_frame> frames;
+    get_frames(g_strProbe, frames);
+    for (unsigned int iPtr = 0; iPtr < emulators.size(); iPtr++)
+      emulators[iPtr]->SetLoad(frames, iRate, iSeconds);
+
+    //measure the threads and cpu time while the probes are being sent, after the connections settled down
+    CCondition::Sleep(CEC_BENCH_START_DELAY);
+    unsigned int iThreads;
+    uint64_t iStartTime, iEndTime;
+    int64_t iStart = GetTimeUs();
+    get_library_threads(iThreads, iStartTime);
+    CCondition::Sleep(iSeconds * 1000);
+    get_library_threads(iThreads, iEndTime);
+    double fCpu = (double) (iEndTime - iStartTime) / 10 / (GetTimeUs() - iStart);
+
+    vector<int64_t> latencies;
+    for (unsigned int iPtr = 0; iPtr < emulators.size(); iPtr++)
+      emulators[iPtr]->GetLatencies(latencies);
+    size_t iFrames = latencies.size();
+    double fP50 = get_percentile(latencies, 0.5), fP99 = get_percentile(latencies, 0.99), fMax = get_percentile(latencies, 1);
+
+    CStdString strResult;
+    strResult.Format("%8u %-10s %8u %7.1f%% %8u %10.0f %10.0f %10.0f", iAdapters, bShared ? "shared" : "dedicated", iThreads, fCpu,
+        (unsigned int) iFrames, fP50, fP99, fMax);
+    cout << strResult.c_str() << endl;
+  }
+
+  for (unsigned int iPtr = 0; iPtr < adapters.size(); iPtr++)
+    UnloadLibCec(adapters[iPtr]);
+  for (unsigned int iPtr = 0; iPtr < emulators.size(); iPtr++)
+    delete emulators[iPtr];
+  return bReturn;
+}
+
+static int run_reactor(unsigned int iMaxAdapters, unsigned int iRate, unsigned int iSeconds)
+{
+  cout << "adapters mode        threads     cpu   frames   p50 (us)   p99 (us)   max (us)" << endl;
+  for (unsigned int iAdapters = 1; iAdapters <= iMaxAdapters; iAdapters = iAdapters < iMaxAdapters && iAdapters * 4 > iMaxAdapters ? iMaxAdapters : iAdapters * 4)
+  {
+    if (!run_reactor_step(iAdapters, false, iRate, iSeconds) || !run_reactor_step(iAdapters, true, iRate, iSeconds))
+      return 1;
+    if (iAdapters == iMaxAdapters)
+      break;
+  }
+  return 0;
+}
+
+/*
+ * A thread that keeps a CPU busy, like another process that competes with libCEC for the CPU.
+ */
+class CCpuHog : public CThread
+{
+public:
+  CCpuHog(void) : CThread("cec-bench-hog"), m_bHogging(true), m_iLoops(0) {}
+
+  bool StopThread(bool bWaitForExit = true)
+  {
+    //m_bStop isn't volatile, and this loop doesn't call anything that would make the compiler read it again
+    m_bHogging = false;
+    return CThread::StopThread(bWaitForExit);
+  }
+
+  void *Process(void)
+  {
+    while (m_bHogging)
+      m_iLoops++;
+    return NULL;
+  }
+
+private:
+  volatile bool     m_bHogging;
+  volatile uint64_t m_iLoops;
+};
+
+static cec_thread_config get_realtime_config(int iPriority)
+{
+  //libCEC's threads run on the last CPU, which the hogs share with them
+  long iCpus = sysconf(_SC_NPROCESSORS_ONLN);
+  cec_thread_config config;
+  memset(&config, 0, sizeof(config));
+  config.policy       = CEC_THREAD_POLICY_FIFO;
+  config.priority     = iPriority;
+  config.cpu_affinity = (uint64_t) 1 << (iCpus > 0 && iCpus <= 64 ? iCpus - 1 : 0);
+  return config;
+}
+
+static bool run_jitter_step(const char *strName, unsigned int iHogs, bool bRealtime, unsigned int iRate, unsigned int iSeconds)
+{
+  CAdapterEmulator emulator;
+  ICECAdapter *parser = emulator.Open() ? LoadLibCec("CEC Bench") : NULL;
+  if (!parser)
+  {
+    cout << "could not create the emulated adapter" << endl;
+    return false;
+  }
+
+  //the emulator stands in for the adapter, so it runs above everything else in every step and only libCEC's threads are measured
+  bool bReturn = emulator.SetThreadConfig(get_realtime_config(CEC_BENCH_REALTIME_PRIORITY + 1));
+  if (!bReturn)
+    cout << "could not make the emulator a SCHED_FIFO thread. run the benchmark as root or with CAP_SYS_NICE" << endl;
+  if (bReturn && bRealtime)
+  {
+    cec_thread_config config = get_realtime_config(CEC_BENCH_REALTIME_PRIORITY);
+    bReturn = parser->SetThreadConfig(CEC_THREAD_READER, config) && parser->SetThreadConfig(CEC_THREAD_PROCESSOR, config);
+    if (!bReturn)
+      cout << "could not configure libCEC's threads" << endl;
+  }
+  if (bReturn && (!parser->SetCommandHandler(CEC_OPCODE_VENDOR_COMMAND, handle_probe, &emulator) || !parser->Open(emulator.GetPort().c_str())))
+  {
+    cout << "unable to open the emulated adapter on port " << emulator.GetPort() << endl;
+    bReturn = false;
+  }
+
+  if (bReturn)
+  {
+    vector<CCpuHog *> hogs;
+    for (unsigned int iPtr = 0; iPtr < iHogs; iPtr++)
+    {
+      hogs.push_back(new CCpuHog);
+      hogs.back()->CreateThread();
+    }
+
+    vector<cec_frame> frames;
+    get_frames(g_strProbe, frames);
+    CCondition::Sleep(CEC_BENCH_START_DELAY);
+    emulator.SetLoad(frames, iRate, iSeconds);
+    CCondition::Sleep(iSeconds * 1000 + 100);
+
+    for (unsigned int iPtr = 0; iPtr < hogs.size(); iPtr++)
+    {
+      hogs[iPtr]->StopThread();
+      delete hogs[iPtr];
+    }
+
+    vector<int64_t> latencies;
+    emulator.GetLatencies(latencies);
+    size_t iFrames = latencies.size();
+    double fP50 = get_percentile(latencies, 0.5), fP99 = get_percentile(latencies, 0.99), fMax = get_percentile(latencies, 1);
+
+    CStdString strResult;
+    strResult.Format("%-24s %6u %8u %10.0f %10.0f %10.0f", strName, iHogs, (unsigned int) iFrames, fP50, fP99, fMax);
+    cout << strResult.c_str() << endl;
+  }
+
+  UnloadLibCec(parser);
+  return bReturn;
+}
+
+static int run_jitter(unsigned int iHogs, unsigned int iRate, unsigned int iSeconds)
+{
+  cout << "threads                    hogs   frames   p50 (us)   p99 (us)   max (us)" << endl;
+  bool bReturn = run_jitter_step("default, idle", 0, false, iRate, iSeconds) &&
+      run_jitter_step("default", iHogs, false, iRate, iSeconds) &&
+      run_jitter_step("SCHED_FIFO and affinity", iHogs, true, iRate, iSeconds);
+  return bReturn ? 0 : 1;
+}
+
+static unsigned int get_latency_percentile(const cec_queue_statistics &stats, float fFraction)
+{
+  uint64_t iTotal(0), iCount(0);
+  for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+    iTotal += stats.latency_histogram[iPtr];
+
+  for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+  {
+    iCount += stats.latency_histogram[iPtr];
+    if (iTotal > 0 && iCount >= fFraction * iTotal)
+      return iPtr + 1 < CEC_QUEUE_LATENCY_BUCKETS ? 2u << iPtr : stats.latency_max;
+  }
+  return 0;
+}
+
+static int run_load(ICECAdapter *parser, CAdapterEmulator &emulator, const string &strMix, unsigned int iRate, unsigned int iSeconds, unsigned int iInterval)
+{
+  vector<cec_frame> frames;
+  if (!get_mix(strMix, frames))
+  {
+    cout << "unknown mix '" << strMix << "'" << endl;
+    return 1;
+  }
+
+  cec_queue_statistics before[CEC_QUEUE_ADAPTER_EVENT + 1];
+  for (int iQueue = CEC_QUEUE_LOG; iQueue <= CEC_QUEUE_ADAPTER_EVENT; iQueue++)
+    parser->GetQueueStatistics((cec_queue) iQueue, &before[iQueue]);
+
+  //the application reads its queues every iInterval ms, like a main loop would
+  emulator.SetLoad(frames, iRate, iSeconds);
+  cec_command commands[64];
+  cec_keypress keys[64];
+  cec_log_message logs[64];
+  uint64_t iCommands(0), iKeys(0);
+  int64_t iEndTime = GetTimeMs() + CEC_BENCH_START_DELAY + (int64_t) iSeconds * 1000 + 1000;
+  while (GetTimeMs() < iEndTime)
+  {
+    unsigned int iRead;
+    while ((iRead = parser->GetNextCommands(commands, 64)) > 0)
+      iCommands += iRead;
+    while ((iRead = parser->GetNextKeypresses(keys, 64)) > 0)
+      iKeys += iRead;
+    while (parser->GetNextLogMessages(logs, 64) > 0) {}
+    CCondition::Sleep(iInterval);
+  }
+
+  uint64_t iFramesSent, iTransmissions;
+  emulator.GetCounters(iFramesSent, iTransmissions);
+  CStdString strResult;
+  strResult.Format("sent %llu frames of mix '%s' in %u s, read %llu commands and %llu key presses",
+      (unsigned long long) iFramesSent, strMix.c_str(), iSeconds, (unsigned long long) iCommands, (unsigned long long) iKeys);
+  cout << strResult.c_str() << endl;
+
+  bool bLatency(false);
+  const char *strQueues[] = { "log", "keypress", "command", "adapter event" };
+  for (int iQueue = CEC_QUEUE_LOG; iQueue <= CEC_QUEUE_ADAPTER_EVENT; iQueue++)
+  {
+    cec_queue_statistics stats;
+    parser->GetQueueStatistics((cec_queue) iQueue, &stats);
+    for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+      stats.latency_histogram[iPtr] -= before[iQueue].latency_histogram[iPtr];
+    bLatency |= stats.latency_max > 0;
+
+    CStdString strQueue;
+    strQueue.Format("%s queue: pushed %u dropped %u peak %u latency (us) p50 <%u p99 <%u max %u",
+        strQueues[iQueue], stats.pushed - before[iQueue].pushed, stats.dropped - before[iQueue].dropped, stats.peak_size,
+        get_latency_percentile(stats, 0.5), get_latency_percentile(stats, 0.99), stats.latency_max);
+    cout << strQueue.c_str() << endl;
+  }
+
+  if (!bLatency)
+    cout << "the latencies are only recorded when libCEC is built with --enable-queue-statistics" << endl;
+  return 0;
+}
+
+/*
+ * Fills the buffer and drains it again, iEntries times in total, and returns the time the draining took in nanoseconds per
+ * entry. A batch size of 0 drains with Pop() for a single entry.
+ */
+template<typename _BType>
+static double get_drain_time(const _BType &entry, unsigned int iEntries, unsigned int iBatch)
+{
+  CecBuffer<_BType> buffer;
+  vector<_BType> entries(iBatch > 0 ? iBatch : 1);
+  _BType pushed;
+  int64_t iTime(0);
+  for (unsigned int iDrained = 0; iDrained < iEntries;)
+  {
+    while (buffer.Size() < (int) buffer.Capacity())
+    {
+      pushed = entry;
+      buffer.PushMove(pushed);
+    }
+
+    int64_t iStart = GetTimeUs();
+    unsigned int iPopped;
+    if (iBatch == 0)
+    {
+      while (buffer.Pop(entries[0]))
+        iDrained++;
+    }
+    else
+    {
+      while ((iPopped = buffer.Pop(&entries[0], iBatch)) > 0)
+        iDrained += iPopped;
+    }
+    iTime += GetTimeUs() - iStart;
+  }
+
+  return (double) iTime * 1000 / iEntries;
+}
+
+static int run_drain(unsigned int iEntries)
+{
+  cec_log_message message;
+  message.level    = CEC_LOG_DEBUG;
+  message.message  = "received frame: initiator: 0 destination: 4 data: 90 00";
+  message.sequence = 0;
+
+  cec_command command;
+  command.source      = CECDEVICE_TV;
+  command.destination = CECDEVICE_PLAYBACKDEVICE1;
+  command.opcode      = CEC_OPCODE_REPORT_POWER_STATUS;
+  command.parameters.push_back(CEC_POWER_STATUS_ON);
+  command.sequence    = 0;
+
+  unsigned int iBatches[] = { 0, 1, 4, 16, 64 };
+  double fLogSingle(0), fCommandSingle(0);
+  bool bFaster(true);
+  cout << "batch     log (ns/entry)   command (ns/entry)" << endl;
+  for (unsigned int iPtr = 0; iPtr < sizeof(iBatches) / sizeof(iBatches[0]); iPtr++)
+  {
+    double fLog     = get_drain_time(message, iEntries, iBatches[iPtr]);
+    double fCommand = get_drain_time(command, iEntries, iBatches[iPtr]);
+
+    CStdString strBatch, strResult;
+    if (iBatches[iPtr] == 0)
+    {
+      strBatch       = "single";
+      fLogSingle     = fLog;
+      fCommandSingle = fCommand;
+    }
+    else
+    {
+      strBatch.Format("%u", iBatches[iPtr]);
+    }
+    strResult.Format("%-8s %15.1f %20.1f", strBatch.c_str(), fLog, fCommand);
+    cout << strResult.c_str() << endl;
+
+    /* batches claim their entries at once, so they have to be faster than popping every entry on its own */
+    if (iBatches[iPtr] >= 16 && (fLog >= fLogSingle || fCommand >= fCommandSingle))
+      bFaster = false;
+  }
+
+  cout << (bFaster ? "batches are faster than single pops" : "batches aren't faster than single pops") << endl;
+  return bFaster ? 0 : 1;
+}
+
+/*
+ * The buffer that libCEC used before CecBuffer became lock-free: a queue that every producer and consumer locks.
+ */
+template<typename _BType, unsigned int _iCapacity = 128>
+class CMutexBuffer
+{
+public:
+  CMutexBuffer(void) : m_mutex("mutex buffer") {}
+
+  bool Push(const _BType &entry)
+  {
+    CLockObject lock(&m_mutex);
+    if (m_buffer.size() >= _iCapacity)
+      return false;
+
+    m_buffer.push(entry);
+    return true;
+  }
+
+  bool Pop(_BType &entry)
+  {
+    CLockObject lock(&m_mutex);
+    if (m_buffer.empty())
+      return false;
+
+    entry = m_buffer.front();
+    m_buffer.pop();
+    return true;
+  }
+
+private:
+  queue<_BType> m_buffer;
+  CMutex        m_mutex;
+};
+
+template<typename _Buffer>
+class CContentionThread : public CThread
+{
+public:
+  CContentionThread(_Buffer &buffer, const cec_command &command, bool bProducer) :
+    CThread(bProducer ? "cec-bench-push" : "cec-bench-pop"),
+    m_buffer(buffer),
+    m_command(command),
+    m_bProducer(bProducer),
+    m_iOperations(0) {}
+
+  uint64_t GetOperations(void) const { return m_iOperations; }
+
+  void *Process(void)
+  {
+    cec_command command;
+    while (!m_bStop)
+    {
+      //give the other side the CPU when the buffer is full or empty, instead of spinning until the time slice ends
+      if (m_bProducer ? m_buffer.Push(m_command) : m_buffer.Pop(command))
+        m_iOperations++;
+      else
+        sched_yield();
+    }
+    return NULL;
+  }
+
+private:
+  _Buffer           &m_buffer;
+  const cec_command &m_command;
+  bool               m_bProducer;
+  uint64_t           m_iOperations;
+};
+
+/*
+ * Runs iProducers threads that push commands and iConsumers threads that pop them on one buffer, and returns the
+ * number of commands that were popped per second.
+ */
+template<typename _Buffer>
+static double get_contention_rate(const cec_command &command, unsigned int iProducers, unsigned int iConsumers, unsigned int iSeconds)
+{
+  _Buffer buffer;
+  vector<CContentionThread<_Buffer> *> threads;
+  for (unsigned int iPtr = 0; iPtr < iProducers + iConsumers; iPtr++)
+    threads.push_back(new CContentionThread<_Buffer>(buffer, command, iPtr < iProducers));
+
+  int64_t iStart = GetTimeUs();
+  for (unsigned int iPtr = 0; iPtr < threads.size(); iPtr++)
+    threads[iPtr]->CreateThread();
+
+  CCondition::Sleep(iSeconds * 1000);
+
+  uint64_t iPopped(0);
+  for (unsigned int iPtr = 0; iPtr < threads.size(); iPtr++)
+  {
+    threads[iPtr]->StopThread();
+    if (iPtr >= iProducers)
+      iPopped += threads[iPtr]->GetOperations();
+    delete threads[iPtr];
+  }
+
+  return (double) iPopped * 1000000 / (GetTimeUs() - iStart);
+}
+
+static int run_contention(unsigned int iProducers, unsigned int iConsumers, unsigned int iSeconds)
+{
+  cec_command command;
+  command.source      = CECDEVICE_TV;
+  command.destination = CECDEVICE_PLAYBACKDEVICE1;
+  command.opcode      = CEC_OPCODE_REPORT_POWER_STATUS;
+  command.parameters.push_back(CEC_POWER_STATUS_ON);
+  command.sequence    = 0;
+
+  unsigned int iSteps[][2] = { { 1, 1 }, { 1, iConsumers }, { iProducers, 1 }, { iProducers, iConsumers } };
+  cout << "producers consumers   lock-free (ops/s)   mutex (ops/s)" << endl;
+  for (unsigned int iPtr = 0; iPtr < sizeof(iSteps) / sizeof(iSteps[0]); iPtr++)
+  {
+    CStdString strResult;
+    strResult.Format("%9u %9u %19.0f %15.0f", iSteps[iPtr][0], iSteps[iPtr][1],
+        get_contention_rate<CecBuffer<cec_command> >(command, iSteps[iPtr][0], iSteps[iPtr][1], iSeconds),
+        get_contention_rate<CMutexBuffer<cec_command> >(command, iSteps[iPtr][0], iSteps[iPtr][1], iSeconds));
+    cout << strResult.c_str() << endl;
+  }
+  return 0;
+}
+
+static bool write_file(const CStdString &strPath, const char *strContent)
+{
+  FILE *file = fopen(strPath.c_str(), "w");
+  if (!file)
+    return false;
+  bool bReturn = fputs(strContent, file) >= 0;
+  return fclose(file) == 0 && bReturn;
+}
+
+static bool make_device(const CStdString &strPath)
+{
+  return mkdir(strPath.c_str(), 0755) == 0 && write_file(strPath + "/uevent", "");
+}
+
+/*
+ * Builds a sysfs tree under strRoot with iUsbDevices usb serial devices, of which the first iAdapters are CEC adapters,
+ * iOtherDevices devices without a serial port and 64 virtual terminals, laid out like the kernel does.
+ */
+static bool make_sysfs(const CStdString &strRoot, unsigned int iUsbDevices, unsigned int iAdapters, unsigned int iOtherDevices)
+{
+  CStdString strUsb(strRoot + "/devices/usb1");
+  CStdString strVirtual(strRoot + "/devices/virtual");
+  if (mkdir((strRoot + "/devices").c_str(), 0755) != 0 || !make_device(strUsb) ||
+      mkdir(strVirtual.c_str(), 0755) != 0 || mkdir((strVirtual + "/tty").c_str(), 0755) != 0 ||
+      mkdir((strVirtual + "/input").c_str(), 0755) != 0 ||
+      mkdir((strRoot + "/class").c_str(), 0755) != 0 || mkdir((strRoot + "/class/tty").c_str(), 0755) != 0)
+    return false;
+
+  for (unsigned int iPtr = 0; iPtr < 64; iPtr++)
+  {
+    CStdString strTty, strLink;
+    strTty.Format("%s/tty/tty%u", strVirtual.c_str(), iPtr);
+    strLink.Format("%s/class/tty/tty%u", strRoot.c_str(), iPtr);
+    if (!make_device(strTty) || symlink(strTty.c_str(), strLink.c_str()) != 0)
+      return false;
+  }
+
+  for (unsigned int iPtr = 0; iPtr < iUsbDevices; iPtr++)
+  {
+    CStdString strDevice, strInterface, strTty, strLink, strId;
+    strDevice.Format("%s/1-%u", strUsb.c_str(), iPtr + 1);
+    strInterface.Format("%s/1-%u:1.0", strDevice.c_str(), iPtr + 1);
+    strTty.Format("%s/tty/ttyACM%u", strInterface.c_str(), iPtr);
+    strLink.Format("%s/class/tty/ttyACM%u", strRoot.c_str(), iPtr);
+    if (!make_device(strDevice) || !make_device(strInterface) || mkdir((strInterface + "/tty").c_str(), 0755) != 0 ||
+        !make_device(strTty) || symlink(strInterface.c_str(), (strTty + "/device").c_str()) != 0 ||
+        symlink(strTty.c_str(), strLink.c_str()) != 0)
+      return false;
+
+    strId.Format("%04x\n", iPtr < iAdapters ? CEC_BENCH_VID : 0x046d);
+    if (!write_file(strDevice + "/idVendor", strId))
+      return false;
+    strId.Format("%04x\n", iPtr < iAdapters ? CEC_BENCH_PID : 0xc52b);
+    if (!write_file(strDevice + "/idProduct", strId))
+      return false;
+  }
+
+  for (unsigned int iPtr = 0; iPtr < iOtherDevices; iPtr++)
+  {
+    CStdString strInput, strEvent;
+    strInput.Format("%s/input/input%u", strVirtual.c_str(), iPtr);
+    strEvent.Format("%s/event%u", strInput.c_str(), iPtr);
+    if (!make_device(strInput) || !make_device(strEvent))
+      return false;
+  }
+
+  return true;
+}
+
+static int remove_entry(const char *strPath, const struct stat *, int, struct FTW *)
+{
+  return remove(strPath);
+}
+
+static bool read_hex(const CStdString &strPath, int &iValue)
+{
+  FILE *file = fopen(strPath.c_str(), "r");
+  if (!file)
+    return false;
+  bool bReturn = fscanf(file, "%x", &iValue) == 1;
+  fclose(file);
+  return bReturn;
+}
+
+/* the parent device is the closest parent directory with a uevent file, like udev_device_get_parent() */
+static CStdString get_parent(const CStdString &strPath)
+{
+  CStdString strParent(strPath);
+  int iSlash;
+  while ((iSlash = strParent.ReverseFind('/')) > 0)
+  {
+    strParent = strParent.Left(iSlash);
+    if (access((strParent + "/uevent").c_str(), F_OK) == 0)
+      return strParent;
+  }
+  return CStdString();
+}
+
+/*
+ * The detection that libCEC used before it read sysfs directly: every device on the system is visited, the grandparent
+ * of every device is checked for the vendor and product id, and the tty directory of a match is scanned for the port.
+ */
+static void find_adapters_full_scan(const CStdString &strPath, vector<cec_adapter> &deviceList)
+{
+  DIR *dir;
+  if ((dir = opendir(strPath.c_str())) == NULL)
+    return;
+
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL)
+  {
+    if (dirent->d_name[0] == '.' || dirent->d_type != DT_DIR)
+      continue;
+
+    //directories without a uevent file aren't devices, but can contain them. udev reads the uevent file of every device
+    CStdString strDevice(strPath + "/" + dirent->d_name);
+    find_adapters_full_scan(strDevice, deviceList);
+    char buff[256];
+    int fd = open((strDevice + "/uevent").c_str(), O_RDONLY);
+    if (fd == -1)
+      continue;
+    ssize_t iRead = read(fd, buff, sizeof(buff));
+    close(fd);
+
+    CStdString strUsb(get_parent(get_parent(strDevice)));
+    int iVendor, iProduct;
+    if (iRead >= 0 && read_hex(strUsb + "/idVendor", iVendor) && read_hex(strUsb + "/idProduct", iProduct) &&
+        iVendor == CEC_BENCH_VID && iProduct == CEC_BENCH_PID)
+    {
+      CStdString strTty;
+      strTty.Format("%s/%s:1.0/tty", strUsb.c_str(), strUsb.Mid(strUsb.ReverseFind('/') + 1).c_str());
+      DIR *ttyDir;
+      if ((ttyDir = opendir(strTty.c_str())) != NULL)
+      {
+        struct dirent *ttyDirent;
+        while ((ttyDirent = readdir(ttyDir)) != NULL)
+        {
+          if (ttyDirent->d_name[0] == '.')
+            continue;
+          cec_adapter foundDev;
+          foundDev.path = strUsb;
+          foundDev.comm = string("/dev/") + ttyDirent->d_name;
+          deviceList.push_back(foundDev);
+          break;
+        }
+        closedir(ttyDir);
+      }
+    }
+  }
+
+  closedir(dir);
+}
+
+static bool check_adapters(const vector<cec_adapter> &deviceList, unsigned int iAdapters, const char *strMethod)
+{
+  bool bReturn = deviceList.size() == iAdapters;
+  for (unsigned int iPtr = 0; bReturn && iPtr < deviceList.size(); iPtr++)
+  {
+    unsigned int iPort;
+    bReturn = sscanf(deviceList[iPtr].comm.c_str(), "/dev/ttyACM%u", &iPort) == 1 && iPort < iAdapters;
+  }
+
+  if (!bReturn)
+  {
+    CStdString strError;
+    strError.Format("%s found %u adapters instead of %u", strMethod, (unsigned int) deviceList.size(), iAdapters);
+    cout << strError.c_str() << endl;
+  }
+  return bReturn;
+}
+
+static int run_detect(unsigned int iUsbDevices, unsigned int iOtherDevices, unsigned int iIterations)
+{
+  char strRoot[] = "/tmp/cec-bench-sysfs-XXXXXX";
+  if (!mkdtemp(strRoot))
+  {
+    cout << "could not create a temporary directory" << endl;
+    return 1;
+  }
+
+  unsigned int iAdapters = iUsbDevices < 4 ? iUsbDevices : 4;
+  bool bReturn = make_sysfs(strRoot, iUsbDevices, iAdapters, iOtherDevices);
+  if (!bReturn)
+    cout << "could not create the sysfs tree in " << strRoot << endl;
+
+  int64_t iSysfsTime(0), iScanTime(0);
+  for (unsigned int iPtr = 0; bReturn && iPtr < iIterations; iPtr++)
+  {
+    vector<cec_adapter> sysfs, scan;
+    int64_t iStart = GetTimeUs();
+    CAdapterDetection::FindAdaptersSysfs(sysfs, NULL, strRoot);
+    iSysfsTime += GetTimeUs() - iStart;
+
+    iStart = GetTimeUs();
+    find_adapters_full_scan(CStdString(strRoot) + "/devices", scan);
+    iScanTime += GetTimeUs() - iStart;
+
+    bReturn = check_adapters(sysfs, iAdapters, "sysfs detection") && check_adapters(scan, iAdapters, "full scan");
+  }
+
+  //detection for a single device path only returns that adapter
+  if (bReturn && iAdapters > 0)
+  {
+    CStdString strPath;
+    strPath.Format("%s/devices/usb1/1-1", strRoot);
+    char strRealPath[PATH_MAX];
+    vector<cec_adapter> single;
+    bReturn = realpath(strPath.c_str(), strRealPath) &&
+        CAdapterDetection::FindAdaptersSysfs(single, strRealPath, strRoot) == 1 && single[0].comm == "/dev/ttyACM0";
+    if (!bReturn)
+      cout << "sysfs detection didn't find the adapter at " << strPath.c_str() << endl;
+  }
+
+  nftw(strRoot, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  if (!bReturn)
+    return 1;
+
+  CStdString strResult;
+  strResult.Format("%u usb serial devices, %u other devices: sysfs %.3f ms, full scan %.3f ms per detection",
+      iUsbDevices, iOtherDevices, (double) iSysfsTime / iIterations / 1000, (double) iScanTime / iIterations / 1000);
+  cout << strResult.c_str() << endl;
+
+  //and the real system, where the udev enumeration of the tty subsystem is the fallback
+  int64_t iStart = GetTimeUs();
+  vector<cec_adapter> sysfs, udev;
+  int iSysfs = CAdapterDetection::FindAdaptersSysfs(sysfs);
+  int64_t iSysfsSystem = GetTimeUs() - iStart;
+  iStart = GetTimeUs();
+  int iUdev = CAdapterDetection::FindAdaptersUdev(udev);
+  int64_t iUdevSystem = GetTimeUs() - iStart;
+  strResult.Format("this system: sysfs %.3f ms (%d found), udev tty enumeration %.3f ms (%d found)",
+      (double) iSysfsSystem / 1000, iSysfs, (double) iUdevSystem / 1000, iUdev);
+  cout << strResult.c_str() << endl;
+  return 0;
+}
+
+/* every allocation of this process, libCEC included, is counted so the soak test can see allocations on the hot paths */
+static volatile long g_iAllocations = 0;
+
+/* the replacements aren't inlined, so the compiler doesn't pair the new expressions in this file with free() */
+#if __cplusplus >= 201103L
+#define CEC_BENCH_THROW_BAD_ALLOC
+#define CEC_BENCH_NO_THROW        noexcept
+#else
+#define CEC_BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define CEC_BENCH_NO_THROW        throw()
+#endif
+
+void *operator new(size_t iSize) CEC_BENCH_THROW_BAD_ALLOC
+{
+  __sync_fetch_and_add(&g_iAllocations, 1);
+  void *ptr = malloc(iSize ? iSize : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t iSize) CEC_BENCH_THROW_BAD_ALLOC
+{
+  return operator new(iSize);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) CEC_BENCH_NO_THROW
+{
+  free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void *ptr) CEC_BENCH_NO_THROW
+{
+  free(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *ptr, size_t) CEC_BENCH_NO_THROW
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) CEC_BENCH_NO_THROW
+{
+  free(ptr);
+}
+#endif
+
+typedef struct soak_sample
+{
+  double fRss;         /*!< the resident set size, in KB */
+  double fHeap;        /*!< the allocated heap, in KB */
+  double fAllocations; /*!< allocations per second */
+  double fCommands;    /*!< the size of the command queue */
+  double fLatency;     /*!< the 99th percentile of the command queue latency, in microseconds */
+  double fInputBuffer; /*!< the size of the input buffer of the connection */
+} soak_sample;
+
+static double get_rss_kb(void)
+{
+  long iPages(0), iRss(0);
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file)
+  {
+    if (fscanf(file, "%ld %ld", &iPages, &iRss) != 2)
+      iRss = 0;
+    fclose(file);
+  }
+  return (double) iRss * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static double get_heap_kb(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 info = mallinfo2();
+  return (double) (info.uordblks + info.hblkhd) / 1024;
+#else
+  return 0;
+#endif
+}
+
+static double get_average(const vector<soak_sample> &samples, size_t iStart, size_t iEnd, double soak_sample::*field)
+{
+  double fTotal(0);
+  for (size_t iPtr = iStart; iPtr < iEnd; iPtr++)
+    fTotal += samples[iPtr].*field;
+  return iEnd > iStart ? fTotal / (iEnd - iStart) : 0;
+}
+
+static int run_soak(ICECAdapter *parser, CAdapterEmulator &emulator, unsigned int iRate, unsigned int iSeconds, unsigned int iSampleInterval, unsigned int iTransmissions)
+{
+  vector<cec_frame> frames;
+  get_mix("all", frames);
+
+  //GIVE_DEVICE_POWER_STATUS to the tv
+  cec_frame poll;
+  poll.push_back(0x40);
+  poll.push_back(0x8F);
+
+  emulator.SetLoad(frames, iRate, iSeconds, true);
+  CCondition::Sleep(CEC_BENCH_START_DELAY);
+
+  cec_command commands[64];
+  cec_keypress keys[64];
+  cec_log_message logs[64];
+  cec_queue_statistics previous;
+  parser->GetQueueStatistics(CEC_QUEUE_COMMAND, &previous);
+  long iPreviousAllocations = g_iAllocations;
+  uint64_t iTransmitted(0), iFailed(0);
+  vector<soak_sample> samples;
+
+  cout << "    rss (KB)   heap (KB)    allocs/s  cmd queue  cmd p99 (us)  input buffer" << endl;
+  int64_t iNextSample = GetTimeMs() + iSampleInterval;
+  int64_t iEndTime = GetTimeMs() + (int64_t) iSeconds * 1000;
+  while (GetTimeMs() < iEndTime)
+  {
+    while (parser->GetNextCommands(commands, 64) > 0) {}
+    while (parser->GetNextKeypresses(keys, 64) > 0) {}
+    while (parser->GetNextLogMessages(logs, 64) > 0) {}
+    CCondition::Sleep(10);
+
+    if (GetTimeMs() < iNextSample)
+      continue;
+    iNextSample += iSampleInterval;
+
+    for (unsigned int iPtr = 0; iPtr < iTransmissions; iPtr++)
+      (parser->Transmit(poll) ? iTransmitted : iFailed)++;
+
+    cec_statistics stats;
+    cec_queue_statistics queue;
+    parser->GetStatistics(&stats);
+    parser->GetQueueStatistics(CEC_QUEUE_COMMAND, &queue);
+    for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+    {
+      uint32_t iCount = queue.latency_histogram[iPtr];
+      queue.latency_histogram[iPtr] -= previous.latency_histogram[iPtr];
+      previous.latency_histogram[iPtr] = iCount;
+    }
+
+    long iAllocations = g_iAllocations;
+    soak_sample sample;
+    sample.fRss         = get_rss_kb();
+    sample.fHeap        = get_heap_kb();
+    sample.fAllocations = (double) (iAllocations - iPreviousAllocations) * 1000 / iSampleInterval;
+    sample.fCommands    = queue.size;
+    sample.fLatency     = get_latency_percentile(queue, 0.99f);
+    sample.fInputBuffer = stats.input_buffer_size;
+    samples.push_back(sample);
+    iPreviousAllocations = iAllocations;
+
+    CStdString strSample;
+    strSample.Format("%12.0f%12.0f%12.0f%11.0f%14.0f%14.0f", sample.fRss, sample.fHeap, sample.fAllocations, sample.fCommands, sample.fLatency, sample.fInputBuffer);
+    cout << strSample.c_str() << endl;
+  }
+
+  uint64_t iFramesSent, iAcked;
+  emulator.GetCounters(iFramesSent, iAcked);
+  CStdString strResult;
+  strResult.Format("sent %llu frames, transmitted %llu frames, %llu transmissions failed",
+      (unsigned long long) iFramesSent, (unsigned long long) iTransmitted, (unsigned long long) iFailed);
+  cout << strResult.c_str() << endl;
+
+  //skip the warm-up, then compare the middle and the last third of the run. anything that levels off is the same in both,
+  //anything that grows without a bound isn't
+  size_t iWarmUp = samples.size() / 5;
+  size_t iThird  = (samples.size() - iWarmUp) / 3;
+  if (iThird == 0)
+  {
+    cout << "not enough samples, run the soak test for longer" << endl;
+    return 1;
+  }
+
+  const char *strNames[] = { "rss (KB)", "heap (KB)", "allocs/s", "cmd queue", "cmd p99 (us)", "input buffer" };
+  double soak_sample::*fields[] = { &soak_sample::fRss, &soak_sample::fHeap, &soak_sample::fAllocations,
+      &soak_sample::fCommands, &soak_sample::fLatency, &soak_sample::fInputBuffer };
+  const double fSlack[] = { 512, 128, 100, 16, 0, 0 };
+  bool bGrowing(false);
+  for (unsigned int iPtr = 0; iPtr < sizeof(fields) / sizeof(fields[0]); iPtr++)
+  {
+    double fMiddle = get_average(samples, iWarmUp + iThird, iWarmUp + 2 * iThird, fields[iPtr]);
+    double fLast   = get_average(samples, samples.size() - iThird, samples.size(), fields[iPtr]);
+    //latencies are counted in power of 2 buckets, so one bucket of drift is allowed
+    bool bGrew = fields[iPtr] == &soak_sample::fLatency ? fLast > fMiddle * 2 + 1 : fLast > fMiddle * 1.1 + fSlack[iPtr];
+
+    CStdString strField;
+    strField.Format("%-13s middle %10.1f last %10.1f %s", strNames[iPtr], fMiddle, fLast, bGrew ? "GROWING" : "ok");
+    cout << strField.c_str() << endl;
+    bGrowing |= bGrew;
+  }
+
+  cout << (bGrowing ? "soak test failed" : "soak test passed") << endl;
+  return bGrowing ? 1 : 0;
+}
+
+#define CEC_BENCH_LOG_LINE "a log line that doesn't fit in the buffer of a short string"
+
+/*
+ * Adds log lines and receives frames that are queued for the application, and counts the allocations per log line and
+ * per queued command once the queues went round at least once. Both have to be 0: the entries move through the queues
+ * and reuse the memory that the application hands back, so only the first lap allocates. The entries of the application
+ * get their memory up front, like they would in an application that doesn't want to allocate either.
+ */
+static int run_allocations(ICECAdapter *parser, CAdapterEmulator &emulator, unsigned int iRate, unsigned int iSeconds, unsigned int iLogLines)
+{
+  cec_command commands[64];
+  cec_log_message logs[64];
+  for (unsigned int iPtr = 0; iPtr < 64; iPtr++)
+  {
+    commands[iPtr].parameters.reserve(CEC_MAX_FRAME_SIZE);
+    logs[iPtr].message.reserve(sizeof(CEC_BENCH_LOG_LINE));
+  }
+
+  //debug logs are formatted, which allocates. only the log lines that are added here are queued
+  parser->SetLogLevel(CEC_LOG_WARNING);
+  CCondition::Sleep(CEC_BENCH_START_DELAY);
+
+  //the first half of the log lines is the warm-up, which also leaves every slot of the log queue with a message's memory
+  CLibCEC *lib = static_cast<CLibCEC *>(parser);
+  long iAllocations(0);
+  for (unsigned int iPtr = 0; iPtr < iLogLines * 2; iPtr++)
+  {
+    if (iPtr == iLogLines)
+      iAllocations = g_iAllocations;
+    lib->AddLog(CEC_LOG_WARNING, CEC_BENCH_LOG_LINE);
+    if (iPtr % 64 == 63)
+      while (parser->GetNextLogMessages(logs, 64) > 0) {}
+  }
+  long iLogAllocations = g_iAllocations - iAllocations;
+  while (parser->GetNextLogMessages(logs, 64) > 0) {}
+
+  vector<cec_frame> frames;
+  get_mix("direct", frames);
+  emulator.SetLoad(frames, iRate, iSeconds);
+
+  //the first fifth of the run is the warm-up
+  uint64_t iCommands(0);
+  int64_t iWarmUpEnd = GetTimeMs() + (int64_t) iSeconds * 200;
+  int64_t iEndTime = GetTimeMs() + (int64_t) iSeconds * 1000;
+  bool bWarm(false);
+  while (GetTimeMs() < iEndTime)
+  {
+    if (!bWarm && GetTimeMs() >= iWarmUpEnd)
+    {
+      bWarm        = true;
+      iAllocations = g_iAllocations;
+    }
+
+    unsigned int iPopped;
+    while ((iPopped = parser->GetNextCommands(commands, 64)) > 0)
+      iCommands += bWarm ? iPopped : 0;
+    while (parser->GetNextLogMessages(logs, 64) > 0) {}
+    CCondition::Sleep(10);
+  }
+  long iCommandAllocations = g_iAllocations - iAllocations;
+
+  CStdString strResult;
+  strResult.Format("%u log lines: %ld allocations\n%llu commands: %ld allocations",
+      iLogLines, iLogAllocations, (unsigned long long) iCommands, iCommandAllocations);
+  cout << strResult.c_str() << endl;
+
+  if (iCommands == 0)
+  {
+    cout << "no commands were received" << endl;
+    return 1;
+  }
+
+  bool bAllocated = iLogAllocations > 0 || iCommandAllocations > 0;
+  cout << (bAllocated ? "the queues allocate in steady state" : "the queues don't allocate in steady state") << endl;
+  return bAllocated ? 1 : 0;
+}
+
+static unsigned int get_arg(int argc, char *argv[], int iArg, unsigned int iDefault)
+{
+  return argc > iArg ? (unsigned int) atoi(argv[iArg]) : iDefault;
+}
+
+static void show_help(const char *strExec)
+{
+  cout << endl <<
+      strExec << " load [mix] [frames/s] [seconds] [interval]" << endl <<
+      endl <<
+      "Floods libCEC with frames from an emulated adapter, and shows how many were" << endl <<
+      "dropped and how long they waited in the queues." << endl <<
+      endl <<
+      "mix       power, direct, keys, escape, other or all. default: all" << endl <<
+      "frames/s  the rate of the frames. default: 1000" << endl <<
+      "seconds   the duration. default: 10" << endl <<
+      "interval  the time between two reads of the queues, in ms. default: 10" << endl <<
+      endl <<
+      strExec << " soak [frames/s] [seconds] [sample interval] [transmissions]" << endl <<
+      endl <<
+      "Runs libCEC against a steady load with line noise, and transmits frames every" << endl <<
+      "sample interval. Exits with 1 when the memory, the allocations per second, the" << endl <<
+      "command queue or the input buffer keep growing." << endl <<
+      endl <<
+      "frames/s       the rate of the frames. default: 500" << endl <<
+      "seconds        the duration. default: 60" << endl <<
+      "interval       the time between two samples, in ms. default: 1000" << endl <<
+      "transmissions  the frames that are transmitted every sample. default: 5" << endl <<
+      endl <<
+      strExec << " allocations [frames/s] [seconds] [log lines]" << endl <<
+      endl <<
+      "Counts the allocations of log lines and of commands that are queued for the" << endl <<
+      "application, once the queues have been used. Exits with 1 when either allocates." << endl <<
+      endl <<
+      "frames/s   the rate of the frames. default: 500" << endl <<
+      "seconds    the duration. the adapter is pinged every 5 seconds. default: 12" << endl <<
+      "log lines  the number of log lines that are counted. default: 10000" << endl <<
+      endl <<
+      strExec << " detect [usb devices] [other devices] [iterations]" << endl <<
+      endl <<
+      "Builds a sysfs tree in /tmp, checks that adapter detection finds the adapters" << endl <<
+      "in it, and compares the time it takes with a scan of every device." << endl <<
+      endl <<
+      "usb devices    the usb serial devices, of which 4 are CEC adapters. default: 200" << endl <<
+      "other devices  the devices without a serial port. default: 2000" << endl <<
+      "iterations     the number of detections that are timed. default: 20" << endl <<
+      endl <<
+      strExec << " reactor [adapters] [frames/s] [seconds]" << endl <<
+      endl <<
+      "Opens 1, 4, 16 and up to the given number of emulated adapters, with their own" << endl <<
+      "threads and with the shared reactor. Shows libCEC's threads, their cpu use, and" << endl <<
+      "the time between an adapter sending a frame and libCEC handing it to a command" << endl <<
+      "handler." << endl <<
+      endl <<
+      "adapters   the largest number of adapters. default: 64" << endl <<
+      "frames/s   the frames that every adapter sends. default: 20" << endl <<
+      "seconds    the duration of every step. default: 5" << endl <<
+      endl <<
+      strExec << " drain [entries]" << endl <<
+      endl <<
+      "Fills a queue of log messages and one of commands and drains them, one entry" << endl <<
+      "at a time and in batches of 1 to 64 entries. Shows the time it takes to drain" << endl <<
+      "an entry. Fails when batches of 16 entries or more aren't faster than single" << endl <<
+      "pops." << endl <<
+      endl <<
+      "entries    the number of entries that are drained. default: 1000000" << endl <<
+      endl <<
+      strExec << " contention [producers] [consumers] [seconds]" << endl <<
+      endl <<
+      "Pushes and pops commands on one queue from several threads at once, with the" << endl <<
+      "lock-free queue and with a queue that is protected by a mutex. Shows the" << endl <<
+      "number of commands that are popped per second." << endl <<
+      endl <<
+      "producers  the number of threads that push commands. default: 4" << endl <<
+      "consumers  the number of threads that pop commands. default: 4" << endl <<
+      "seconds    the duration of every step. default: 2" << endl <<
+      endl <<
+      strExec << " jitter [hogs] [frames/s] [seconds]" << endl <<
+      endl <<
+      "Measures the time it takes libCEC to hand a frame to a command handler while" << endl <<
+      "threads keep the CPUs busy: without them, with libCEC's default thread" << endl <<
+      "configuration, and with SCHED_FIFO and libCEC's threads pinned to the last" << endl <<
+      "CPU. Needs root or CAP_SYS_NICE, the emulated adapter runs with SCHED_FIFO." << endl <<
+      endl <<
+      "hogs       the number of threads that keep the CPUs busy. default: 2 per CPU" << endl <<
+      "frames/s   the rate of the frames. default: 100" << endl <<
+      "seconds    the duration of every step. default: 5" << endl;
+}
+
+int main (int argc, char *argv[])
+{
+  string strMode(argc > 1 ? argv[1] : "");
+  if (strMode == "detect")
+    return run_detect(get_arg(argc, argv, 2, 200), get_arg(argc, argv, 3, 2000), get_arg(argc, argv, 4, 20));
+  if (strMode == "jitter")
+    return run_jitter(get_arg(argc, argv, 2, 2 * (unsigned int) sysconf(_SC_NPROCESSORS_ONLN)), get_arg(argc, argv, 3, 100), get_arg(argc, argv, 4, 5));
+  if (strMode == "contention")
+    return run_contention(get_arg(argc, argv, 2, 4), get_arg(argc, argv, 3, 4), get_arg(argc, argv, 4, 2));
+  if (strMode == "drain")
+    return run_drain(get_arg(argc, argv, 2, 1000000));
+  if (strMode == "reactor")
+    return run_reactor(get_arg(argc, argv, 2, 64), get_arg(argc, argv, 3, 20), get_arg(argc, argv, 4, 5));
+
+  if (strMode != "load" && strMode != "soak" && strMode != "allocations")
+  {
+    show_help(argv[0]);
+    return 1;
+  }
+
+  CAdapterEmulator emulator;
+  if (!emulator.Open())
+  {
+    cout << "could not create the emulated adapter" << endl;
+    return 1;
+  }
+
+  ICECAdapter *parser = LoadLibCec("CEC Bench");
+  if (!parser)
+  {
+    cout << "Unable to create parser. Is libcec.so present?" << endl;
+    return 1;
+  }
+
+  if (!parser->Open(emulator.GetPort().c_str()))
+  {
+    cout << "unable to open the emulated adapter on port " << emulator.GetPort() << endl;
+    UnloadLibCec(parser);
+    return 1;
+  }
+
+  int iReturn;
+  if (strMode == "load")
+    iReturn = run_load(parser, emulator, argc > 2 ? argv[2] : "all", get_arg(argc, argv, 3, 1000), get_arg(argc, argv, 4, 10), get_arg(argc, argv, 5, 10));
+  else if (strMode == "allocations")
+    iReturn = run_allocations(parser, emulator, get_arg(argc, argv, 2, 500), get_arg(argc, argv, 3, 12), get_arg(argc, argv, 4, 10000));
+  else
+    iReturn = run_soak(parser, emulator, get_arg(argc, argv, 2, 500), get_arg(argc, argv, 3, 60), get_arg(argc, argv, 4, 1000), get_arg(argc, argv, 5, 5));
+
+  parser->Close();
+  UnloadLibCec(parser);
+  return iReturn;
+}
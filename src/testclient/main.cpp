@@ -32,6 +32,7 @@
 
 #include "../../include/CECExports.h"
 #include "../lib/platform/threads.h"
+#include "../lib/platform/timeutils.h"
 #include "../lib/util/StdString.h"
 #include <cstdio>
 #include <fcntl.h>
@@ -42,7 +43,7 @@
 using namespace CEC;
 using namespace std;
 
-#define CEC_TEST_CLIENT_VERSION 3
+#define CEC_TEST_CLIENT_VERSION 5
 
 
 inline bool HexStrToInt(const std::string& data, uint8_t& value)
@@ -99,32 +100,146 @@ bool GetWord(string& data, string& word)
 
 void flush_log(ICECAdapter *cecParser)
 {
-  cec_log_message message;
-  while (cecParser && cecParser->GetNextLogMessage(&message))
+  cec_log_message messages[32];
+  unsigned int iMessages;
+  while (cecParser && (iMessages = cecParser->GetNextLogMessages(messages, 32)) > 0)
   {
-    switch (message.level)
+    for (unsigned int iPtr = 0; iPtr < iMessages; iPtr++)
     {
-    case CEC_LOG_ERROR:
-      cout << "ERROR:   " << message.message.c_str() << endl;
+      switch (messages[iPtr].level)
+      {
+      case CEC_LOG_ERROR:
+        cout << "ERROR:   " << messages[iPtr].message.c_str() << endl;
+        break;
+      case CEC_LOG_WARNING:
+        cout << "WARNING: " << messages[iPtr].message.c_str() << endl;
+        break;
+      case CEC_LOG_NOTICE:
+        cout << "NOTICE:  " << messages[iPtr].message.c_str() << endl;
+        break;
+      case CEC_LOG_DEBUG:
+        cout << "DEBUG:   " << messages[iPtr].message.c_str() << endl;
+        break;
+      }
+    }
+  }
+
+  cec_adapter_event event;
+  while (cecParser && cecParser->GetNextAdapterEvent(&event))
+  {
+    switch (event.type)
+    {
+    case CEC_ADAPTER_EVENT_DISCONNECTED:
+      cout << "EVENT:   adapter on " << event.adapter.comm.c_str() << " disconnected" << endl;
       break;
-    case CEC_LOG_WARNING:
-      cout << "WARNING: " << message.message.c_str() << endl;
+    case CEC_ADAPTER_EVENT_RECONNECTED:
+      cout << "EVENT:   adapter on " << event.adapter.comm.c_str() << " reconnected" << endl;
       break;
-    case CEC_LOG_NOTICE:
-      cout << "NOTICE:  " << message.message.c_str() << endl;
+    case CEC_ADAPTER_EVENT_ARRIVED:
+      cout << "EVENT:   adapter plugged in on " << event.adapter.comm.c_str() << endl;
       break;
-    case CEC_LOG_DEBUG:
-      cout << "DEBUG:   " << message.message.c_str() << endl;
+    case CEC_ADAPTER_EVENT_REMOVED:
+      cout << "EVENT:   adapter removed from " << event.adapter.comm.c_str() << endl;
       break;
     }
   }
 }
 
+/*!
+ * @return The upper bound in microseconds of the latency histogram bucket that holds the given fraction of the popped entries.
+ */
+unsigned int get_latency_percentile(const cec_queue_statistics &stats, double fFraction)
+{
+  uint64_t iTotal(0);
+  for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+    iTotal += stats.latency_histogram[iPtr];
+
+  uint64_t iCount(0);
+  for (unsigned int iPtr = 0; iPtr < CEC_QUEUE_LATENCY_BUCKETS; iPtr++)
+  {
+    iCount += stats.latency_histogram[iPtr];
+    if (iTotal > 0 && iCount >= fFraction * iTotal)
+      return iPtr + 1 < CEC_QUEUE_LATENCY_BUCKETS ? 2u << iPtr : stats.latency_max;
+  }
+  return 0;
+}
+
+void show_statistics(ICECAdapter *parser)
+{
+  cec_statistics stats;
+  if (!parser->GetStatistics(&stats))
+    return;
+
+  CStdString strStats;
+  strStats.Format("pings sent:    %llu\npings failed:  %llu\nping rtt (ms): last %.2f min %.2f avg %.2f max %.2f\nreconnects:    %u",
+      (unsigned long long) stats.pings_sent, (unsigned long long) stats.pings_failed,
+      (float) stats.ping_rtt_last / 1000, (float) stats.ping_rtt_min / 1000, (float) stats.ping_rtt_avg / 1000, (float) stats.ping_rtt_max / 1000,
+      stats.reconnects);
+  cout << strStats.c_str() << endl;
+
+  CStdString strAddress;
+  if (stats.allocation_time > 0)
+    strAddress.Format("logical address: %d (allocated in %.1f ms)", stats.logical_address, (float) stats.allocation_time / 1000);
+  else
+    strAddress.Format("logical address: %d", stats.logical_address);
+  cout << strAddress.c_str() << endl;
+
+  CStdString strWrites;
+  strWrites.Format("frames sent:   %llu\nwrite calls:   %llu\nbytes written: %llu",
+      (unsigned long long) stats.frames_transmitted, (unsigned long long) stats.write_calls, (unsigned long long) stats.bytes_written);
+  if (stats.frames_transmitted > 0)
+    strWrites.AppendFormat(" (%.1f write calls and %.1f bytes per frame)",
+        (float) stats.write_calls / stats.frames_transmitted, (float) stats.bytes_written / stats.frames_transmitted);
+  cout << strWrites.c_str() << endl;
+
+  CStdString strReads;
+  strReads.Format("frames received: %llu\ninput buffer:  %u bytes (%llu bytes discarded)",
+      (unsigned long long) stats.frames_received, stats.input_buffer_size, (unsigned long long) stats.bytes_discarded);
+  cout << strReads.c_str() << endl;
+
+  const char *strQueues[] = { "log", "keypress", "command", "adapter event" };
+  for (int iQueue = CEC_QUEUE_LOG; iQueue <= CEC_QUEUE_ADAPTER_EVENT; iQueue++)
+  {
+    cec_queue_statistics queueStats;
+    if (!parser->GetQueueStatistics((cec_queue) iQueue, &queueStats))
+      continue;
+
+    CStdString strQueue;
+    strQueue.Format("%s queue: size %u/%u peak %u pushed %u popped %u dropped %u coalesced %u last sequence %u latency (us) p50 <%u p99 <%u max %u",
+        strQueues[iQueue], queueStats.size, queueStats.capacity, queueStats.peak_size, queueStats.pushed,
+        queueStats.popped, queueStats.dropped, queueStats.coalesced, queueStats.last_sequence,
+        get_latency_percentile(queueStats, 0.5), get_latency_percentile(queueStats, 0.99), queueStats.latency_max);
+    cout << strQueue.c_str() << endl;
+  }
+
+  cec_lock_statistics locks[64];
+  unsigned int iLocks = parser->GetLockStatistics(locks, 64);
+  for (unsigned int iPtr = 0; iPtr < iLocks; iPtr++)
+  {
+    if (locks[iPtr].acquisitions == 0)
+      continue;
+
+    CStdString strLock;
+    strLock.Format("lock %s: acquired %llu contended %llu wait (us) total %llu max %llu hold (us) total %llu max %llu",
+        locks[iPtr].name, (unsigned long long) locks[iPtr].acquisitions, (unsigned long long) locks[iPtr].contended,
+        (unsigned long long) locks[iPtr].wait_time_total, (unsigned long long) locks[iPtr].wait_time_max,
+        (unsigned long long) locks[iPtr].hold_time_total, (unsigned long long) locks[iPtr].hold_time_max);
+    cout << strLock.c_str() << endl;
+  }
+}
+
 void list_devices(ICECAdapter *parser)
 {
-  cout << "Found devices: ";
   vector<cec_adapter> devices;
+  int64_t iStart = GetTimeUs();
   int iDevicesFound = parser->FindAdapters(devices);
+  int64_t iDuration = GetTimeUs() - iStart;
+
+  CStdString strDuration;
+  strDuration.Format("adapter detection took %.1f ms", (float) iDuration / 1000);
+  cout << strDuration.c_str() << endl;
+
+  cout << "Found devices: ";
   if (iDevicesFound <= 0)
   {
 #ifdef __WINDOWS__
@@ -139,7 +254,7 @@ void list_devices(ICECAdapter *parser)
     for (unsigned int iDevicePtr = 0; iDevicePtr < devices.size(); iDevicePtr++)
     {
       CStdString strDevice;
-      strDevice.Format("device:        %d\npath:          %s\ncom port:      %s", iDevicePtr, devices[iDevicePtr].path.c_str(), devices[0].comm.c_str());
+      strDevice.Format("device:        %d\npath:          %s\ncom port:      %s", iDevicePtr, devices[iDevicePtr].path.c_str(), devices[iDevicePtr].comm.c_str());
       cout << endl << strDevice.c_str() << endl;
     }
   }
@@ -170,8 +285,16 @@ void show_console_help(void)
   "la {logical_address}      change the logical address of the CEC adapter." << endl <<
   "[la 4]                    logical address 4" << endl <<
   endl <<
+  "ld {la} {type} {name}     present another logical device on the CEC line." << endl <<
+  "[ld 1 1 Recorder]         recording device 1 with device type 1 (recording device)" << endl <<
+  "rd {logical_address}      stop presenting a logical device that was added with ld." << endl <<
+  endl <<
   "[ping]                    send a ping command to the CEC adapter." << endl <<
   "[bl]                      to let the adapter enter the bootloader, to upgrade the flash rom." << endl <<
+  "[stats]                   show the statistics of the connection to the adapter." << endl <<
+  "[monitor]                 report adapters that are plugged in or removed." << endl <<
+  "trace {file}              write a timeline of all frames to file, for chrome://tracing." << endl <<
+  "[trace]                   stop writing the timeline." << endl <<
   "[h] or [help]             show this help." << endl <<
   "[q] or [quit]             to quit the CEC test client and switch off all connected CEC devices." << endl <<
   "================================================================================" << endl;
@@ -180,7 +303,7 @@ void show_console_help(void)
 int main (int argc, char *argv[])
 {
   ICECAdapter *parser = LoadLibCec("CEC Tester");
-  if (!parser && parser->GetMinVersion() > CEC_TEST_CLIENT_VERSION)
+  if (!parser || parser->GetMinVersion() > CEC_TEST_CLIENT_VERSION)
   {
     cout << "Unable to create parser. Is libcec.dll present?" << endl;
     return 1;
@@ -231,6 +354,7 @@ int main (int argc, char *argv[])
     strPort = argv[1];
   }
 
+  int64_t iOpenTime = GetTimeUs();
   if (!parser->Open(strPort.c_str()))
   {
     cout << "unable to open the device on port " << strPort << endl;
@@ -238,8 +362,10 @@ int main (int argc, char *argv[])
     UnloadLibCec(parser);
     return 1;
   }
+  iOpenTime = GetTimeUs() - iOpenTime;
 
-  cout << "cec device opened" << endl;
+  strLog.Format("cec device opened in %.1f ms, firmware version %d", (float) iOpenTime / 1000, parser->GetFirmwareVersion());
+  cout << strLog.c_str() << endl;
 
   parser->PowerOnDevices(CECDEVICE_TV);
   flush_log(parser);
@@ -280,14 +406,45 @@ int main (int argc, char *argv[])
             parser->SetLogicalAddress((cec_logical_address) atoi(strvalue.c_str()));
           }
         }
+        else if (command == "ld")
+        {
+          string strAddress, strType, strName;
+          if (GetWord(input, strAddress) && GetWord(input, strType) && GetWord(input, strName))
+          {
+            if (!parser->AddLogicalDevice((cec_logical_address) atoi(strAddress.c_str()), strName.c_str(), (cec_device_type) atoi(strType.c_str())))
+              cout << "could not add logical device " << strAddress << endl;
+          }
+        }
+        else if (command == "rd")
+        {
+          string strvalue;
+          if (GetWord(input, strvalue) && !parser->RemoveLogicalDevice((cec_logical_address) atoi(strvalue.c_str())))
+            cout << "could not remove logical device " << strvalue << endl;
+        }
         else if (command == "ping")
         {
-          parser->PingAdapter();
+          cout << (parser->PingAdapter() ? "ping succeeded" : "ping failed") << endl;
         }
         else if (command == "bl")
         {
           parser->StartBootloader();
         }
+        else if (command == "stats")
+        {
+          show_statistics(parser);
+        }
+        else if (command == "trace")
+        {
+          string strFile;
+          if (GetWord(input, strFile))
+            cout << (parser->StartTrace(strFile.c_str()) ? "writing a trace to " + strFile : "could not start the trace") << endl;
+          else
+            cout << (parser->StopTrace() ? "trace stopped" : "no trace is being written") << endl;
+        }
+        else if (command == "monitor")
+        {
+          cout << (parser->EnableAdapterMonitor() ? "adapter monitor started" : "could not start the adapter monitor") << endl;
+        }
         else if (command == "r")
         {
           parser->Close();